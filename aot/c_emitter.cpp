@@ -0,0 +1,667 @@
+#include "c_emitter.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+#include "../lexical/value_holder.hpp"
+
+// Runtime function computing a binary operator, null if the Interpreter rejects the operator
+static const char *binaryFunction(const TokenType type) {
+    switch (type) {
+        case PLUS: return "sox_add";
+        case MINUS: return "sox_subtract";
+        case STAR: return "sox_multiply";
+        case SLASH: return "sox_divide";
+        case GREATER: return "sox_greater";
+        case GREATER_EQUAL: return "sox_greater_equal";
+        case LESS: return "sox_less";
+        case LESS_EQUAL: return "sox_less_equal";
+        case EQUAL_EQUAL: return "sox_equal";
+        case BANG_EQUAL: return "sox_not_equal";
+        default: return nullptr;
+    }
+}
+
+static const char *comparisonOperator(const TokenType type) {
+    switch (type) {
+        case LESS: return "<";
+        case LESS_EQUAL: return "<=";
+        case GREATER: return ">";
+        default: return ">=";
+    }
+}
+
+static std::string doubleLiteral(const double value) {
+    if (std::isnan(value)) {
+        return "(0.0 / 0.0)";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)";
+    }
+    char chars[32];
+    snprintf(chars, sizeof(chars), "%.17g", value);
+    std::string literal = chars;
+    // Keeps it a double literal, including negative zero
+    if (literal.find_first_of(".e") == std::string::npos) {
+        literal += ".0";
+    }
+    return literal;
+}
+
+CEmitter::CEmitter() {
+    // Defined by sox_init_globals
+    for (const auto name: {"print", "println", "length"}) {
+        global(name);
+    }
+}
+
+std::string CEmitter::emit(std::vector<Stmt *> *stmts) {
+    CEmitter emitter;
+    std::string statements;
+    std::string runs;
+    for (ulong i = 0; i < stmts->size(); ++i) {
+        const auto stmt = stmts->at(i);
+        emitter._frame = Frame();
+        emitter._frame.isHeap = declaresFunction(stmt);
+        emitter.emit(stmt);
+        const auto name = "stmt_" + std::to_string(i);
+        statements += "static void " + name + "(void) {\n" + emitter._frame.code + "}\n\n";
+        runs += "    sox_run(" + name + ");\n";
+    }
+    std::string source = "// Generated by soxsh --emit-c, build it with the runtime library of soxsh:\n"
+            "// cc -O2 -I<soxsh>/aot/runtime <this file> <soxsh>/aot/runtime/sox_runtime.c\n\n"
+            "#include \"sox_runtime.h\"\n\n";
+    source += "static sox_global globals[] = {";
+    for (ulong i = 0; i < emitter._globals.size(); ++i) {
+        source += (i > 0 ? ", {" : "{") + quote(emitter._globals[i]) + "}";
+    }
+    source += "};\n";
+    if (!emitter._strings.empty()) {
+        source += "static sox_value strings[" + std::to_string(emitter._strings.size()) + "];\n";
+    }
+    source += "\n" + emitter._functions + statements;
+    source += "int main(void) {\n";
+    for (ulong i = 0; i < emitter._strings.size(); ++i) {
+        const auto &string = emitter._strings[i];
+        source += "    strings[" + std::to_string(i) + "] = sox_string_new(" + quote(string) + ", " +
+                std::to_string(string.size()) + ");\n";
+    }
+    source += "    sox_init_globals(globals, " + std::to_string(emitter._globals.size()) + ");\n";
+    source += runs;
+    source += "    return 0;\n}\n";
+    return source;
+}
+
+void CEmitter::line(const std::string &code) {
+    _frame.code.append(_frame.indent * 4, ' ').append(code).append("\n");
+}
+
+void CEmitter::begin(const std::string &code) {
+    line(code.empty() ? "{" : code + " {");
+    ++_frame.indent;
+}
+
+void CEmitter::end() {
+    --_frame.indent;
+    line("}");
+}
+
+void CEmitter::emit(Stmt *stmt) {
+    stmt->accept((StmtVisitor *) this);
+}
+
+std::string CEmitter::evaluate(Expr *expr) {
+    return expr->accept((ExprVisitor *) this);
+}
+
+std::string CEmitter::define(const std::string &value) {
+    const auto name = "t" + std::to_string(_nextId++);
+    line("sox_value " + name + " = " + value + ";");
+    return name;
+}
+
+void CEmitter::release(const std::string &value) {
+    line("sox_release(" + value + ");");
+}
+
+std::string CEmitter::condition(Expr *expr) {
+    const auto value = evaluate(expr);
+    const auto name = "c" + std::to_string(_nextId++);
+    line("const bool " + name + " = sox_truthy(" + value + ");");
+    release(value);
+    return name;
+}
+
+int CEmitter::global(const std::string_view name) {
+    if (const auto it = _globalSlots.find(name); it != _globalSlots.end()) {
+        return it->second;
+    }
+    const auto slot = static_cast<int>(_globals.size());
+    _globals.emplace_back(name);
+    _globalSlots.emplace(name, slot);
+    return slot;
+}
+
+std::string CEmitter::slotRef(const int depth, const int slot) const {
+    const auto &scopes = _frame.scopes;
+    if (depth < static_cast<int>(scopes.size())) {
+        const auto &scope = scopes[scopes.size() - 1 - depth];
+        if (scope.isHeap) {
+            return "s" + std::to_string(scope.id) + "->slots[" + std::to_string(slot) + "]";
+        }
+        return "l" + std::to_string(scope.id) + "_" + std::to_string(slot);
+    }
+    // Declared by an enclosing function, whose scopes are all on the heap
+    return "(*sox_scope_slot(env, " + std::to_string(depth - static_cast<int>(scopes.size())) + ", " +
+           std::to_string(slot) + "))";
+}
+
+std::string CEmitter::environment() const {
+    for (auto it = _frame.scopes.rbegin(); it != _frame.scopes.rend(); ++it) {
+        if (it->isHeap) {
+            return "s" + std::to_string(it->id);
+        }
+    }
+    return _frame.isFunction ? "env" : "NULL";
+}
+
+void CEmitter::openScope(const int slotCount) {
+    const Scope scope{_nextId++, slotCount, _frame.isHeap};
+    if (scope.isHeap) {
+        line("sox_scope *s" + std::to_string(scope.id) + " = sox_scope_new(" + environment() + ", " +
+             std::to_string(slotCount) + ");");
+    } else {
+        for (int i = 0; i < slotCount; ++i) {
+            line("sox_value l" + std::to_string(scope.id) + "_" + std::to_string(i) + " = SOX_NULL_VALUE;");
+        }
+    }
+    _frame.scopes.push_back(scope);
+}
+
+void CEmitter::closeScope(const Scope &scope) {
+    if (scope.isHeap) {
+        line("sox_scope_release(s" + std::to_string(scope.id) + ");");
+        return;
+    }
+    for (int i = 0; i < scope.slotCount; ++i) {
+        release("l" + std::to_string(scope.id) + "_" + std::to_string(i));
+    }
+}
+
+void CEmitter::closeScopes(const ulong count) {
+    for (auto i = _frame.scopes.size(); i > count; --i) {
+        closeScope(_frame.scopes[i - 1]);
+    }
+}
+
+std::string CEmitter::load(const Token *name, const int depth, const int slot) {
+    if (depth < 0) {
+        return define("sox_global_get(&globals[" + std::to_string(global(name->lexeme())) + "], " +
+                      std::to_string(name->line()) + ")");
+    }
+    return define("sox_retain(" + slotRef(depth, slot) + ")");
+}
+
+void CEmitter::store(const Token *name, const int depth, const int slot, const std::string &value) {
+    if (depth < 0) {
+        line("sox_global_assign(&globals[" + std::to_string(global(name->lexeme())) + "], sox_retain(" + value +
+             "), " + std::to_string(name->line()) + ");");
+    } else {
+        line("sox_assign(&" + slotRef(depth, slot) + ", sox_retain(" + value + "));");
+    }
+}
+
+int CEmitter::beginLoop(const std::string &limit) {
+    const auto id = _nextId++;
+    _frame.loops.push_back({id, _frame.scopes.size(), limit});
+    begin("for (;;)");
+    return id;
+}
+
+void CEmitter::continueLabel() {
+    if (const auto &loop = _frame.loops.back(); loop.hasContinue) {
+        line("cont_" + std::to_string(loop.id) + ":;");
+    }
+}
+
+void CEmitter::endLoop() {
+    const auto loop = _frame.loops.back();
+    _frame.loops.pop_back();
+    end();
+    if (loop.hasBreak) {
+        line("brk_" + std::to_string(loop.id) + ":;");
+    }
+    if (!loop.limit.empty()) {
+        release(loop.limit);
+    }
+}
+
+bool CEmitter::declaresFunction(Stmt *stmt) {
+    switch (stmt->kind) {
+        case StmtKind::FUNCTION: return true;
+        case StmtKind::BLOCK: {
+            for (const auto s: *static_cast<BlockStmt *>(stmt)->stmts) {
+                if (declaresFunction(s)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case StmtKind::IF: {
+            const auto ifStmt = static_cast<IfStmt *>(stmt);
+            return declaresFunction(ifStmt->thenBlock) ||
+                   (ifStmt->elseBlock != nullptr && declaresFunction(ifStmt->elseBlock));
+        }
+        case StmtKind::WHILE: return declaresFunction(static_cast<WhileStmt *>(stmt)->body);
+        case StmtKind::COUNTED_LOOP: return declaresFunction(static_cast<CountedLoopStmt *>(stmt)->body);
+        default: return false;
+    }
+}
+
+std::string CEmitter::quote(const std::string_view chars) {
+    std::string quoted = "\"";
+    for (const unsigned char c: chars) {
+        if (c == '"' || c == '\\' || c == '?') {
+            // Escaping ? keeps trigraphs out
+            quoted += '\\';
+            quoted += static_cast<char>(c);
+        } else if (c < 0x20 || c >= 0x7F) {
+            char escaped[5];
+            snprintf(escaped, sizeof(escaped), "\\%03o", c);
+            quoted += escaped;
+        } else {
+            quoted += static_cast<char>(c);
+        }
+    }
+    return quoted + "\"";
+}
+
+void CEmitter::visitExprStmt(ExprStmt *stmt) {
+    begin();
+    release(evaluate(stmt->expr));
+    end();
+}
+
+void CEmitter::visitVarStmt(VarStmt *stmt) {
+    begin();
+    const auto value = stmt->initializer ? evaluate(stmt->initializer) : define("SOX_NULL_VALUE");
+    if (stmt->slot >= 0) {
+        line("sox_define(&" + slotRef(0, stmt->slot) + ", " + value + ");");
+    } else {
+        line("sox_global_define(&globals[" + std::to_string(global(stmt->name->lexeme())) + "], " + value + ");");
+    }
+    end();
+}
+
+void CEmitter::visitBlockStmt(BlockStmt *stmt) {
+    if (stmt->slotCount == 0) {
+        for (const auto s: *stmt->stmts) {
+            emit(s);
+        }
+        return;
+    }
+    begin();
+    openScope(stmt->slotCount);
+    for (const auto s: *stmt->stmts) {
+        emit(s);
+    }
+    closeScope(_frame.scopes.back());
+    _frame.scopes.pop_back();
+    end();
+}
+
+void CEmitter::visitIfStmt(IfStmt *stmt) {
+    begin();
+    begin("if (" + condition(stmt->condition) + ")");
+    emit(stmt->thenBlock);
+    end();
+    if (stmt->elseBlock != nullptr) {
+        begin("else");
+        emit(stmt->elseBlock);
+        end();
+    }
+    end();
+}
+
+void CEmitter::visitWhileStmt(WhileStmt *stmt) {
+    begin();
+    beginLoop("");
+    if (stmt->condition != nullptr) {
+        line("if (!" + condition(stmt->condition) + ") break;");
+    }
+    emit(stmt->body);
+    continueLabel();
+    if (stmt->increment != nullptr) {
+        begin();
+        release(evaluate(stmt->increment));
+        end();
+    }
+    endLoop();
+    end();
+}
+
+void CEmitter::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    const auto counter = stmt->counter();
+    const auto op = stmt->condition->op;
+    begin();
+    const auto start = load(counter->name, counter->depth, counter->slot);
+    const auto limit = evaluate(stmt->limit());
+    // Same as the Interpreter, an int counter is kept in a C int32_t while the loop runs
+    const auto id = std::to_string(_nextId++);
+    const auto isNative = "f" + id, bound = "b" + id, current = "n" + id;
+    line("const bool " + isNative + " = " + start + ".type == SOX_INT && (" + limit + ".type == SOX_INT || " + limit +
+         ".type == SOX_DOUBLE);");
+    line("const double " + bound + " = " + limit + ".type == SOX_INT ? " + limit + ".as.i : " + limit + ".as.d;");
+    line("int32_t " + current + " = " + start + ".as.i;");
+    release(start);
+    beginLoop(limit);
+    begin("if (" + isNative + ")");
+    line("if (!(" + current + " " + comparisonOperator(op->type()) + " " + bound + ")) break;");
+    end();
+    begin("else");
+    const auto value = load(counter->name, counter->depth, counter->slot);
+    const auto compared = define(std::string(binaryFunction(op->type())) + "(" + value + ", " + limit + ", " +
+                                 std::to_string(op->line()) + ")");
+    release(value);
+    line("if (!sox_truthy(" + compared + ")) break;");
+    end();
+    emit(stmt->body);
+    continueLabel();
+    begin("if (" + isNative + ")");
+    line(current + " = (int32_t) ((uint32_t) " + current + " + " + std::to_string(stmt->step) + ");");
+    store(counter->name, counter->depth, counter->slot, "sox_int(" + current + ")");
+    end();
+    begin("else");
+    release(evaluate(stmt->increment));
+    end();
+    endLoop();
+    end();
+}
+
+void CEmitter::visitFunctionStmt(FunctionStmt *stmt) {
+    const auto name = "fn_" + std::to_string(_nextId++);
+    const auto isVarargs = !stmt->params->empty() && stmt->params->back()->isVararg;
+    auto enclosing = std::move(_frame);
+    _frame = Frame();
+    _frame.isFunction = true;
+    _frame.isHeap = declaresFunction(stmt->bodyBlock);
+    // The parameters share one scope with the body, varargs come packed into an array already
+    openScope(stmt->slotCount);
+    for (ulong i = 0; i < stmt->params->size(); ++i) {
+        line(slotRef(0, stmt->params->at(i)->slot) + " = sox_retain(args[" + std::to_string(i) + "]);");
+    }
+    for (const auto s: *stmt->bodyBlock->stmts) {
+        emit(s);
+    }
+    closeScopes(0);
+    line("return SOX_NULL_VALUE;");
+    _functions += "static sox_value " + name + "(sox_scope *env, sox_value *args) {\n" + _frame.code + "}\n\n";
+    _frame = std::move(enclosing);
+
+    begin();
+    const auto function = define("sox_function_new(" + name + ", " + environment() + ", " +
+                                 std::to_string(stmt->params->size()) + ", " + (isVarargs ? "true" : "false") + ")");
+    if (stmt->slot >= 0) {
+        line("sox_define(&" + slotRef(0, stmt->slot) + ", " + function + ");");
+    } else {
+        line("sox_global_define(&globals[" + std::to_string(global(stmt->name->lexeme())) + "], " + function + ");");
+    }
+    end();
+}
+
+void CEmitter::visitReturnStmt(ReturnStmt *stmt) {
+    begin();
+    std::string value;
+    if (stmt->isTailCall()) {
+        value = call(static_cast<CallExpr *>(stmt->value), true);
+    } else {
+        value = stmt->value ? evaluate(stmt->value) : define("SOX_NULL_VALUE");
+    }
+    for (const auto &loop: _frame.loops) {
+        if (!loop.limit.empty()) {
+            release(loop.limit);
+        }
+    }
+    closeScopes(0);
+    line("return " + value + ";");
+    end();
+}
+
+void CEmitter::visitBreakStmt([[maybe_unused]] BreakStmt *stmt) {
+    auto &loop = _frame.loops.back();
+    loop.hasBreak = true;
+    closeScopes(loop.scopeCount);
+    line("goto brk_" + std::to_string(loop.id) + ";");
+}
+
+void CEmitter::visitContinueStmt([[maybe_unused]] ContinueStmt *stmt) {
+    auto &loop = _frame.loops.back();
+    loop.hasContinue = true;
+    closeScopes(loop.scopeCount);
+    line("goto cont_" + std::to_string(loop.id) + ";");
+}
+
+std::string CEmitter::visitBinaryExpr(BinaryExpr *expr) {
+    const auto left = evaluate(expr->left);
+    const auto right = evaluate(expr->right);
+    const auto function = binaryFunction(expr->op->type());
+    const auto result = define(std::string(function ? function : "sox_invalid_binary") + "(" + left + ", " + right +
+                               ", " + std::to_string(expr->op->line()) + ")");
+    release(left);
+    release(right);
+    return result;
+}
+
+std::string CEmitter::visitGroupingExpr(GroupingExpr *expr) {
+    return evaluate(expr->expr);
+}
+
+std::string CEmitter::visitLiteralExpr(LiteralExpr *expr) {
+    const auto &constant = expr->constant;
+    if (constant.isInt()) {
+        return define("sox_int(" + std::to_string(constant.asInt()) + ")");
+    }
+    if (constant.isDouble()) {
+        return define("sox_double(" + doubleLiteral(constant.asDouble()) + ")");
+    }
+    if (constant.isBool()) {
+        return define(constant.asBool() ? "sox_bool(true)" : "sox_bool(false)");
+    }
+    if (constant.isString()) {
+        _strings.push_back(constant.as<StringValueHolder>()->value);
+        return define("sox_retain(strings[" + std::to_string(_strings.size() - 1) + "])");
+    }
+    return define("SOX_NULL_VALUE");
+}
+
+std::string CEmitter::visitUnaryExpr(UnaryExpr *expr) {
+    const auto right = evaluate(expr->right);
+    const auto line = std::to_string(expr->op->line());
+    switch (expr->op->type()) {
+        case MINUS: return define("sox_negate(" + right + ", " + line + ")");
+        case PLUS: return define("sox_plus(" + right + ", " + line + ")");
+        case BANG: {
+            const auto result = define("sox_not(" + right + ")");
+            release(right);
+            return result;
+        }
+        default: {
+            this->line("sox_error(" + line + ", \"Invalid operand\");");
+            return right;
+        }
+    }
+}
+
+std::string CEmitter::visitTernaryExpr(TernaryExpr *expr) {
+    // Every operand is evaluated, like in the Interpreter
+    const auto condition = evaluate(expr->condition);
+    const auto left = evaluate(expr->left);
+    const auto right = evaluate(expr->right);
+    const auto result = "t" + std::to_string(_nextId++);
+    line("sox_value " + result + ";");
+    begin("if (sox_truthy(" + condition + "))");
+    line(result + " = " + left + ";");
+    release(right);
+    end();
+    begin("else");
+    line(result + " = " + right + ";");
+    release(left);
+    end();
+    release(condition);
+    return result;
+}
+
+std::string CEmitter::visitVariableExpr(VariableExpr *expr) {
+    return load(expr->name, expr->depth, expr->slot);
+}
+
+std::string CEmitter::visitAssignExpr(AssignExpr *expr) {
+    const auto value = evaluate(expr->value);
+    store(expr->name, expr->depth, expr->slot, value);
+    return value;
+}
+
+std::string CEmitter::visitLogicalExpr(LogicalExpr *expr) {
+    // The left operand is the result unless it leaves the right one to decide
+    const auto result = evaluate(expr->left);
+    begin(std::string("if (") + (expr->op->type() == OR ? "!" : "") + "sox_truthy(" + result + "))");
+    release(result);
+    line(result + " = " + evaluate(expr->right) + ";");
+    end();
+    return result;
+}
+
+std::string CEmitter::call(CallExpr *expr, const bool isTailCall) {
+    const auto callee = evaluate(expr->callee);
+    const auto argc = std::to_string(expr->arguments->size());
+    const auto function = "f" + std::to_string(_nextId++);
+    line("sox_function *" + function + " = sox_resolve(" + callee + ", " + argc + ", " +
+         std::to_string(expr->paren->line()) + ");");
+    std::vector<std::string> args;
+    for (const auto argument: *expr->arguments) {
+        args.push_back(evaluate(argument));
+    }
+    std::string argv = "NULL";
+    if (!args.empty()) {
+        argv = "a" + std::to_string(_nextId++);
+        std::string values;
+        for (const auto &arg: args) {
+            values += (values.empty() ? "" : ", ") + arg;
+        }
+        line("sox_value " + argv + "[] = {" + values + "};");
+    }
+    const auto result = define(std::string(isTailCall ? "sox_tail_call(" : "sox_invoke(") + function + ", " + argc +
+                               ", " + argv + ")");
+    for (const auto &arg: args) {
+        release(arg);
+    }
+    release(callee);
+    return result;
+}
+
+std::string CEmitter::visitCallExpr(CallExpr *expr) {
+    return call(expr, false);
+}
+
+std::string CEmitter::visitArrayExpr(ArrayExpr *expr) {
+    const auto array = define("sox_array_new()");
+    for (const auto element: *expr->elements) {
+        line("sox_array_push(" + array + ", " + evaluate(element) + ");");
+    }
+    return array;
+}
+
+std::string CEmitter::visitIndexedCallExpr(IndexedCallExpr *expr) {
+    const auto callee = evaluate(expr->callee);
+    const auto index = evaluate(expr->index);
+    const auto result = define("sox_index(" + callee + ", " + index + ", " + std::to_string(expr->bracket->line()) +
+                               ")");
+    release(callee);
+    release(index);
+    return result;
+}
+
+std::string CEmitter::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
+    const auto callee = evaluate(expr->callee);
+    const auto index = evaluate(expr->index);
+    const auto value = evaluate(expr->value);
+    line("sox_set_index(" + callee + ", " + index + ", " + value + ", " + std::to_string(expr->bracket->line()) +
+         ");");
+    release(callee);
+    release(index);
+    return value;
+}
+
+std::string CEmitter::visitMapExpr(MapExpr *expr) {
+    const auto map = define("sox_map_new()");
+    for (const auto &[k, v]: *expr->elements) {
+        const auto key = evaluate(k);
+        const auto value = evaluate(v);
+        line("sox_map_set(" + map + ", " + key + ", " + value + ");");
+        release(key);
+        release(value);
+    }
+    return map;
+}
+
+std::string CEmitter::step(Expr *target, const Token *op, const bool isPrefix) {
+    const auto delta = std::to_string(op->type() == PLUS_PLUS ? 1 : -1);
+    const auto line = std::to_string(op->line());
+    // A successful step leaves numbers on both sides, so neither needs releasing
+    if (target->kind == ExprKind::VARIABLE) {
+        const auto variable = static_cast<VariableExpr *>(target);
+        const auto oldValue = load(variable->name, variable->depth, variable->slot);
+        const auto newValue = define("sox_step(" + oldValue + ", " + delta + ", " + line + ")");
+        store(variable->name, variable->depth, variable->slot, newValue);
+        return isPrefix ? newValue : oldValue;
+    }
+    if (target->kind == ExprKind::INDEXED_CALL) {
+        const auto indexed = static_cast<IndexedCallExpr *>(target);
+        const auto callee = evaluate(indexed->callee);
+        const auto index = evaluate(indexed->index);
+        const auto result = define("sox_step_index(" + callee + ", " + index + ", " + delta + ", " +
+                                   (isPrefix ? "true" : "false") + ", " + std::to_string(indexed->bracket->line()) +
+                                   ", " + line + ")");
+        release(callee);
+        release(index);
+        return result;
+    }
+    // Not assignable, only the resulting value matters
+    const auto value = evaluate(target);
+    const auto newValue = define("sox_step(" + value + ", " + delta + ", " + line + ")");
+    return isPrefix ? newValue : value;
+}
+
+std::string CEmitter::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    return step(expr->expr, expr->op, true);
+}
+
+std::string CEmitter::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    return step(expr->expr, expr->op, false);
+}
+
+std::string CEmitter::visitStringLiteralExpr(StringLiteralExpr *expr) {
+    std::vector<std::string> parts;
+    for (const auto value: *expr->values) {
+        parts.push_back(evaluate(value));
+    }
+    if (parts.empty()) {
+        return define("sox_string_new(\"\", 0)");
+    }
+    const auto array = "a" + std::to_string(_nextId++);
+    std::string values;
+    for (const auto &part: parts) {
+        values += (values.empty() ? "" : ", ") + part;
+    }
+    line("const sox_value " + array + "[] = {" + values + "};");
+    const auto result = define("sox_string_concat(" + std::to_string(parts.size()) + ", " + array + ")");
+    for (const auto &part: parts) {
+        release(part);
+    }
+    return result;
+}
+
+std::string CEmitter::visitInvariantExpr(InvariantExpr *expr) {
+    // Side effect free, so computing it again gives the value the Interpreter would have cached
+    return evaluate(expr->expr);
+}
@@ -0,0 +1,164 @@
+#ifndef C_EMITTER_HPP
+#define C_EMITTER_HPP
+#include <map>
+#include <string>
+
+#include "../parser/stmt.hpp"
+
+// Translates a resolved program to C code running on the runtime library in aot/runtime. Every function becomes a C
+// function taking the scope it was declared in, every top level statement one run by main, so that errors abandon
+// just that statement like in the Interpreter.
+//
+// Expressions leave their result in a fresh C variable owning a reference, which whoever uses it releases. Locals are
+// C variables, unless a function is declared somewhere within the function or the top level statement, then all of
+// its scopes are allocated on the heap where closures can capture them.
+class CEmitter final : public StmtVisitor<void>, public ExprVisitor<std::string> {
+    struct Scope {
+        int id;
+        int slotCount;
+        bool isHeap;
+    };
+
+    struct Loop {
+        int id;
+        // Number of scopes of the frame outside the loop
+        ulong scopeCount;
+        // Limit of a counted loop, released once the loop is left
+        std::string limit;
+        // Whether the body jumps to the labels, unused ones aren't emitted
+        bool hasBreak = false;
+        bool hasContinue = false;
+    };
+
+    // Code of the C function being emitted
+    struct Frame {
+        std::string code;
+        int indent = 1;
+        bool isFunction = false;
+        bool isHeap = false;
+        std::vector<Scope> scopes;
+        std::vector<Loop> loops;
+    };
+
+    Frame _frame;
+    std::string _functions;
+    std::vector<std::string> _globals;
+    std::map<std::string, int, std::less<> > _globalSlots;
+    std::vector<std::string> _strings;
+    int _nextId = 0;
+
+    CEmitter();
+
+    void line(const std::string &code);
+
+    // Opens a C block with the code before its brace
+    void begin(const std::string &code = "");
+
+    void end();
+
+    void emit(Stmt *stmt);
+
+    std::string evaluate(Expr *expr);
+
+    // Declares a C variable holding value
+    std::string define(const std::string &value);
+
+    void release(const std::string &value);
+
+    // Emits the truthiness of the value of expr
+    std::string condition(Expr *expr);
+
+    int global(std::string_view name);
+
+    // Lvalue of a local variable
+    [[nodiscard]] std::string slotRef(int depth, int slot) const;
+
+    // Scope new functions and heap scopes get as parent
+    [[nodiscard]] std::string environment() const;
+
+    void openScope(int slotCount);
+
+    void closeScope(const Scope &scope);
+
+    void closeScopes(ulong count);
+
+    std::string load(const Token *name, int depth, int slot);
+
+    void store(const Token *name, int depth, int slot, const std::string &value);
+
+    std::string step(Expr *target, const Token *op, bool isPrefix);
+
+    std::string call(CallExpr *expr, bool isTailCall);
+
+    // Opens the C loop of a loop statement, which checks its condition and runs its body before the continue label
+    int beginLoop(const std::string &limit);
+
+    void continueLabel();
+
+    void endLoop();
+
+    static bool declaresFunction(Stmt *stmt);
+
+    static std::string quote(std::string_view chars);
+
+protected:
+    void visitExprStmt(ExprStmt *stmt) override;
+
+    void visitVarStmt(VarStmt *stmt) override;
+
+    void visitBlockStmt(BlockStmt *stmt) override;
+
+    void visitIfStmt(IfStmt *stmt) override;
+
+    void visitWhileStmt(WhileStmt *stmt) override;
+
+    void visitFunctionStmt(FunctionStmt *stmt) override;
+
+    void visitReturnStmt(ReturnStmt *stmt) override;
+
+    void visitBreakStmt(BreakStmt *stmt) override;
+
+    void visitContinueStmt(ContinueStmt *stmt) override;
+
+    void visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
+    std::string visitBinaryExpr(BinaryExpr *expr) override;
+
+    std::string visitGroupingExpr(GroupingExpr *expr) override;
+
+    std::string visitLiteralExpr(LiteralExpr *expr) override;
+
+    std::string visitUnaryExpr(UnaryExpr *expr) override;
+
+    std::string visitTernaryExpr(TernaryExpr *expr) override;
+
+    std::string visitVariableExpr(VariableExpr *expr) override;
+
+    std::string visitAssignExpr(AssignExpr *expr) override;
+
+    std::string visitLogicalExpr(LogicalExpr *expr) override;
+
+    std::string visitCallExpr(CallExpr *expr) override;
+
+    std::string visitArrayExpr(ArrayExpr *expr) override;
+
+    std::string visitIndexedCallExpr(IndexedCallExpr *expr) override;
+
+    std::string visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+
+    std::string visitMapExpr(MapExpr *expr) override;
+
+    std::string visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+
+    std::string visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+
+    std::string visitStringLiteralExpr(StringLiteralExpr *expr) override;
+
+    std::string visitInvariantExpr(InvariantExpr *expr) override;
+
+public:
+    // C source of the program, the statements have to be resolved already
+    static std::string emit(std::vector<Stmt *> *stmts);
+};
+
+#endif //C_EMITTER_HPP
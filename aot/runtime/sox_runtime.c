@@ -0,0 +1,682 @@
+#include "sox_runtime.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static jmp_buf *currentStatement = NULL;
+
+static void *allocate(const size_t size) {
+    void *memory = malloc(size);
+    if (memory == NULL) {
+        fputs("Out of memory\n", stderr);
+        abort();
+    }
+    return memory;
+}
+
+static void *reallocate(void *memory, const size_t size) {
+    memory = realloc(memory, size);
+    if (memory == NULL) {
+        fputs("Out of memory\n", stderr);
+        abort();
+    }
+    return memory;
+}
+
+_Noreturn void sox_error(const int line, const char *message) {
+    printf("[%d] : %s\n", line, message);
+    fflush(stdout);
+    if (currentStatement == NULL) {
+        exit(1);
+    }
+    // Values held by the abandoned statement are leaked, like any cycle
+    longjmp(*currentStatement, 1);
+}
+
+void sox_run(void (*stmt)(void)) {
+    jmp_buf statement;
+    jmp_buf *enclosing = currentStatement;
+    currentStatement = &statement;
+    if (setjmp(statement) == 0) {
+        stmt();
+    }
+    currentStatement = enclosing;
+}
+
+// Growable buffer for building strings
+typedef struct {
+    char *chars;
+    size_t length;
+    size_t capacity;
+} buffer;
+
+static void buffer_append(buffer *buf, const char *chars, const size_t length) {
+    if (buf->length + length + 1 > buf->capacity) {
+        buf->capacity = (buf->length + length + 1) * 2;
+        buf->chars = reallocate(buf->chars, buf->capacity);
+    }
+    memcpy(buf->chars + buf->length, chars, length);
+    buf->length += length;
+    buf->chars[buf->length] = '\0';
+}
+
+// Same forms as Value::toString, containers and functions print as null
+static void append_value(buffer *buf, const sox_value value) {
+    char number[64];
+    switch (value.type) {
+        case SOX_NULL: buffer_append(buf, "null", 4);
+            break;
+        case SOX_BOOL: {
+            if (value.as.b) {
+                buffer_append(buf, "true", 4);
+            } else {
+                buffer_append(buf, "false", 5);
+            }
+            break;
+        }
+        case SOX_INT: buffer_append(buf, number, (size_t) snprintf(number, sizeof(number), "%d", value.as.i));
+            break;
+        case SOX_DOUBLE: {
+            // Large doubles don't fit the stack buffer
+            const int length = snprintf(NULL, 0, "%f", value.as.d);
+            char *chars = allocate((size_t) length + 1);
+            snprintf(chars, (size_t) length + 1, "%f", value.as.d);
+            buffer_append(buf, chars, (size_t) length);
+            free(chars);
+            break;
+        }
+        case SOX_OBJECT: {
+            if (value.as.o->type == SOX_STRING) {
+                const sox_string *string = (const sox_string *) value.as.o;
+                buffer_append(buf, string->chars, string->length);
+            } else {
+                buffer_append(buf, "null", 4);
+            }
+            break;
+        }
+    }
+}
+
+sox_value sox_string_new(const char *chars, const size_t length) {
+    sox_string *string = allocate(sizeof(sox_string) + length + 1);
+    string->obj.refs = 1;
+    string->obj.type = SOX_STRING;
+    string->length = length;
+    memcpy(string->chars, chars, length);
+    string->chars[length] = '\0';
+    return (sox_value) {SOX_OBJECT, {.o = &string->obj}};
+}
+
+static sox_value string_of(buffer *buf) {
+    const sox_value string = sox_string_new(buf->chars ? buf->chars : "", buf->length);
+    free(buf->chars);
+    return string;
+}
+
+sox_value sox_string_concat(const int count, const sox_value *parts) {
+    buffer buf = {NULL, 0, 0};
+    for (int i = 0; i < count; ++i) {
+        append_value(&buf, parts[i]);
+    }
+    return string_of(&buf);
+}
+
+sox_value sox_array_new(void) {
+    sox_array *array = allocate(sizeof(sox_array));
+    array->obj.refs = 1;
+    array->obj.type = SOX_ARRAY;
+    array->count = 0;
+    array->capacity = 0;
+    array->values = NULL;
+    return (sox_value) {SOX_OBJECT, {.o = &array->obj}};
+}
+
+void sox_array_push(const sox_value value, const sox_value element) {
+    sox_array *array = (sox_array *) value.as.o;
+    if (array->count == array->capacity) {
+        array->capacity = array->capacity < 8 ? 8 : array->capacity * 2;
+        array->values = reallocate(array->values, sizeof(sox_value) * (size_t) array->capacity);
+    }
+    array->values[array->count++] = element;
+}
+
+static bool equals(sox_value a, sox_value b);
+
+static bool callables_equal(const sox_callable *a, const sox_callable *b) {
+    if (a->count != b->count) {
+        return false;
+    }
+    for (int i = 0; i < a->count; ++i) {
+        if (a->functions[i] != b->functions[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static sox_map_entry *map_find(const sox_map *map, sox_value key);
+
+// Same as Value::equals
+static bool equals(const sox_value a, const sox_value b) {
+    if (a.type != b.type) {
+        return false;
+    }
+    switch (a.type) {
+        case SOX_NULL: return true;
+        case SOX_BOOL: return a.as.b == b.as.b;
+        case SOX_INT: return a.as.i == b.as.i;
+        case SOX_DOUBLE: return a.as.d == b.as.d;
+        case SOX_OBJECT: break;
+    }
+    if (a.as.o->type != b.as.o->type) {
+        return false;
+    }
+    switch (a.as.o->type) {
+        case SOX_STRING: {
+            const sox_string *x = (const sox_string *) a.as.o, *y = (const sox_string *) b.as.o;
+            return x->length == y->length && memcmp(x->chars, y->chars, x->length) == 0;
+        }
+        case SOX_ARRAY: {
+            const sox_array *x = (const sox_array *) a.as.o, *y = (const sox_array *) b.as.o;
+            if (x->count != y->count) {
+                return false;
+            }
+            for (int i = 0; i < x->count; ++i) {
+                if (!equals(x->values[i], y->values[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case SOX_MAP: {
+            const sox_map *x = (const sox_map *) a.as.o, *y = (const sox_map *) b.as.o;
+            if (x->count != y->count) {
+                return false;
+            }
+            for (int i = 0; i < x->capacity; ++i) {
+                if (x->entries[i].isUsed) {
+                    const sox_map_entry *entry = map_find(y, x->entries[i].key);
+                    if (!entry->isUsed || !equals(entry->value, x->entries[i].value)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+        case SOX_CALLABLE: return callables_equal((const sox_callable *) a.as.o, (const sox_callable *) b.as.o);
+    }
+    return false;
+}
+
+// Like Value::hash, strings hash their characters and other objects their identity
+static uint64_t hash(const sox_value value) {
+    uint64_t h = 0;
+    switch (value.type) {
+        case SOX_NULL: return 1;
+        case SOX_BOOL: return value.as.b ? 1231 : 1237;
+        case SOX_INT: return (uint64_t) (uint32_t) value.as.i * 0x9E3779B97F4A7C15ULL;
+        case SOX_DOUBLE: {
+            // Zero and negative zero are equal
+            const double d = value.as.d == 0 ? 0 : value.as.d;
+            memcpy(&h, &d, sizeof(h));
+            return (h ^ h >> 32) * 0x9E3779B97F4A7C15ULL;
+        }
+        case SOX_OBJECT: break;
+    }
+    if (value.as.o->type == SOX_STRING) {
+        const sox_string *string = (const sox_string *) value.as.o;
+        for (size_t i = 0; i < string->length; ++i) {
+            h = h * 31 + (unsigned char) string->chars[i];
+        }
+        return h * 0x9E3779B97F4A7C15ULL;
+    }
+    return (uint64_t) (uintptr_t) value.as.o * 0x9E3779B97F4A7C15ULL;
+}
+
+sox_value sox_map_new(void) {
+    sox_map *map = allocate(sizeof(sox_map));
+    map->obj.refs = 1;
+    map->obj.type = SOX_MAP;
+    map->count = 0;
+    map->capacity = 0;
+    map->entries = NULL;
+    return (sox_value) {SOX_OBJECT, {.o = &map->obj}};
+}
+
+// The entry holding key, or the free one it would go to
+static sox_map_entry *map_find(const sox_map *map, const sox_value key) {
+    if (map->capacity == 0) {
+        static sox_map_entry none = {false};
+        return &none;
+    }
+    const int mask = map->capacity - 1;
+    for (int index = (int) (hash(key) >> 32) & mask;; index = (index + 1) & mask) {
+        sox_map_entry *entry = &map->entries[index];
+        if (!entry->isUsed || equals(entry->key, key)) {
+            return entry;
+        }
+    }
+}
+
+static void map_grow(sox_map *map) {
+    sox_map_entry *entries = map->entries;
+    const int capacity = map->capacity;
+    map->capacity = capacity == 0 ? 8 : capacity * 2;
+    map->entries = calloc((size_t) map->capacity, sizeof(sox_map_entry));
+    if (map->entries == NULL) {
+        fputs("Out of memory\n", stderr);
+        abort();
+    }
+    for (int i = 0; i < capacity; ++i) {
+        if (entries[i].isUsed) {
+            *map_find(map, entries[i].key) = entries[i];
+        }
+    }
+    free(entries);
+}
+
+// The entry of key, inserted as null if missing
+static sox_map_entry *map_insert(sox_map *map, const sox_value key) {
+    if ((map->count + 1) * 4 > map->capacity * 3) {
+        map_grow(map);
+    }
+    sox_map_entry *entry = map_find(map, key);
+    if (!entry->isUsed) {
+        entry->isUsed = true;
+        entry->key = sox_retain(key);
+        entry->value = SOX_NULL_VALUE;
+        ++map->count;
+    }
+    return entry;
+}
+
+void sox_map_set(const sox_value map, const sox_value key, const sox_value value) {
+    sox_assign(&map_insert((sox_map *) map.as.o, key)->value, sox_retain(value));
+}
+
+// Same checks as Interpreter::elementRef
+static sox_value *element(const sox_value callee, const sox_value index, const int line, const bool insert) {
+    if (sox_is_object(callee, SOX_ARRAY)) {
+        const sox_array *array = (const sox_array *) callee.as.o;
+        if (index.type != SOX_INT) {
+            sox_error(line, "Array index not an integer");
+        }
+        if (index.as.i < 0 || index.as.i >= array->count) {
+            sox_error(line, "Array index out of range");
+        }
+        return &array->values[index.as.i];
+    }
+    if (sox_is_object(callee, SOX_MAP)) {
+        sox_map *map = (sox_map *) callee.as.o;
+        if (insert) {
+            return &map_insert(map, index)->value;
+        }
+        sox_map_entry *entry = map_find(map, index);
+        if (!entry->isUsed) {
+            sox_error(line, "Key not found");
+        }
+        return &entry->value;
+    }
+    sox_error(line, "Expression not an array or a map");
+}
+
+sox_value sox_index(const sox_value callee, const sox_value index, const int line) {
+    return sox_retain(*element(callee, index, line, false));
+}
+
+void sox_set_index(const sox_value callee, const sox_value index, const sox_value value, const int line) {
+    sox_assign(element(callee, index, line, true), sox_retain(value));
+}
+
+sox_value sox_step_index(const sox_value callee, const sox_value index, const int delta, const bool isPrefix,
+                         const int bracketLine, const int opLine) {
+    sox_value *target = element(callee, index, bracketLine, false);
+    const sox_value old = *target;
+    *target = sox_step(old, delta, opLine);
+    return isPrefix ? *target : old;
+}
+
+static void check_number(const sox_value value, const int line) {
+    if (value.type != SOX_INT && value.type != SOX_DOUBLE) {
+        sox_error(line, "Invalid operand type");
+    }
+}
+
+static double number(const sox_value value) {
+    return value.type == SOX_INT ? value.as.i : value.as.d;
+}
+
+sox_value sox_step(const sox_value value, const int delta, const int line) {
+    check_number(value, line);
+    if (value.type == SOX_DOUBLE) {
+        return sox_double(value.as.d + delta);
+    }
+    return sox_int((int32_t) ((uint32_t) value.as.i + (uint32_t) delta));
+}
+
+sox_value sox_binary_slow(const char op, const sox_value left, const sox_value right, const int line) {
+    if (op == '+' && (sox_is_object(left, SOX_STRING) || sox_is_object(right, SOX_STRING))) {
+        buffer buf = {NULL, 0, 0};
+        const sox_value operands[] = {left, right};
+        for (int i = 0; i < 2; ++i) {
+            if (!sox_is_object(operands[i], SOX_STRING) && operands[i].type != SOX_INT &&
+                operands[i].type != SOX_DOUBLE) {
+                free(buf.chars);
+                sox_error(0, "Invalid operand");
+            }
+            append_value(&buf, operands[i]);
+        }
+        return string_of(&buf);
+    }
+    check_number(left, line);
+    check_number(right, line);
+    if (left.type == SOX_DOUBLE || right.type == SOX_DOUBLE) {
+        const double l = number(left), r = number(right);
+        switch (op) {
+            case '+': return sox_double(l + r);
+            case '-': return sox_double(l - r);
+            case '*': return sox_double(l * r);
+            default: return sox_double(l / r);
+        }
+    }
+    const uint32_t l = (uint32_t) left.as.i, r = (uint32_t) right.as.i;
+    switch (op) {
+        case '+': return sox_int((int32_t) (l + r));
+        case '-': return sox_int((int32_t) (l - r));
+        case '*': return sox_int((int32_t) (l * r));
+        default: {
+            if (right.as.i == 0) {
+                sox_error(line, "Division by zero");
+            }
+            return sox_int(left.as.i / right.as.i);
+        }
+    }
+}
+
+sox_value sox_compare_slow(const char op, const sox_value left, const sox_value right, const int line) {
+    check_number(left, line);
+    check_number(right, line);
+    const double l = number(left), r = number(right);
+    switch (op) {
+        case '>': return sox_bool(l > r);
+        case 'g': return sox_bool(l >= r);
+        case '<': return sox_bool(l < r);
+        case 'l': return sox_bool(l <= r);
+        case '=': return sox_bool(l == r);
+        default: return sox_bool(l != r);
+    }
+}
+
+sox_value sox_invalid_binary(const sox_value left, const sox_value right, const int line) {
+    check_number(left, line);
+    check_number(right, line);
+    sox_error(line, "Invalid operand type");
+}
+
+sox_value sox_negate(const sox_value value, const int line) {
+    check_number(value, line);
+    if (value.type == SOX_DOUBLE) {
+        return sox_double(-value.as.d);
+    }
+    return sox_int((int32_t) (0u - (uint32_t) value.as.i));
+}
+
+sox_value sox_plus(const sox_value value, const int line) {
+    check_number(value, line);
+    return value;
+}
+
+static void function_release(sox_function *function) {
+    if (--function->refs == 0) {
+        if (function->env) {
+            sox_scope_release(function->env);
+        }
+        free(function);
+    }
+}
+
+void sox_free_object(sox_object *object) {
+    switch (object->type) {
+        case SOX_STRING: break;
+        case SOX_ARRAY: {
+            const sox_array *array = (const sox_array *) object;
+            for (int i = 0; i < array->count; ++i) {
+                sox_release(array->values[i]);
+            }
+            free(array->values);
+            break;
+        }
+        case SOX_MAP: {
+            const sox_map *map = (const sox_map *) object;
+            for (int i = 0; i < map->capacity; ++i) {
+                if (map->entries[i].isUsed) {
+                    sox_release(map->entries[i].key);
+                    sox_release(map->entries[i].value);
+                }
+            }
+            free(map->entries);
+            break;
+        }
+        case SOX_CALLABLE: {
+            const sox_callable *callable = (const sox_callable *) object;
+            for (int i = 0; i < callable->count; ++i) {
+                function_release(callable->functions[i]);
+            }
+            free(callable->functions);
+            break;
+        }
+    }
+    free(object);
+}
+
+// Same as RuntimeScope::mergeCallables, overloads stay sorted by arity and new ones replace old ones of their arity
+static void merge(sox_callable *old, const sox_callable *new) {
+    sox_function **functions = allocate(sizeof(sox_function *) * (size_t) (old->count + new->count));
+    int count = 0, i = 0, j = 0;
+    while (i < old->count || j < new->count) {
+        sox_function *function;
+        if (j == new->count || (i < old->count && old->functions[i]->arity < new->functions[j]->arity)) {
+            function = old->functions[i++];
+        } else {
+            if (i < old->count && old->functions[i]->arity == new->functions[j]->arity) {
+                function_release(old->functions[i++]);
+            }
+            function = new->functions[j++];
+            ++function->refs;
+        }
+        functions[count++] = function;
+    }
+    free(old->functions);
+    old->functions = functions;
+    old->count = count;
+}
+
+void sox_define(sox_value *target, const sox_value value) {
+    if (sox_is_object(*target, SOX_CALLABLE) && sox_is_object(value, SOX_CALLABLE)) {
+        merge((sox_callable *) target->as.o, (const sox_callable *) value.as.o);
+        sox_release(value);
+    } else {
+        sox_assign(target, value);
+    }
+}
+
+sox_scope *sox_scope_new(sox_scope *parent, const int count) {
+    sox_scope *scope = allocate(sizeof(sox_scope) + sizeof(sox_value) * (size_t) count);
+    scope->refs = 1;
+    scope->parent = parent;
+    if (parent) {
+        ++parent->refs;
+    }
+    scope->count = count;
+    for (int i = 0; i < count; ++i) {
+        scope->slots[i] = SOX_NULL_VALUE;
+    }
+    return scope;
+}
+
+void sox_scope_release(sox_scope *scope) {
+    while (scope && --scope->refs == 0) {
+        sox_scope *parent = scope->parent;
+        for (int i = 0; i < scope->count; ++i) {
+            sox_release(scope->slots[i]);
+        }
+        free(scope);
+        scope = parent;
+    }
+}
+
+sox_value sox_function_new(const sox_code code, sox_scope *env, const int arity, const bool isVarargs) {
+    sox_function *function = allocate(sizeof(sox_function));
+    function->refs = 1;
+    function->code = code;
+    function->env = env;
+    if (env) {
+        ++env->refs;
+    }
+    function->arity = arity;
+    function->isVarargs = isVarargs;
+    sox_callable *callable = allocate(sizeof(sox_callable));
+    callable->obj.refs = 1;
+    callable->obj.type = SOX_CALLABLE;
+    callable->count = 1;
+    callable->functions = allocate(sizeof(sox_function *));
+    callable->functions[0] = function;
+    return (sox_value) {SOX_OBJECT, {.o = &callable->obj}};
+}
+
+sox_function *sox_resolve(const sox_value callee, const int argc, const int line) {
+    if (!sox_is_object(callee, SOX_CALLABLE)) {
+        sox_error(line, "No callable found");
+    }
+    const sox_callable *callable = (const sox_callable *) callee.as.o;
+    for (int i = 0; i < callable->count; ++i) {
+        if (callable->functions[i]->arity == argc) {
+            return callable->functions[i];
+        }
+    }
+    for (int i = 0; i < callable->count; ++i) {
+        if (callable->functions[i]->isVarargs && argc >= callable->functions[i]->arity - 1) {
+            return callable->functions[i];
+        }
+    }
+    sox_error(line, "No callable found");
+}
+
+// Call made by the function returning last, taken by sox_invoke once it has returned
+static struct {
+    sox_function *function;
+    int argc;
+    int capacity;
+    sox_value *args;
+} tailCall = {NULL, 0, 0, NULL};
+
+sox_value sox_tail_call(sox_function *function, const int argc, const sox_value *args) {
+    if (argc > tailCall.capacity) {
+        tailCall.capacity = argc * 2;
+        tailCall.args = reallocate(tailCall.args, sizeof(sox_value) * (size_t) tailCall.capacity);
+    }
+    ++function->refs;
+    tailCall.function = function;
+    tailCall.argc = argc;
+    for (int i = 0; i < argc; ++i) {
+        tailCall.args[i] = sox_retain(args[i]);
+    }
+    return SOX_NULL_VALUE;
+}
+
+static sox_value run(const sox_function *function, const int argc, sox_value *args) {
+    if (!function->isVarargs) {
+        return function->code(function->env, args);
+    }
+    const int fixed = function->arity - 1;
+    sox_value packed[fixed + 1];
+    for (int i = 0; i < fixed; ++i) {
+        packed[i] = args[i];
+    }
+    packed[fixed] = sox_array_new();
+    for (int i = fixed; i < argc; ++i) {
+        sox_array_push(packed[fixed], sox_retain(args[i]));
+    }
+    const sox_value result = function->code(function->env, packed);
+    sox_release(packed[fixed]);
+    return result;
+}
+
+sox_value sox_invoke(sox_function *function, const int argc, sox_value *args) {
+    // The function may lose its last reference while it runs, if its variable gets redefined
+    ++function->refs;
+    sox_value result = run(function, argc, args);
+    function_release(function);
+    // Returned calls are made here after the returning function has been left, so they don't nest
+    while (tailCall.function != NULL) {
+        sox_function *next = tailCall.function;
+        const int count = tailCall.argc;
+        sox_value nextArgs[count > 0 ? count : 1];
+        memcpy(nextArgs, tailCall.args, sizeof(sox_value) * (size_t) count);
+        tailCall.function = NULL;
+        result = run(next, count, nextArgs);
+        for (int i = 0; i < count; ++i) {
+            sox_release(nextArgs[i]);
+        }
+        function_release(next);
+    }
+    return result;
+}
+
+static sox_value print(sox_scope *env, sox_value *args) {
+    (void) env;
+    buffer buf = {NULL, 0, 0};
+    append_value(&buf, args[0]);
+    fwrite(buf.chars, 1, buf.length, stdout);
+    free(buf.chars);
+    return SOX_NULL_VALUE;
+}
+
+static sox_value println(sox_scope *env, sox_value *args) {
+    print(env, args);
+    putchar('\n');
+    fflush(stdout);
+    return SOX_NULL_VALUE;
+}
+
+static sox_value length(sox_scope *env, sox_value *args) {
+    (void) env;
+    if (sox_is_object(args[0], SOX_ARRAY)) {
+        return sox_int(((const sox_array *) args[0].as.o)->count);
+    }
+    if (sox_is_object(args[0], SOX_MAP)) {
+        return sox_int(((const sox_map *) args[0].as.o)->count);
+    }
+    sox_error(0, "Not an array or a map");
+}
+
+void sox_init_globals(sox_global *globals, const int count) {
+    static const struct {
+        const char *name;
+        sox_code code;
+    } builtins[] = {{"print", print}, {"println", println}, {"length", length}};
+    for (int i = 0; i < count; ++i) {
+        for (size_t j = 0; j < sizeof(builtins) / sizeof(builtins[0]); ++j) {
+            if (strcmp(globals[i].name, builtins[j].name) == 0) {
+                sox_global_define(&globals[i], sox_function_new(builtins[j].code, NULL, 1, false));
+            }
+        }
+    }
+}
+
+_Noreturn void sox_undefined(const sox_global *global, const int line) {
+    buffer buf = {NULL, 0, 0};
+    buffer_append(&buf, "No such variable '", 18);
+    buffer_append(&buf, global->name, strlen(global->name));
+    buffer_append(&buf, "'", 1);
+    // Printed before jumping away, so the buffer can't be freed
+    printf("[%d] : %s\n", line, buf.chars);
+    fflush(stdout);
+    free(buf.chars);
+    if (currentStatement == NULL) {
+        exit(1);
+    }
+    longjmp(*currentStatement, 1);
+}
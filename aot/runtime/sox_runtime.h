@@ -0,0 +1,304 @@
+// Runtime library of the C code emitted by soxsh --emit-c. Values, containers, scopes and builtins behave like the
+// ones of the interpreter, objects and scopes are reference counted the same way.
+
+#ifndef SOX_RUNTIME_H
+#define SOX_RUNTIME_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SOX_NULL, SOX_BOOL, SOX_INT, SOX_DOUBLE, SOX_OBJECT
+} sox_type;
+
+typedef enum {
+    SOX_STRING, SOX_ARRAY, SOX_MAP, SOX_CALLABLE
+} sox_object_type;
+
+typedef struct sox_object {
+    uint32_t refs;
+    sox_object_type type;
+} sox_object;
+
+typedef struct {
+    sox_type type;
+
+    union {
+        bool b;
+        int32_t i;
+        double d;
+        sox_object *o;
+    } as;
+} sox_value;
+
+typedef struct {
+    sox_object obj;
+    size_t length;
+    char chars[];
+} sox_string;
+
+typedef struct {
+    sox_object obj;
+    int count;
+    int capacity;
+    sox_value *values;
+} sox_array;
+
+typedef struct {
+    bool isUsed;
+    sox_value key;
+    sox_value value;
+} sox_map_entry;
+
+// Open addressing, entries are never removed
+typedef struct {
+    sox_object obj;
+    int count;
+    int capacity;
+    sox_map_entry *entries;
+} sox_map;
+
+// Local scope of a block or a call that a closure may capture
+typedef struct sox_scope {
+    uint32_t refs;
+    struct sox_scope *parent;
+    int count;
+    sox_value slots[];
+} sox_scope;
+
+// Takes the scope the function was declared in and borrows the arguments, varargs already packed into an array
+typedef sox_value (*sox_code)(sox_scope *env, sox_value *args);
+
+typedef struct sox_function {
+    uint32_t refs;
+    sox_code code;
+    sox_scope *env;
+    int arity;
+    bool isVarargs;
+} sox_function;
+
+// Overloads of a function by arity, shared by every variable holding it
+typedef struct {
+    sox_object obj;
+    int count;
+    sox_function **functions;
+} sox_callable;
+
+typedef struct {
+    const char *name;
+    sox_value value;
+    bool isDefined;
+} sox_global;
+
+#define SOX_NULL_VALUE ((sox_value) {SOX_NULL, {.i = 0}})
+
+static inline sox_value sox_bool(const bool b) {
+    return (sox_value) {SOX_BOOL, {.b = b}};
+}
+
+static inline sox_value sox_int(const int32_t i) {
+    return (sox_value) {SOX_INT, {.i = i}};
+}
+
+static inline sox_value sox_double(const double d) {
+    return (sox_value) {SOX_DOUBLE, {.d = d}};
+}
+
+static inline bool sox_is_object(const sox_value value, const sox_object_type type) {
+    return value.type == SOX_OBJECT && value.as.o->type == type;
+}
+
+void sox_free_object(sox_object *object);
+
+static inline sox_value sox_retain(const sox_value value) {
+    if (value.type == SOX_OBJECT) {
+        ++value.as.o->refs;
+    }
+    return value;
+}
+
+static inline void sox_release(const sox_value value) {
+    if (value.type == SOX_OBJECT && --value.as.o->refs == 0) {
+        sox_free_object(value.as.o);
+    }
+}
+
+static inline bool sox_truthy(const sox_value value) {
+    switch (value.type) {
+        case SOX_BOOL: return value.as.b;
+        case SOX_INT: return value.as.i != 0;
+        case SOX_NULL: return false;
+        default: return true;
+    }
+}
+
+// Errors are reported like the interpreter does and abandon the top level statement being run
+_Noreturn void sox_error(int line, const char *message);
+
+// Runs a top level statement, returns once it is done or failed
+void sox_run(void (*stmt)(void));
+
+sox_value sox_string_new(const char *chars, size_t length);
+
+// Concatenates the string forms of the parts, for string interpolation
+sox_value sox_string_concat(int count, const sox_value *parts);
+
+sox_value sox_array_new(void);
+
+// Takes ownership of the element
+void sox_array_push(sox_value array, sox_value element);
+
+sox_value sox_map_new(void);
+
+void sox_map_set(sox_value map, sox_value key, sox_value value);
+
+// Element of an array or a map
+sox_value sox_index(sox_value callee, sox_value index, int line);
+
+void sox_set_index(sox_value callee, sox_value index, sox_value value, int line);
+
+// Steps an element by delta, returns the old or the new element
+sox_value sox_step_index(sox_value callee, sox_value index, int delta, bool isPrefix, int bracketLine, int opLine);
+
+sox_value sox_step(sox_value value, int delta, int line);
+
+sox_value sox_binary_slow(char op, sox_value left, sox_value right, int line);
+
+sox_value sox_compare_slow(char op, sox_value left, sox_value right, int line);
+
+// For operators the interpreter only type checks before failing
+sox_value sox_invalid_binary(sox_value left, sox_value right, int line);
+
+sox_value sox_negate(sox_value value, int line);
+
+sox_value sox_plus(sox_value value, int line);
+
+static inline sox_value sox_not(const sox_value value) {
+    return sox_bool(!sox_truthy(value));
+}
+
+// Ints wrap around like the 32-bit ints of the interpreter
+static inline sox_value sox_add(const sox_value left, const sox_value right, const int line) {
+    if (left.type == SOX_INT && right.type == SOX_INT) {
+        return sox_int((int32_t) ((uint32_t) left.as.i + (uint32_t) right.as.i));
+    }
+    return sox_binary_slow('+', left, right, line);
+}
+
+static inline sox_value sox_subtract(const sox_value left, const sox_value right, const int line) {
+    if (left.type == SOX_INT && right.type == SOX_INT) {
+        return sox_int((int32_t) ((uint32_t) left.as.i - (uint32_t) right.as.i));
+    }
+    return sox_binary_slow('-', left, right, line);
+}
+
+static inline sox_value sox_multiply(const sox_value left, const sox_value right, const int line) {
+    if (left.type == SOX_INT && right.type == SOX_INT) {
+        return sox_int((int32_t) ((uint32_t) left.as.i * (uint32_t) right.as.i));
+    }
+    return sox_binary_slow('*', left, right, line);
+}
+
+static inline sox_value sox_divide(const sox_value left, const sox_value right, const int line) {
+    if (left.type == SOX_INT && right.type == SOX_INT && right.as.i != 0) {
+        return sox_int(left.as.i / right.as.i);
+    }
+    return sox_binary_slow('/', left, right, line);
+}
+
+#define SOX_COMPARISON(name, op, code) \
+    static inline sox_value name(const sox_value left, const sox_value right, const int line) { \
+        if (left.type == SOX_INT && right.type == SOX_INT) { \
+            return sox_bool(left.as.i op right.as.i); \
+        } \
+        return sox_compare_slow(code, left, right, line); \
+    }
+
+SOX_COMPARISON(sox_greater, >, '>')
+
+SOX_COMPARISON(sox_greater_equal, >=, 'g')
+
+SOX_COMPARISON(sox_less, <, '<')
+
+SOX_COMPARISON(sox_less_equal, <=, 'l')
+
+SOX_COMPARISON(sox_equal, ==, '=')
+
+SOX_COMPARISON(sox_not_equal, !=, '!')
+
+#undef SOX_COMPARISON
+
+// Binds a variable, merging overloads when both the old and the new value are functions. Takes ownership of value.
+void sox_define(sox_value *target, sox_value value);
+
+static inline void sox_assign(sox_value *target, const sox_value value) {
+    const sox_value old = *target;
+    *target = value;
+    sox_release(old);
+}
+
+sox_scope *sox_scope_new(sox_scope *parent, int count);
+
+void sox_scope_release(sox_scope *scope);
+
+static inline sox_value *sox_scope_slot(sox_scope *scope, int depth, const int slot) {
+    while (depth-- > 0) {
+        scope = scope->parent;
+    }
+    return &scope->slots[slot];
+}
+
+static inline sox_value sox_scope_get(sox_scope *scope, const int depth, const int slot) {
+    return sox_retain(*sox_scope_slot(scope, depth, slot));
+}
+
+static inline void sox_scope_assign(sox_scope *scope, const int depth, const int slot, const sox_value value) {
+    sox_assign(sox_scope_slot(scope, depth, slot), value);
+}
+
+static inline void sox_scope_define(sox_scope *scope, const int slot, const sox_value value) {
+    sox_define(&scope->slots[slot], value);
+}
+
+// A callable holding a single function declared in env
+sox_value sox_function_new(sox_code code, sox_scope *env, int arity, bool isVarargs);
+
+// Picks the overload taking exactly argc arguments, or else a varargs one
+sox_function *sox_resolve(sox_value callee, int argc, int line);
+
+sox_value sox_invoke(sox_function *function, int argc, sox_value *args);
+
+// Leaves the call to the sox_invoke of the returning function, so that returned calls don't nest. Returns null as the
+// result of the returning function.
+sox_value sox_tail_call(sox_function *function, int argc, const sox_value *args);
+
+static inline sox_value sox_call(const sox_value callee, const int argc, sox_value *args, const int line) {
+    return sox_invoke(sox_resolve(callee, argc, line), argc, args);
+}
+
+// Defines the builtins among the globals
+void sox_init_globals(sox_global *globals, int count);
+
+_Noreturn void sox_undefined(const sox_global *global, int line);
+
+static inline sox_value sox_global_get(const sox_global *global, const int line) {
+    if (!global->isDefined) {
+        sox_undefined(global, line);
+    }
+    return sox_retain(global->value);
+}
+
+static inline void sox_global_assign(sox_global *global, const sox_value value, const int line) {
+    if (!global->isDefined) {
+        sox_release(value);
+        sox_undefined(global, line);
+    }
+    sox_assign(&global->value, value);
+}
+
+static inline void sox_global_define(sox_global *global, const sox_value value) {
+    sox_define(&global->value, value);
+    global->isDefined = true;
+}
+
+#endif //SOX_RUNTIME_H
@@ -10,14 +10,33 @@
 #include "runtime_scope.hpp"
 #include "../utils/utils.hpp"
 
+// The builtins themselves, also computed in place of calls the Resolver turned into intrinsics
+
+inline void builtinPrint(const Value &value) {
+    std::cout << value.toString();
+}
+
+inline void builtinPrintln(const Value &value) {
+    std::cout << value.toString() << std::endl;
+}
+
+inline Value builtinLength(const Value &holder) {
+    if (holder.isObject(ObjectType::ARRAY)) {
+        return Value::ofInt(static_cast<int>(holder.as<ArrayValueHolder>()->values.size()));
+    }
+    if (holder.isObject(ObjectType::MAP)) {
+        return Value::ofInt(static_cast<int>(holder.as<MapValueHolder>()->values.size()));
+    }
+    throw RuntimeError("Not an array or a map");
+}
+
 class PrintCallable final : public Callable {
 public:
     PrintCallable() = default;
 
-    std::shared_ptr<ValueHolder>
-    call(Interpreter *interpreter, const std::vector<std::shared_ptr<ValueHolder> > &args) override {
-        std::cout << args.at(0)->toString();
-        return nullptr;
+    Value call([[maybe_unused]] Interpreter *interpreter, const std::span<Value> args) override {
+        builtinPrint(args[0]);
+        return {};
     }
 
     int parameterSize() override {
@@ -29,10 +48,9 @@ class PrintlnCallable final : public Callable {
 public:
     PrintlnCallable() = default;
 
-    std::shared_ptr<ValueHolder>
-    call(Interpreter *interpreter, const std::vector<std::shared_ptr<ValueHolder> > &args) override {
-        std::cout << args.at(0)->toString() << std::endl;
-        return nullptr;
+    Value call([[maybe_unused]] Interpreter *interpreter, const std::span<Value> args) override {
+        builtinPrintln(args[0]);
+        return {};
     }
 
     int parameterSize() override {
@@ -44,16 +62,8 @@ class ArrayLengthCallable final : public Callable {
 public:
     ArrayLengthCallable() = default;
 
-    std::shared_ptr<ValueHolder>
-    call(Interpreter *interpreter, const std::vector<std::shared_ptr<ValueHolder> > &args) override {
-        const auto &holder = args.at(0);
-        if (const auto arrHolder = dynamic_cast<ArrayValueHolder *>(holder.get())) {
-            return std::make_shared<IntegerValueHolder>(arrHolder->values.size());
-        }
-        if (const auto map = dynamic_cast<MapValueHolder *>(holder.get())) {
-            return std::make_shared<IntegerValueHolder>(map->values.size());
-        }
-        throw RuntimeError("Not an array or a map");
+    Value call([[maybe_unused]] Interpreter *interpreter, const std::span<Value> args) override {
+        return builtinLength(args[0]);
     }
 
     int parameterSize() override {
@@ -62,9 +72,9 @@ public:
 };
 
 inline void initGlobalScope(RuntimeScope *globalScope) {
-    globalScope->define("print", std::make_shared<CallableHolder>(makeSharedCallable(new PrintCallable)));
-    globalScope->define("println", std::make_shared<CallableHolder>(makeSharedCallable(new PrintlnCallable)));
-    globalScope->define("length", std::make_shared<CallableHolder>(makeSharedCallable(new ArrayLengthCallable)));
+    globalScope->define("print", Value::ofObject(new CallableHolder(makeSharedCallable(new PrintCallable))));
+    globalScope->define("println", Value::ofObject(new CallableHolder(makeSharedCallable(new PrintlnCallable))));
+    globalScope->define("length", Value::ofObject(new CallableHolder(makeSharedCallable(new ArrayLengthCallable))));
 }
 
 #endif //BUILTIN_HPP
@@ -5,6 +5,7 @@
 #ifndef CALLABLE_HPP
 #define CALLABLE_HPP
 #include <memory>
+#include <span>
 
 #include "interpreter.hpp"
 #include "runtime_scope.hpp"
@@ -13,12 +14,25 @@ class Token;
 class FunctionStmt;
 class ValueHolder;
 
-class Callable {
+class Callable : public Traceable, public std::enable_shared_from_this<Callable> {
 public:
-    virtual ~Callable() = default;
+    Callable() {
+        track();
+    }
+
+    ~Callable() override = default;
+
+    [[nodiscard]] long refCount() const override {
+        return weak_from_this().use_count();
+    }
 
-    virtual std::shared_ptr<ValueHolder> call(Interpreter *interpreter,
-                                              const std::vector<std::shared_ptr<ValueHolder> > &args) = 0;
+    std::shared_ptr<void> pin() override {
+        return shared_from_this();
+    }
+
+    // The arguments live on the value stack of the caller and may be moved from. They have to be taken before anything
+    // else is evaluated, which may grow the stack.
+    virtual Value call(Interpreter *interpreter, std::span<Value> args) = 0;
 
     virtual int parameterSize() = 0;
 };
@@ -36,6 +50,29 @@ class FunctionCallable final : public Callable {
         return _fun->params->at(_fun->params->size() - 1)->isVararg;
     }
 
+    // Scope of a call with the parameters defined
+    std::shared_ptr<RuntimeScope> bindArguments(Interpreter *interpreter, const std::span<Value> args) const {
+        auto funScope = interpreter->acquireScope(_scope, _fun->slotCount);
+        auto argsIndex = 0;
+        for (const auto argsEnd = isVarargs ? _fun->params->size() - 1 : _fun->params->size(); argsIndex < argsEnd; ++
+             argsIndex) {
+            const auto param = _fun->params->at(argsIndex);
+            funScope->define(param->slot, std::move(args[argsIndex]));
+        }
+        if (isVarargs) {
+            auto varargs = _fun->localIndex >= 0
+                               ? funScope->local(_fun->localIndex, ObjectType::ARRAY)
+                               : Value::ofObject(new ArrayValueHolder());
+            const auto arrayParams = varargs.as<ArrayValueHolder>();
+            while (argsIndex < args.size()) {
+                arrayParams->values.push_back(std::move(args[argsIndex]));
+                ++argsIndex;
+            }
+            funScope->define(_fun->params->at(_fun->params->size() - 1)->slot, std::move(varargs));
+        }
+        return funScope;
+    }
+
 public:
     const bool isVarargs;
 
@@ -44,37 +81,47 @@ public:
         _isInitializer(isInitializer), isVarargs(isVarargsParams()) {
     }
 
-    std::shared_ptr<ValueHolder>
-    call(Interpreter *interpreter, const std::vector<std::shared_ptr<ValueHolder> > &args) override {
+    Value call(Interpreter *interpreter, const std::span<Value> args) override {
         if (_isInitializer) {
-            return _scope->get(0, "this");
+            // "this" is the first slot of the enclosing class scope
+            return _scope->get(0, 0);
         }
-        const auto funScope = std::make_shared<RuntimeScope>(_scope);
-        auto argsIndex = 0;
-        for (const auto argsEnd = isVarargs ? _fun->params->size() - 1 : _fun->params->size(); argsIndex < argsEnd; ++
-             argsIndex) {
-            const auto param = _fun->params->at(argsIndex);
-            funScope->define(param->name->lexeme(), args[argsIndex]);
+        if (Value result; interpreter->callNative(_fun, args, result)) {
+            return result;
         }
-        if (isVarargs) {
-            const auto arrayParams = std::make_shared<ArrayValueHolder>();
-            while (argsIndex < args.size()) {
-                arrayParams->values.push_back(args[argsIndex]);
-                ++argsIndex;
+        auto completion = interpreter->executeBlock(_fun->bodyBlock->stmts, bindArguments(interpreter, args));
+        // Returned calls are made here after the returning function has been left, so they don't nest
+        Interpreter::TailCall tailCall;
+        while (completion == Completion::RETURN && (tailCall = interpreter->takeTailCall()).callable) {
+            const auto function = dynamic_cast<FunctionCallable *>(tailCall.callable);
+            if (function == nullptr || function->_isInitializer) {
+                return tailCall.callable->call(interpreter, tailCall.args);
+            }
+            if (Value result; interpreter->callNative(function->_fun, tailCall.args, result)) {
+                return result;
             }
-            funScope->define(_fun->params->at(_fun->params->size() - 1)->name->lexeme(), arrayParams);
+            completion = interpreter->executeBlock(function->_fun->bodyBlock->stmts,
+                                                   function->bindArguments(interpreter, tailCall.args));
         }
-        try {
-            interpreter->executeBlock(_fun->bodyBlock->stmts, funScope);
-            return nullptr;
-        } catch (ReturnValue &ret) {
-            return ret.value;
+        if (completion == Completion::RETURN) {
+            return interpreter->takeReturnValue();
         }
+        return {};
     }
 
     int parameterSize() override {
         return static_cast<int>(_fun->params->size());
     }
+
+    void traverse(const Tracer visit) override {
+        if (_scope) {
+            visit(_scope.get());
+        }
+    }
+
+    void clearReferences() override {
+        _scope = nullptr;
+    }
 };
 
 #endif //CALLABLE_HPP
@@ -0,0 +1,263 @@
+#include "escape_analyzer.hpp"
+
+void EscapeAnalyzer::analyze(std::vector<Stmt *> *stmts) {
+    _scopes.emplace_back();
+    analyze(static_cast<const std::vector<Stmt *> *>(stmts));
+    _scopes.clear();
+}
+
+void EscapeAnalyzer::analyze(Expr *expr) {
+    expr->accept((ExprVisitor *) this);
+}
+
+void EscapeAnalyzer::analyze(Stmt *stmt) {
+    stmt->accept((StmtVisitor *) this);
+}
+
+void EscapeAnalyzer::analyze(const std::vector<Stmt *> *stmts) {
+    for (const auto stmt: *stmts) {
+        analyze(stmt);
+    }
+}
+
+Expr *EscapeAnalyzer::containerOf(Expr *expr) {
+    while (expr->kind == ExprKind::GROUPING) {
+        expr = static_cast<GroupingExpr *>(expr)->expr;
+    }
+    return expr->kind == ExprKind::ARRAY || expr->kind == ExprKind::MAP ? expr : nullptr;
+}
+
+void EscapeAnalyzer::analyzeInspected(Expr *container) {
+    while (container->kind == ExprKind::GROUPING) {
+        container = static_cast<GroupingExpr *>(container)->expr;
+    }
+    if (container->kind == ExprKind::ARRAY || container->kind == ExprKind::MAP) {
+        // A temporary, dropped as soon as it has been looked into
+        place({container, nullptr});
+        analyzeElements(container);
+    } else if (container->kind != ExprKind::VARIABLE) {
+        analyze(container);
+    }
+}
+
+void EscapeAnalyzer::analyzeElements(Expr *container) {
+    if (container->kind == ExprKind::ARRAY) {
+        visitArrayExpr(static_cast<ArrayExpr *>(container));
+    } else {
+        visitMapExpr(static_cast<MapExpr *>(container));
+    }
+}
+
+void EscapeAnalyzer::beginScope() {
+    _scopes.emplace_back();
+}
+
+void EscapeAnalyzer::endScope() {
+    for (const auto &[slot, candidate]: _scopes.back().candidates) {
+        place(candidate);
+    }
+    _scopes.pop_back();
+}
+
+void EscapeAnalyzer::declare(const int slot) {
+    auto &candidates = _scopes.back().candidates;
+    if (const auto it = candidates.find(slot); it != candidates.end()) {
+        place(it->second);
+        candidates.erase(it);
+    }
+}
+
+void EscapeAnalyzer::candidate(const int slot, Expr *site, FunctionStmt *function) {
+    declare(slot);
+    _scopes.back().candidates.emplace(slot, Candidate{site, function});
+}
+
+void EscapeAnalyzer::place(const Candidate &candidate) {
+    if (candidate.isEscaped) {
+        return;
+    }
+    const auto index = _scopes.back().localCount++;
+    if (candidate.site == nullptr) {
+        candidate.function->localIndex = index;
+    } else if (candidate.site->kind == ExprKind::ARRAY) {
+        static_cast<ArrayExpr *>(candidate.site)->localIndex = index;
+    } else {
+        static_cast<MapExpr *>(candidate.site)->localIndex = index;
+    }
+}
+
+void EscapeAnalyzer::visitBinaryExpr(BinaryExpr *expr) {
+    analyze(expr->left);
+    analyze(expr->right);
+}
+
+void EscapeAnalyzer::visitGroupingExpr(GroupingExpr *expr) {
+    analyze(expr->expr);
+}
+
+void EscapeAnalyzer::visitLiteralExpr([[maybe_unused]] LiteralExpr *expr) {
+}
+
+void EscapeAnalyzer::visitUnaryExpr(UnaryExpr *expr) {
+    analyze(expr->right);
+}
+
+void EscapeAnalyzer::visitTernaryExpr(TernaryExpr *expr) {
+    analyze(expr->condition);
+    analyze(expr->left);
+    analyze(expr->right);
+}
+
+void EscapeAnalyzer::visitVariableExpr(VariableExpr *expr) {
+    if (expr->depth < 0) {
+        return;
+    }
+    // Read as a value, so whatever holds it now may keep the container
+    auto &candidates = _scopes[_scopes.size() - 1 - expr->depth].candidates;
+    if (const auto it = candidates.find(expr->slot); it != candidates.end()) {
+        it->second.isEscaped = true;
+    }
+}
+
+void EscapeAnalyzer::visitAssignExpr(AssignExpr *expr) {
+    analyze(expr->value);
+}
+
+void EscapeAnalyzer::visitLogicalExpr(LogicalExpr *expr) {
+    analyze(expr->left);
+    analyze(expr->right);
+}
+
+void EscapeAnalyzer::visitCallExpr(CallExpr *expr) {
+    if (expr->intrinsic != Intrinsic::NONE) {
+        // Builtins only print or measure their argument
+        analyzeInspected(expr->arguments->front());
+        return;
+    }
+    analyze(expr->callee);
+    for (const auto arg: *expr->arguments) {
+        analyze(arg);
+    }
+}
+
+void EscapeAnalyzer::visitArrayExpr(ArrayExpr *expr) {
+    for (const auto element: *expr->elements) {
+        analyze(element);
+    }
+}
+
+void EscapeAnalyzer::visitIndexedCallExpr(IndexedCallExpr *expr) {
+    analyzeInspected(expr->callee);
+    analyze(expr->index);
+}
+
+void EscapeAnalyzer::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
+    analyzeInspected(expr->callee);
+    analyze(expr->index);
+    analyze(expr->value);
+}
+
+void EscapeAnalyzer::visitMapExpr(MapExpr *expr) {
+    for (const auto &[key, value]: *expr->elements) {
+        analyze(key);
+        analyze(value);
+    }
+}
+
+void EscapeAnalyzer::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    analyze(expr->expr);
+}
+
+void EscapeAnalyzer::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    analyze(expr->expr);
+}
+
+void EscapeAnalyzer::visitStringLiteralExpr(StringLiteralExpr *expr) {
+    for (const auto value: *expr->values) {
+        analyze(value);
+    }
+}
+
+void EscapeAnalyzer::visitInvariantExpr(InvariantExpr *expr) {
+    analyze(expr->expr);
+}
+
+void EscapeAnalyzer::visitExprStmt(ExprStmt *stmt) {
+    analyze(stmt->expr);
+}
+
+void EscapeAnalyzer::visitVarStmt(VarStmt *stmt) {
+    const auto container = stmt->initializer ? containerOf(stmt->initializer) : nullptr;
+    if (stmt->slot < 0 || container == nullptr) {
+        if (stmt->initializer) {
+            analyze(stmt->initializer);
+        }
+        if (stmt->slot >= 0) {
+            declare(stmt->slot);
+        }
+        return;
+    }
+    analyzeElements(container);
+    candidate(stmt->slot, container, nullptr);
+}
+
+void EscapeAnalyzer::visitBlockStmt(BlockStmt *stmt) {
+    // Blocks without locals run in the enclosing scope
+    const bool hasScope = stmt->slotCount > 0;
+    if (hasScope) {
+        beginScope();
+    }
+    analyze(static_cast<const std::vector<Stmt *> *>(stmt->stmts));
+    if (hasScope) {
+        endScope();
+    }
+}
+
+void EscapeAnalyzer::visitIfStmt(IfStmt *stmt) {
+    analyze(stmt->condition);
+    analyze(stmt->thenBlock);
+    if (stmt->elseBlock) {
+        analyze(stmt->elseBlock);
+    }
+}
+
+void EscapeAnalyzer::visitWhileStmt(WhileStmt *stmt) {
+    if (stmt->condition) {
+        analyze(stmt->condition);
+    }
+    analyze(stmt->body);
+    if (stmt->increment) {
+        analyze(stmt->increment);
+    }
+}
+
+void EscapeAnalyzer::visitFunctionStmt(FunctionStmt *stmt) {
+    if (stmt->slot >= 0) {
+        declare(stmt->slot);
+    }
+    // The parameters and the body share the scope of a call
+    beginScope();
+    if (!stmt->params->empty() && stmt->params->back()->isVararg) {
+        candidate(stmt->params->back()->slot, nullptr, stmt);
+    }
+    analyze(static_cast<const std::vector<Stmt *> *>(stmt->bodyBlock->stmts));
+    endScope();
+}
+
+void EscapeAnalyzer::visitReturnStmt(ReturnStmt *stmt) {
+    if (stmt->value) {
+        analyze(stmt->value);
+    }
+}
+
+void EscapeAnalyzer::visitBreakStmt([[maybe_unused]] BreakStmt *stmt) {
+}
+
+void EscapeAnalyzer::visitContinueStmt([[maybe_unused]] ContinueStmt *stmt) {
+}
+
+void EscapeAnalyzer::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    analyze(stmt->condition);
+    analyze(stmt->body);
+    analyze(stmt->increment);
+}
@@ -0,0 +1,117 @@
+#ifndef ESCAPE_ANALYZER_HPP
+#define ESCAPE_ANALYZER_HPP
+#include <map>
+#include <vector>
+
+#include "../parser/expr.hpp"
+#include "../parser/stmt.hpp"
+
+// Finds the arrays and maps that never leave the scope creating them, so that the Interpreter can keep them in the
+// region of that scope and reuse them instead of allocating new ones. A container doesn't escape if it's indexed right
+// away or passed to a builtin, or if it initializes a local variable that is only ever used like that, and the same
+// goes for the varargs of a function. Reading such a variable anywhere else, including in a nested function, lets its
+// container escape.
+//
+// Runs on the resolved tree, mirroring the scopes the Interpreter creates.
+class EscapeAnalyzer final : public ExprVisitor<void>, public StmtVisitor<void> {
+    // Container held by a local variable, or the varargs of function if site is null
+    struct Candidate {
+        Expr *site;
+        FunctionStmt *function;
+        bool isEscaped = false;
+    };
+
+    struct Scope {
+        // Candidates by slot
+        std::map<int, Candidate> candidates;
+        int localCount = 0;
+    };
+
+    // The first scope is the global one, whose variables are never candidates
+    std::vector<Scope> _scopes;
+
+    void analyze(Expr *expr);
+
+    void analyze(Stmt *stmt);
+
+    void analyze(const std::vector<Stmt *> *stmts);
+
+    // Analyzes a container that is only looked into, like by indexing it, which doesn't let it escape
+    void analyzeInspected(Expr *container);
+
+    void analyzeElements(Expr *container);
+
+    void beginScope();
+
+    void endScope();
+
+    // Settles the candidate a redeclared slot held so far
+    void declare(int slot);
+
+    void candidate(int slot, Expr *site, FunctionStmt *function);
+
+    // Gives the candidate a local index in the current scope unless it escaped
+    void place(const Candidate &candidate);
+
+    static Expr *containerOf(Expr *expr);
+
+protected:
+    void visitBinaryExpr(BinaryExpr *expr) override;
+
+    void visitGroupingExpr(GroupingExpr *expr) override;
+
+    void visitLiteralExpr(LiteralExpr *expr) override;
+
+    void visitUnaryExpr(UnaryExpr *expr) override;
+
+    void visitTernaryExpr(TernaryExpr *expr) override;
+
+    void visitVariableExpr(VariableExpr *expr) override;
+
+    void visitAssignExpr(AssignExpr *expr) override;
+
+    void visitLogicalExpr(LogicalExpr *expr) override;
+
+    void visitCallExpr(CallExpr *expr) override;
+
+    void visitArrayExpr(ArrayExpr *expr) override;
+
+    void visitIndexedCallExpr(IndexedCallExpr *expr) override;
+
+    void visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+
+    void visitMapExpr(MapExpr *expr) override;
+
+    void visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+
+    void visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+
+    void visitStringLiteralExpr(StringLiteralExpr *expr) override;
+
+    void visitInvariantExpr(InvariantExpr *expr) override;
+
+    void visitExprStmt(ExprStmt *stmt) override;
+
+    void visitVarStmt(VarStmt *stmt) override;
+
+    void visitBlockStmt(BlockStmt *stmt) override;
+
+    void visitIfStmt(IfStmt *stmt) override;
+
+    void visitWhileStmt(WhileStmt *stmt) override;
+
+    void visitFunctionStmt(FunctionStmt *stmt) override;
+
+    void visitReturnStmt(ReturnStmt *stmt) override;
+
+    void visitBreakStmt(BreakStmt *stmt) override;
+
+    void visitContinueStmt(ContinueStmt *stmt) override;
+
+    void visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
+public:
+    void analyze(std::vector<Stmt *> *stmts);
+};
+
+#endif //ESCAPE_ANALYZER_HPP
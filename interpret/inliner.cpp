@@ -0,0 +1,299 @@
+#include "inliner.hpp"
+
+Inliner::Inliner(VariableAnalyzer *analyzer, Arena *arena, const int budget): _analyzer(analyzer), _arena(arena),
+                                                                              _budget(budget) {
+}
+
+void Inliner::consider(FunctionStmt *function) {
+    const auto stmts = function->bodyBlock->stmts;
+    if (_budget <= 0 || stmts->size() != 1 || stmts->front()->kind != StmtKind::RETURN) {
+        return;
+    }
+    const auto body = static_cast<ReturnStmt *>(stmts->front())->value;
+    if (body == nullptr) {
+        return;
+    }
+    for (const auto param: *function->params) {
+        if (param->isVararg) {
+            return;
+        }
+    }
+    Candidate candidate{function, body, std::vector<int>(function->params->size()), {}};
+    if (int size = 0; inspect(body, candidate, size) && size <= _budget) {
+        _candidates.insert_or_assign(function->name, std::move(candidate));
+    }
+}
+
+Expr *Inliner::inlineCall(const CallExpr *call) {
+    if (call->callee->kind != ExprKind::VARIABLE) {
+        return nullptr;
+    }
+    const auto binding = _analyzer->bindings.find(static_cast<const VariableExpr *>(call->callee));
+    if (binding == _analyzer->bindings.end() || _analyzer->reassigned.contains(binding->second)) {
+        return nullptr;
+    }
+    const auto it = _candidates.find(binding->second);
+    if (it == _candidates.end() || it->second.useCounts.size() != call->arguments->size()) {
+        return nullptr;
+    }
+    const auto &candidate = it->second;
+    const auto &args = *call->arguments;
+    // An argument changing anything could change what the others read, then all of them keep their order
+    bool keepsAllInOrder = false;
+    for (const auto arg: args) {
+        keepsAllInOrder = keepsAllInOrder || hasSideEffects(arg);
+    }
+    std::vector<bool> keepsOrder(args.size());
+    for (ulong i = 0; i < args.size(); ++i) {
+        if (keepsAllInOrder || !isDuplicable(args[i])) {
+            keepsOrder[i] = true;
+            if (candidate.useCounts[i] != 1) {
+                return nullptr;
+            }
+        } else if (!_analyzer->isTrivial(args[i])) {
+            // Evaluated again by every further read, which gives the same value once the first one succeeded
+            keepsOrder[i] = true;
+            if (candidate.useCounts[i] == 0) {
+                return nullptr;
+            }
+        }
+    }
+    std::vector<bool> isRead(args.size());
+    bool hasOperated = false;
+    int last = -1;
+    for (const auto step: candidate.steps) {
+        if (step < 0) {
+            hasOperated = true;
+        } else if (keepsOrder[step] && !isRead[step]) {
+            if (hasOperated || step < last) {
+                return nullptr;
+            }
+            isRead[step] = true;
+            last = step;
+        }
+    }
+    return copy(candidate.body, &candidate, args);
+}
+
+int Inliner::paramOf(const FunctionStmt *function, const Expr *expr) const {
+    const auto binding = _analyzer->bindings.find(static_cast<const VariableExpr *>(expr));
+    if (binding == _analyzer->bindings.end()) {
+        return -1;
+    }
+    for (ulong i = 0; i < function->params->size(); ++i) {
+        if (function->params->at(i)->name == binding->second) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool Inliner::inspect(Expr *expr, Candidate &candidate, int &size) const {
+    ++size;
+    switch (expr->kind) {
+        case ExprKind::LITERAL: return true;
+        case ExprKind::VARIABLE: {
+            // Anything else could be bound to another variable at the call site
+            const auto param = paramOf(candidate.function, expr);
+            if (param < 0) {
+                return false;
+            }
+            ++candidate.useCounts[param];
+            candidate.steps.push_back(param);
+            return true;
+        }
+        case ExprKind::GROUPING: return inspect(static_cast<GroupingExpr *>(expr)->expr, candidate, size);
+        case ExprKind::UNARY: {
+            if (!inspect(static_cast<UnaryExpr *>(expr)->right, candidate, size)) {
+                return false;
+            }
+            candidate.steps.push_back(-1);
+            return true;
+        }
+        case ExprKind::BINARY: {
+            const auto binary = static_cast<BinaryExpr *>(expr);
+            if (!inspect(binary->left, candidate, size) || !inspect(binary->right, candidate, size)) {
+                return false;
+            }
+            candidate.steps.push_back(-1);
+            return true;
+        }
+        case ExprKind::LOGICAL: {
+            // The left operand decides whether the right one is evaluated at all
+            const auto logical = static_cast<LogicalExpr *>(expr);
+            if (!inspect(logical->left, candidate, size)) {
+                return false;
+            }
+            candidate.steps.push_back(-1);
+            return inspect(logical->right, candidate, size);
+        }
+        case ExprKind::TERNARY: {
+            const auto ternary = static_cast<TernaryExpr *>(expr);
+            return inspect(ternary->condition, candidate, size) && inspect(ternary->left, candidate, size) &&
+                   inspect(ternary->right, candidate, size);
+        }
+        case ExprKind::INDEXED_CALL: {
+            const auto indexed = static_cast<IndexedCallExpr *>(expr);
+            if (!inspect(indexed->callee, candidate, size) || !inspect(indexed->index, candidate, size)) {
+                return false;
+            }
+            candidate.steps.push_back(-1);
+            return true;
+        }
+        case ExprKind::STRING_LITERAL: {
+            for (const auto value: *static_cast<StringLiteralExpr *>(expr)->values) {
+                if (!inspect(value, candidate, size)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            // Calls, assignments and containers
+            return false;
+    }
+}
+
+bool Inliner::hasSideEffects(const Expr *expr) {
+    switch (expr->kind) {
+        case ExprKind::LITERAL:
+        case ExprKind::VARIABLE: return false;
+        case ExprKind::GROUPING: return hasSideEffects(static_cast<const GroupingExpr *>(expr)->expr);
+        case ExprKind::UNARY: return hasSideEffects(static_cast<const UnaryExpr *>(expr)->right);
+        case ExprKind::INVARIANT: return hasSideEffects(static_cast<const InvariantExpr *>(expr)->expr);
+        case ExprKind::BINARY: {
+            const auto binary = static_cast<const BinaryExpr *>(expr);
+            return hasSideEffects(binary->left) || hasSideEffects(binary->right);
+        }
+        case ExprKind::LOGICAL: {
+            const auto logical = static_cast<const LogicalExpr *>(expr);
+            return hasSideEffects(logical->left) || hasSideEffects(logical->right);
+        }
+        case ExprKind::TERNARY: {
+            const auto ternary = static_cast<const TernaryExpr *>(expr);
+            return hasSideEffects(ternary->condition) || hasSideEffects(ternary->left) ||
+                   hasSideEffects(ternary->right);
+        }
+        case ExprKind::INDEXED_CALL: {
+            const auto indexed = static_cast<const IndexedCallExpr *>(expr);
+            return hasSideEffects(indexed->callee) || hasSideEffects(indexed->index);
+        }
+        case ExprKind::STRING_LITERAL: {
+            for (const auto value: *static_cast<const StringLiteralExpr *>(expr)->values) {
+                if (hasSideEffects(value)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case ExprKind::ARRAY: {
+            for (const auto element: *static_cast<const ArrayExpr *>(expr)->elements) {
+                if (hasSideEffects(element)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case ExprKind::MAP: {
+            for (const auto &[key, value]: *static_cast<const MapExpr *>(expr)->elements) {
+                if (hasSideEffects(key) || hasSideEffects(value)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        default:
+            // Calls, assignments and steps
+            return true;
+    }
+}
+
+bool Inliner::isDuplicable(const Expr *expr) {
+    switch (expr->kind) {
+        case ExprKind::LITERAL:
+        case ExprKind::VARIABLE: return true;
+        case ExprKind::GROUPING: return isDuplicable(static_cast<const GroupingExpr *>(expr)->expr);
+        case ExprKind::UNARY: return isDuplicable(static_cast<const UnaryExpr *>(expr)->right);
+        case ExprKind::BINARY: {
+            const auto binary = static_cast<const BinaryExpr *>(expr);
+            return isDuplicable(binary->left) && isDuplicable(binary->right);
+        }
+        case ExprKind::LOGICAL: {
+            const auto logical = static_cast<const LogicalExpr *>(expr);
+            return isDuplicable(logical->left) && isDuplicable(logical->right);
+        }
+        case ExprKind::TERNARY: {
+            const auto ternary = static_cast<const TernaryExpr *>(expr);
+            return isDuplicable(ternary->condition) && isDuplicable(ternary->left) && isDuplicable(ternary->right);
+        }
+        case ExprKind::INDEXED_CALL: {
+            const auto indexed = static_cast<const IndexedCallExpr *>(expr);
+            return isDuplicable(indexed->callee) && isDuplicable(indexed->index);
+        }
+        case ExprKind::STRING_LITERAL: {
+            for (const auto value: *static_cast<const StringLiteralExpr *>(expr)->values) {
+                if (!isDuplicable(value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            // Calls, assignments and containers, which would be created twice
+            return false;
+    }
+}
+
+Expr *Inliner::copy(Expr *expr, const Candidate *candidate, const std::vector<Expr *> &args) {
+    switch (expr->kind) {
+        case ExprKind::VARIABLE: {
+            if (const auto param = candidate ? paramOf(candidate->function, expr) : -1; param >= 0) {
+                // An argument read more than once gets a copy for every read
+                return candidate->useCounts[param] == 1 ? args[param] : copy(args[param], nullptr, args);
+            }
+            const auto variable = static_cast<VariableExpr *>(expr);
+            const auto result = _arena->make<VariableExpr>(variable->name);
+            if (const auto binding = _analyzer->bindings.find(variable); binding != _analyzer->bindings.end()) {
+                _analyzer->bindings[result] = binding->second;
+            }
+            return result;
+        }
+        case ExprKind::GROUPING:
+            return _arena->make<GroupingExpr>(copy(static_cast<GroupingExpr *>(expr)->expr, candidate, args));
+        case ExprKind::UNARY: {
+            const auto unary = static_cast<UnaryExpr *>(expr);
+            return _arena->make<UnaryExpr>(copy(unary->right, candidate, args), unary->op);
+        }
+        case ExprKind::BINARY: {
+            const auto binary = static_cast<BinaryExpr *>(expr);
+            const auto left = copy(binary->left, candidate, args);
+            return _arena->make<BinaryExpr>(left, binary->op, copy(binary->right, candidate, args));
+        }
+        case ExprKind::LOGICAL: {
+            const auto logical = static_cast<LogicalExpr *>(expr);
+            const auto left = copy(logical->left, candidate, args);
+            return _arena->make<LogicalExpr>(left, copy(logical->right, candidate, args), logical->op);
+        }
+        case ExprKind::TERNARY: {
+            const auto ternary = static_cast<TernaryExpr *>(expr);
+            const auto condition = copy(ternary->condition, candidate, args);
+            const auto left = copy(ternary->left, candidate, args);
+            return _arena->make<TernaryExpr>(left, copy(ternary->right, candidate, args), condition);
+        }
+        case ExprKind::INDEXED_CALL: {
+            const auto indexed = static_cast<IndexedCallExpr *>(expr);
+            const auto callee = copy(indexed->callee, candidate, args);
+            return _arena->make<IndexedCallExpr>(callee, indexed->bracket, copy(indexed->index, candidate, args));
+        }
+        case ExprKind::STRING_LITERAL: {
+            const auto values = _arena->make<std::vector<Expr *> >();
+            for (const auto value: *static_cast<StringLiteralExpr *>(expr)->values) {
+                values->push_back(copy(value, candidate, args));
+            }
+            return _arena->make<StringLiteralExpr>(values);
+        }
+        default:
+            // Literals are shared, nothing else gets copied
+            return expr;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef INLINER_HPP
+#define INLINER_HPP
+#include <unordered_map>
+
+#include "variable_analyzer.hpp"
+#include "../utils/arena.hpp"
+
+// Replaces calls of small functions with their bodies. Candidates are functions whose body is a single return of an
+// expression computing on nothing but their parameters, without calls or assignments, so they can't recurse. A call
+// is inlined when its callee is bound to such a function and never reassigned, which also rules out overloads.
+//
+// The arguments are substituted for the parameters. Literals and declared variables can be read any number of times
+// at any point. Other arguments are only substituted when the body still evaluates them in order before anything
+// else, so that errors and side effects happen as they would in the call. Side effect free ones may then be
+// evaluated again by further reads, the others have to be read exactly once.
+class Inliner final {
+    struct Candidate {
+        FunctionStmt *function;
+        Expr *body;
+        std::vector<int> useCounts;
+        // Parameters in the order the body reads them, -1 for operations that may fail or skip what follows
+        std::vector<int> steps;
+    };
+
+    VariableAnalyzer *_analyzer;
+    Arena *_arena;
+    // Maximum number of nodes in the body of a candidate, 0 disables inlining
+    int _budget;
+    std::unordered_map<const Token *, Candidate> _candidates;
+
+    int paramOf(const FunctionStmt *function, const Expr *expr) const;
+
+    // Returns false if the expression can't be inlined
+    bool inspect(Expr *expr, Candidate &candidate, int &size) const;
+
+    static bool hasSideEffects(const Expr *expr);
+
+    // Side effect free expressions which can be evaluated again, without creating containers
+    static bool isDuplicable(const Expr *expr);
+
+    // Copies an expression, with the arguments in place of the parameters of the candidate if there is one
+    Expr *copy(Expr *expr, const Candidate *candidate, const std::vector<Expr *> &args);
+
+public:
+    static constexpr int DEFAULT_BUDGET = 16;
+
+    Inliner(VariableAnalyzer *analyzer, Arena *arena, int budget);
+
+    // Remembers the function if calls of it can be inlined, after its body has been optimized
+    void consider(FunctionStmt *function);
+
+    // Returns nullptr if the call has to stay
+    Expr *inlineCall(const CallExpr *call);
+};
+
+#endif //INLINER_HPP
@@ -4,514 +4,698 @@
 
 #include "interpreter.hpp"
 
+#include <iterator>
 #include <memory>
+#include <utility>
 
 #include "builtin.hpp"
 #include "callable.hpp"
+#include "../utils/collector.hpp"
 #include "../utils/exception.hpp"
 #include "../utils/logger.hpp"
 
-void Interpreter::execute(Stmt *stmt) const {
-    stmt->accept((StmtVisitor<void> *) this);
+Completion Interpreter::execute(Stmt *stmt) const {
+    return stmt->accept((StmtVisitor<Completion> *) this);
 }
 
-std::shared_ptr<ValueHolder> Interpreter::evaluate(Expr *expr) const {
-    if (expr == nullptr) return nullptr;
-    return expr->accept((ExprVisitor<std::shared_ptr<ValueHolder> > *) this);
+Value Interpreter::evaluate(Expr *expr) const {
+    if (expr == nullptr) return {};
+    return expr->accept((ExprVisitor<Value> *) this);
 }
 
-bool Interpreter::checkNumberOperand(Token *op, const std::initializer_list<std::shared_ptr<ValueHolder> > operands) {
+bool Interpreter::checkNumberOperand(const Token *op, const std::initializer_list<Value> operands) {
     for (const auto &operand: operands) {
-        if (const auto d = dynamic_cast<DoubleValueHolder *>(operand.get()); d != nullptr) {
-            continue;
+        if (!operand.isNumber()) {
+            throw RuntimeError(op, "Invalid operand type");
         }
-        if (const auto integer = dynamic_cast<IntegerValueHolder *>(operand.get()); integer != nullptr) {
-            continue;
-        }
-        throw RuntimeError(op, "Invalid operand type");
     }
     return true;
 }
 
-bool Interpreter::isTruthy(const std::shared_ptr<ValueHolder> &value) {
-    if (value == nullptr) return false;
-    if (const auto b = dynamic_cast<BoolValueHolder *>(value.get()); b != nullptr) {
-        return b->value;
-    }
-    if (const auto integer = dynamic_cast<IntegerValueHolder *>(value.get()); integer != nullptr) {
-        return integer->value != 0;
-    }
-    return true;
-}
-
-Interpreter::Interpreter() {
-    _globalScope = std::make_shared<RuntimeScope>(std::shared_ptr<RuntimeScope>(nullptr));
+Interpreter::Interpreter(const bool isJitEnabled) {
+    _jit.isEnabled = isJitEnabled;
+    _globalScope = std::allocate_shared<RuntimeScope>(PoolAllocator<RuntimeScope>(), nullptr);
     _currentScope = _globalScope;
     initGlobalScope(_globalScope.get());
 }
 
 Interpreter::~Interpreter() = default;
 
-void Interpreter::interpret(std::vector<Stmt *> *stmts) const {
+void Interpreter::interpret(std::vector<Stmt *> *stmts) {
     for (const auto stmt: *stmts) {
         try {
-            execute(stmt);
+            // A jump outside of the loop or function it belongs to, which the Resolver reported, ends its statement
+            if (execute(stmt) == Completion::RETURN) {
+                takeReturnValue();
+                if (auto tailCall = takeTailCall(); tailCall.callable) {
+                    tailCall.callable->call(this, tailCall.args);
+                }
+            }
         } catch (const RuntimeError &e) {
-            Logger::instance()->logRuntimeError(e._token->line(), e._message);
+            Logger::instance()->logRuntimeError(e._token ? e._token->line() : 0, e._message);
         }
     }
 }
 
-void Interpreter::visitExprStmt(ExprStmt *stmt) {
+Completion Interpreter::visitExprStmt(ExprStmt *stmt) {
     evaluate(stmt->expr);
+    return Completion::NORMAL;
+}
+
+Completion Interpreter::visitVarStmt(VarStmt *stmt) {
+    if (stmt->slot >= 0) {
+        _currentScope->define(stmt->slot, evaluate(stmt->initializer));
+    } else {
+        _globalScope->define(stmt->name->lexeme(), evaluate(stmt->initializer));
+    }
+    return Completion::NORMAL;
+}
+
+Completion Interpreter::visitBlockStmt(BlockStmt *stmt) {
+    if (stmt->slotCount == 0) {
+        for (const auto s: *stmt->stmts) {
+            if (const auto completion = execute(s); completion != Completion::NORMAL) {
+                return completion;
+            }
+        }
+        return Completion::NORMAL;
+    }
+    return executeBlock(stmt->stmts, acquireScope(_currentScope, stmt->slotCount));
+}
+
+Completion Interpreter::visitIfStmt(IfStmt *stmt) {
+    if (evaluate(stmt->condition).isTruthy()) {
+        return execute(stmt->thenBlock);
+    }
+    if (stmt->elseBlock != nullptr) {
+        return execute(stmt->elseBlock);
+    }
+    return Completion::NORMAL;
+}
+
+Completion Interpreter::visitWhileStmt(WhileStmt *stmt) {
+    const auto enclosingBase = beginInvariants(stmt->invariantCount);
+    auto completion = Completion::NORMAL;
+    try {
+        while (stmt->condition == nullptr || evaluate(stmt->condition).isTruthy()) {
+            if ((completion = execute(stmt->body)) == Completion::BREAK || completion == Completion::RETURN) {
+                break;
+            }
+            Collector::instance()->maybeCollect();
+            evaluate(stmt->increment);
+        }
+    } catch ([[maybe_unused]] const RuntimeError &err) {
+        endInvariants(enclosingBase);
+        throw;
+    }
+    endInvariants(enclosingBase);
+    return completion == Completion::RETURN ? completion : Completion::NORMAL;
 }
 
-void Interpreter::visitVarStmt(VarStmt *stmt) {
-    const std::shared_ptr<ValueHolder> val = stmt->initializer != nullptr
-                                                 ? evaluate(stmt->initializer)
-                                                 : RuntimeScope::UNINITIALIZED_OBJECT;
-    _currentScope->define(stmt->name->lexeme(), val);
+Completion Interpreter::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    const auto counter = stmt->counter();
+    const auto op = stmt->condition->op;
+    const auto start = lookup(counter->name, counter->depth, counter->slot);
+    const auto limit = evaluate(stmt->limit());
+    const auto enclosingBase = beginInvariants(stmt->invariantCount);
+    auto completion = Completion::NORMAL;
+    try {
+        if (start.isInt() && limit.isNumber()) {
+            // Only the increment assigns the counter, so it can be kept here and written back after every step
+            const double bound = limit.asNumber();
+            auto inRange = [type = op->type(), bound](const int current) {
+                switch (type) {
+                    case LESS: return current < bound;
+                    case LESS_EQUAL: return current <= bound;
+                    case GREATER: return current > bound;
+                    default: return current >= bound;
+                }
+            };
+            for (int current = start.asInt(); inRange(current);) {
+                if ((completion = execute(stmt->body)) == Completion::BREAK || completion == Completion::RETURN) {
+                    break;
+                }
+                Collector::instance()->maybeCollect();
+                // Wraps around at the ends of the int range, like stepping the counter with ++ or --
+                current = static_cast<int>(static_cast<uint>(current) + stmt->step);
+                assign(counter->name, counter->depth, counter->slot, Value::ofInt(current));
+            }
+        } else {
+            while (binaryOp(op, lookup(counter->name, counter->depth, counter->slot), limit).isTruthy()) {
+                if ((completion = execute(stmt->body)) == Completion::BREAK || completion == Completion::RETURN) {
+                    break;
+                }
+                Collector::instance()->maybeCollect();
+                evaluate(stmt->increment);
+            }
+        }
+    } catch ([[maybe_unused]] const RuntimeError &err) {
+        endInvariants(enclosingBase);
+        throw;
+    }
+    endInvariants(enclosingBase);
+    return completion == Completion::RETURN ? completion : Completion::NORMAL;
+}
+
+ulong Interpreter::beginInvariants(const int count) {
+    const auto enclosingBase = _invariantBase;
+    _invariantBase = _invariants.size();
+    _invariants.resize(_invariantBase + count);
+    return enclosingBase;
 }
 
-void Interpreter::visitBlockStmt(BlockStmt *stmt) {
-    const auto blockScope = std::make_shared<RuntimeScope>(_currentScope);
-    executeBlock(stmt->stmts, blockScope);
+void Interpreter::endInvariants(const ulong enclosingBase) {
+    _invariants.resize(_invariantBase);
+    _invariantBase = enclosingBase;
 }
 
-void Interpreter::visitIfStmt(IfStmt *stmt) {
-    if (const auto conditionVal = evaluate(stmt->condition); isTruthy(conditionVal)) {
-        execute(stmt->thenBlock);
-    } else if (stmt->elseBlock != nullptr) {
-        execute(stmt->elseBlock);
+Completion Interpreter::visitFunctionStmt(FunctionStmt *stmt) {
+    const auto func = Value::ofObject(
+        new CallableHolder(makeSharedCallable(new FunctionCallable(stmt, _currentScope, false))));
+    if (stmt->slot >= 0) {
+        _currentScope->define(stmt->slot, func);
+    } else {
+        _globalScope->define(stmt->name->lexeme(), func);
     }
+    return Completion::NORMAL;
 }
 
-void Interpreter::visitWhileStmt(WhileStmt *stmt) {
-    auto conditionValue = evaluate(stmt->condition);
-    while (isTruthy(conditionValue)) {
-        execute(stmt->body);
-        conditionValue = evaluate(stmt->condition);
+Completion Interpreter::visitReturnStmt(ReturnStmt *stmt) {
+    if (stmt->isTailCall()) {
+        const auto call = static_cast<CallExpr *>(stmt->value);
+        auto callee = evaluate(call->callee);
+        const auto callable = resolveCall(call, callee);
+        _tailCall = {std::move(callee), callable, evaluateArguments(call)};
+        return Completion::RETURN;
     }
+    // A bare return gives null
+    _returnValue = stmt->value ? evaluate(stmt->value) : Value();
+    return Completion::RETURN;
 }
 
-void Interpreter::visitFunctionStmt(FunctionStmt *stmt) {
-    const auto func = std::static_pointer_cast<ValueHolder>(
-        std::make_shared<CallableHolder>(makeSharedCallable(new FunctionCallable(stmt, _currentScope, false))));
-    _currentScope->define(stmt->name->lexeme(), func);
+Completion Interpreter::visitBreakStmt([[maybe_unused]] BreakStmt *stmt) {
+    return Completion::BREAK;
 }
 
-void Interpreter::visitReturnStmt(ReturnStmt *stmt) {
-    throw ReturnValue(evaluate(stmt->value));
+Completion Interpreter::visitContinueStmt([[maybe_unused]] ContinueStmt *stmt) {
+    return Completion::CONTINUE;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitBinaryExpr(BinaryExpr *expr) {
-    auto leftVal = evaluate(expr->left);
-    auto rightVal = evaluate(expr->right);
-    std::shared_ptr<ValueHolder> result;
-    switch (expr->op->type()) {
-        case PLUS: {
-            if (isString(leftVal) || isString(rightVal)) {
-                auto str = asString(leftVal) + asString(rightVal);
-                result = std::make_shared<StringValueHolder>(str);
-            } else {
-                checkNumberOperand(expr->op, {leftVal, rightVal});
-                if (isDouble(leftVal) || isDouble(rightVal)) {
-                    result = std::make_shared<DoubleValueHolder>(asDouble(leftVal) + asDouble(rightVal));
-                } else {
-                    result = std::make_shared<IntegerValueHolder>(asInt(leftVal) + asInt(rightVal));
+Value Interpreter::visitBinaryExpr(BinaryExpr *expr) {
+    using enum BinarySpecialization;
+    const auto leftVal = evaluate(expr->left);
+    const auto rightVal = evaluate(expr->right);
+    const bool isInt = leftVal.isInt() && rightVal.isInt();
+    const bool isDouble = leftVal.isDouble() && rightVal.isDouble();
+    switch (expr->specialization) {
+        case UNINITIALIZED: {
+            expr->specialization = specialize(expr->op->type(), leftVal, rightVal);
+            return binaryOp(expr->op, leftVal, rightVal);
+        }
+        case GENERIC: return binaryOp(expr->op, leftVal, rightVal);
+        case INT_ADD: if (isInt) return Value::ofInt(leftVal.asInt() + rightVal.asInt());
+            break;
+        case INT_SUBTRACT: if (isInt) return Value::ofInt(leftVal.asInt() - rightVal.asInt());
+            break;
+        case INT_MULTIPLY: if (isInt) return Value::ofInt(leftVal.asInt() * rightVal.asInt());
+            break;
+        case INT_DIVIDE: {
+            if (isInt) {
+                // An error of the operation, the operand types still match
+                if (rightVal.asInt() == 0) {
+                    throw RuntimeError(expr->op, "Division by zero");
                 }
+                return Value::ofInt(leftVal.asInt() / rightVal.asInt());
             }
             break;
         }
-        case MINUS: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            if (isDouble(leftVal) || isDouble(rightVal)) {
-                result = std::make_shared<DoubleValueHolder>(asDouble(leftVal) - asDouble(rightVal));
-            } else {
-                result = std::make_shared<IntegerValueHolder>(asInt(leftVal) - asInt(rightVal));
-            }
+        case INT_GREATER: if (isInt) return Value::ofBool(leftVal.asInt() > rightVal.asInt());
             break;
-        }
-        case SLASH: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            if (isDouble(leftVal) || isDouble(rightVal)) {
-                result = std::make_shared<DoubleValueHolder>(asDouble(leftVal) / asDouble(rightVal));
-            } else {
-                result = std::make_shared<IntegerValueHolder>(asInt(leftVal) / asInt(rightVal));
-            }
+        case INT_GREATER_EQUAL: if (isInt) return Value::ofBool(leftVal.asInt() >= rightVal.asInt());
             break;
-        }
-        case STAR: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            if (isDouble(leftVal) || isDouble(rightVal)) {
-                result = std::make_shared<DoubleValueHolder>(asDouble(leftVal) * asDouble(rightVal));
-            } else {
-                result = std::make_shared<IntegerValueHolder>(asInt(leftVal) * asInt(rightVal));
-            }
+        case INT_LESS: if (isInt) return Value::ofBool(leftVal.asInt() < rightVal.asInt());
             break;
-        }
-        case GREATER: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            result = std::make_shared<BoolValueHolder>(asDouble(leftVal) > asDouble(rightVal));
+        case INT_LESS_EQUAL: if (isInt) return Value::ofBool(leftVal.asInt() <= rightVal.asInt());
             break;
-        }
-        case GREATER_EQUAL: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            result = std::make_shared<BoolValueHolder>(asDouble(leftVal) >= asDouble(rightVal));
+        case INT_EQUAL: if (isInt) return Value::ofBool(leftVal.asInt() == rightVal.asInt());
             break;
-        }
-        case LESS: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            result = std::make_shared<BoolValueHolder>(asDouble(leftVal) < asDouble(rightVal));
+        case INT_NOT_EQUAL: if (isInt) return Value::ofBool(leftVal.asInt() != rightVal.asInt());
             break;
-        }
-        case LESS_EQUAL: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            result = std::make_shared<BoolValueHolder>(asDouble(leftVal) <= asDouble(rightVal));
+        case DOUBLE_ADD: if (isDouble) return Value::ofDouble(leftVal.asDouble() + rightVal.asDouble());
             break;
-        }
-        case EQUAL_EQUAL: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            result = std::make_shared<BoolValueHolder>(asDouble(leftVal) == asDouble(rightVal));
+        case DOUBLE_SUBTRACT: if (isDouble) return Value::ofDouble(leftVal.asDouble() - rightVal.asDouble());
             break;
-        }
-        case BANG_EQUAL: {
-            checkNumberOperand(expr->op, {leftVal, rightVal});
-            result = std::make_shared<BoolValueHolder>(asDouble(leftVal) != asDouble(rightVal));
+        case DOUBLE_MULTIPLY: if (isDouble) return Value::ofDouble(leftVal.asDouble() * rightVal.asDouble());
+            break;
+        case DOUBLE_DIVIDE: if (isDouble) return Value::ofDouble(leftVal.asDouble() / rightVal.asDouble());
+            break;
+        case DOUBLE_GREATER: if (isDouble) return Value::ofBool(leftVal.asDouble() > rightVal.asDouble());
+            break;
+        case DOUBLE_GREATER_EQUAL: if (isDouble) return Value::ofBool(leftVal.asDouble() >= rightVal.asDouble());
+            break;
+        case DOUBLE_LESS: if (isDouble) return Value::ofBool(leftVal.asDouble() < rightVal.asDouble());
+            break;
+        case DOUBLE_LESS_EQUAL: if (isDouble) return Value::ofBool(leftVal.asDouble() <= rightVal.asDouble());
+            break;
+        case DOUBLE_EQUAL: if (isDouble) return Value::ofBool(leftVal.asDouble() == rightVal.asDouble());
+            break;
+        case DOUBLE_NOT_EQUAL: if (isDouble) return Value::ofBool(leftVal.asDouble() != rightVal.asDouble());
+            break;
+        case STRING_CONCAT: {
+            if (leftVal.isString() && rightVal.isString()) {
+                return makeString(leftVal.as<StringValueHolder>()->value + rightVal.as<StringValueHolder>()->value);
+            }
             break;
         }
+    }
+    // The operands changed type, stop guessing
+    expr->specialization = GENERIC;
+    return binaryOp(expr->op, leftVal, rightVal);
+}
+
+BinarySpecialization Interpreter::specialize(const TokenType type, const Value &leftVal, const Value &rightVal) {
+    using enum BinarySpecialization;
+    if (type == PLUS && leftVal.isString() && rightVal.isString()) {
+        return STRING_CONCAT;
+    }
+    if (leftVal.isInt() && rightVal.isInt()) {
+        switch (type) {
+            case PLUS: return INT_ADD;
+            case MINUS: return INT_SUBTRACT;
+            case STAR: return INT_MULTIPLY;
+            case SLASH: return INT_DIVIDE;
+            case GREATER: return INT_GREATER;
+            case GREATER_EQUAL: return INT_GREATER_EQUAL;
+            case LESS: return INT_LESS;
+            case LESS_EQUAL: return INT_LESS_EQUAL;
+            case EQUAL_EQUAL: return INT_EQUAL;
+            case BANG_EQUAL: return INT_NOT_EQUAL;
+            default: return GENERIC;
+        }
+    }
+    if (leftVal.isDouble() && rightVal.isDouble()) {
+        switch (type) {
+            case PLUS: return DOUBLE_ADD;
+            case MINUS: return DOUBLE_SUBTRACT;
+            case STAR: return DOUBLE_MULTIPLY;
+            case SLASH: return DOUBLE_DIVIDE;
+            case GREATER: return DOUBLE_GREATER;
+            case GREATER_EQUAL: return DOUBLE_GREATER_EQUAL;
+            case LESS: return DOUBLE_LESS;
+            case LESS_EQUAL: return DOUBLE_LESS_EQUAL;
+            case EQUAL_EQUAL: return DOUBLE_EQUAL;
+            case BANG_EQUAL: return DOUBLE_NOT_EQUAL;
+            default: return GENERIC;
+        }
+    }
+    // Mixed operands go through the generic conversions
+    return GENERIC;
+}
+
+Value Interpreter::binaryOp(const Token *op, const Value &leftVal, const Value &rightVal) {
+    const auto type = op->type();
+    if (type == PLUS && (leftVal.isString() || rightVal.isString())) {
+        return makeString(asString(leftVal) + asString(rightVal));
+    }
+    checkNumberOperand(op, {leftVal, rightVal});
+    const bool isDouble = leftVal.isDouble() || rightVal.isDouble();
+    switch (type) {
+        case PLUS: {
+            if (isDouble) {
+                return Value::ofDouble(leftVal.asNumber() + rightVal.asNumber());
+            }
+            return Value::ofInt(leftVal.asInt() + rightVal.asInt());
+        }
+        case MINUS: {
+            if (isDouble) {
+                return Value::ofDouble(leftVal.asNumber() - rightVal.asNumber());
+            }
+            return Value::ofInt(leftVal.asInt() - rightVal.asInt());
+        }
+        case SLASH: {
+            if (isDouble) {
+                return Value::ofDouble(leftVal.asNumber() / rightVal.asNumber());
+            }
+            if (rightVal.asInt() == 0) {
+                throw RuntimeError(op, "Division by zero");
+            }
+            return Value::ofInt(leftVal.asInt() / rightVal.asInt());
+        }
+        case STAR: {
+            if (isDouble) {
+                return Value::ofDouble(leftVal.asNumber() * rightVal.asNumber());
+            }
+            return Value::ofInt(leftVal.asInt() * rightVal.asInt());
+        }
+        case GREATER: return Value::ofBool(leftVal.asNumber() > rightVal.asNumber());
+        case GREATER_EQUAL: return Value::ofBool(leftVal.asNumber() >= rightVal.asNumber());
+        case LESS: return Value::ofBool(leftVal.asNumber() < rightVal.asNumber());
+        case LESS_EQUAL: return Value::ofBool(leftVal.asNumber() <= rightVal.asNumber());
+        case EQUAL_EQUAL: return Value::ofBool(leftVal.asNumber() == rightVal.asNumber());
+        case BANG_EQUAL: return Value::ofBool(leftVal.asNumber() != rightVal.asNumber());
         default: {
-            throw RuntimeError(expr->op, "Invalid operand type");
+            throw RuntimeError(op, "Invalid operand type");
         }
     }
-    return result;
-}
-
-bool Interpreter::isDouble(const std::shared_ptr<ValueHolder> &value) {
-    if (const auto d = dynamic_cast<DoubleValueHolder *>(value.get()); d != nullptr) {
-        return true;
-    }
-    return false;
 }
 
-double Interpreter::asDouble(const std::shared_ptr<ValueHolder> &value) {
-    if (isDouble(value)) {
-        return dynamic_cast<DoubleValueHolder *>(value.get())->value;
-    }
-    if (const auto integer = dynamic_cast<IntegerValueHolder *>(value.get()); integer != nullptr) {
-        return integer->value;
+std::string Interpreter::asString(const Value &value) {
+    if (value.isString() || value.isNumber()) {
+        return value.toString();
     }
     throw RuntimeError("Invalid operand");
 }
 
-int Interpreter::asInt(const std::shared_ptr<ValueHolder> &value) {
-    return static_cast<int>(asDouble(value));
-}
-
-bool Interpreter::isString(const std::shared_ptr<ValueHolder> &value) {
-    if (const auto string = dynamic_cast<StringValueHolder *>(value.get()); string != nullptr) {
-        return true;
-    }
-    return false;
-}
-
-std::string Interpreter::asString(const std::shared_ptr<ValueHolder> &value) {
-    if (const auto string = dynamic_cast<StringValueHolder *>(value.get()); string != nullptr) {
-        return string->value;
-    }
-    if (const auto integer = dynamic_cast<IntegerValueHolder *>(value.get()); integer != nullptr) {
-        return std::to_string(integer->value);
-    }
-    if (const auto doubleValue = dynamic_cast<DoubleValueHolder *>(value.get()); doubleValue != nullptr) {
-        return std::to_string(doubleValue->value);
-    }
-    throw RuntimeError("Invalid operand");
+Value Interpreter::visitGroupingExpr(GroupingExpr *expr) {
+    return evaluate(expr->expr);
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitGroupingExpr(GroupingExpr *expr) {
-    return evaluate(expr->expr);
+Value Interpreter::visitLiteralExpr(LiteralExpr *expr) {
+    return expr->constant;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitLiteralExpr(LiteralExpr *expr) {
-    std::shared_ptr<ValueHolder> result;
-    switch (expr->value->type()) {
-        case STRING: {
-            auto str = expr->value->lexeme();
-            result = std::make_shared<StringValueHolder>(str);
-            break;
-        }
-        case TRUE: {
-            result = std::make_shared<BoolValueHolder>(true);
-            break;
-        }
-        case FALSE: {
-            result = std::make_shared<BoolValueHolder>(false);
-            break;
-        }
-        case DOUBLE: {
-            result = std::make_shared<DoubleValueHolder>(std::stod(expr->value->lexeme()));
-            break;
-        }
-        case INT: {
-            result = std::make_shared<IntegerValueHolder>(std::stoi(expr->value->lexeme()));
-            break;
-        }
-        default: {
-            throw RuntimeError("Invalid literal");
-        }
-    }
-    return result;
+Value Interpreter::visitUnaryExpr(UnaryExpr *expr) {
+    return unaryOp(expr->op, evaluate(expr->right));
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitUnaryExpr(UnaryExpr *expr) {
-    auto right = evaluate(expr->right);
-    switch (expr->op->type()) {
+Value Interpreter::unaryOp(const Token *op, const Value &right) {
+    switch (op->type()) {
         case PLUS: {
-            checkNumberOperand(expr->op, {right});
+            checkNumberOperand(op, {right});
             return right;
         }
         case MINUS: {
-            checkNumberOperand(expr->op, {right});
-            if (isDouble(right)) {
-                dynamic_cast<DoubleValueHolder *>(right.get())->invert();
-                return right;
-            }
-            break;
+            checkNumberOperand(op, {right});
+            return right.isDouble() ? Value::ofDouble(-right.asDouble()) : Value::ofInt(-right.asInt());
         }
         case BANG: {
-            right = std::make_shared<BoolValueHolder>(!isTruthy(right));
-            return right;
+            return Value::ofBool(!right.isTruthy());
         }
         default: {
-            throw RuntimeError(expr->op, "Invalid operand");
+            throw RuntimeError(op, "Invalid operand");
         }
     }
-    // Unreachable
-    return nullptr;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitTernaryExpr(TernaryExpr *expr) {
+Value Interpreter::visitTernaryExpr(TernaryExpr *expr) {
     const auto conditionVal = evaluate(expr->condition);
     const auto leftVal = evaluate(expr->left);
     const auto rightVal = evaluate(expr->right);
-    std::shared_ptr<ValueHolder> result;
-    if (isTruthy(conditionVal)) {
-        result = leftVal;
-    } else {
-        result = rightVal;
-    }
-    return result;
+    return conditionVal.isTruthy() ? leftVal : rightVal;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitVariableExpr(VariableExpr *expr) {
-    return lookup(expr->name, expr);
+Value Interpreter::visitVariableExpr(VariableExpr *expr) {
+    return lookup(expr->name, expr->depth, expr->slot);
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitAssignExpr(AssignExpr *expr) {
+Value Interpreter::visitAssignExpr(AssignExpr *expr) {
     const auto value = evaluate(expr->value);
-    if (_scopesTable.contains(expr)) {
-        const int depth = _scopesTable[expr];
-        _currentScope->assign(depth, expr->name->lexeme(), value);
+    assign(expr->name, expr->depth, expr->slot, value);
+    return value;
+}
+
+int Interpreter::globalSlot(const Token *name, int &slot) const {
+    if (slot < 0) {
+        slot = _globalScope->globalSlot(name->lexeme());
+    }
+    if (!_globalScope->isDefined(slot)) {
+        throw RuntimeError(name, "No such variable '" + std::string(name->lexeme()) + "'");
+    }
+    return slot;
+}
+
+void Interpreter::assign(const Token *name, const int depth, int &slot, const Value &value) const {
+    if (depth >= 0) {
+        _currentScope->assign(depth, slot, value);
     } else {
-        _globalScope->assign(expr->name->lexeme(), value);
+        _globalScope->global(globalSlot(name, slot)) = value;
     }
-    return value;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::lookup(const Token *name, Expr *expr) {
-    if (_scopesTable.contains(expr)) {
-        return _currentScope->get(_scopesTable[expr], name->lexeme());
+Value Interpreter::lookup(const Token *name, const int depth, int &slot) const {
+    if (depth >= 0) {
+        return _currentScope->get(depth, slot);
     }
-    return _globalScope->get(name->lexeme());
+    return _globalScope->global(globalSlot(name, slot));
 }
 
 
-std::shared_ptr<ValueHolder> Interpreter::visitLogicalExpr(LogicalExpr *expr) {
+Value Interpreter::visitLogicalExpr(LogicalExpr *expr) {
     auto left = evaluate(expr->left);
     if (expr->op->type() == OR) {
-        if (isTruthy(left)) {
+        if (left.isTruthy()) {
             return left;
         }
     } else {
-        if (!isTruthy(left)) {
+        if (!left.isTruthy()) {
             return left;
         }
     }
     return evaluate(expr->right);
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitCallExpr(CallExpr *expr) {
+Callable *Interpreter::resolveOverload(const CallableHolder *holder, const ulong argCount) {
+    for (const auto &c: holder->callables) {
+        if (argCount == c->parameterSize()) {
+            return c.get();
+        }
+    }
+    // No matching function with exact parameter size
+    // So let's find a varargs function
+    for (const auto &c: holder->callables) {
+        if (const auto varargFunc = dynamic_cast<FunctionCallable *>(c.get());
+            varargFunc != nullptr && varargFunc->isVarargs && argCount >= varargFunc->parameterSize() - 1) {
+            return c.get();
+        }
+    }
+    return nullptr;
+}
+
+Value Interpreter::visitCallExpr(CallExpr *expr) {
+    switch (expr->intrinsic) {
+        case Intrinsic::NONE: break;
+        case Intrinsic::PRINT: builtinPrint(evaluate(expr->arguments->front()));
+            return {};
+        case Intrinsic::PRINTLN: builtinPrintln(evaluate(expr->arguments->front()));
+            return {};
+        case Intrinsic::LENGTH: return builtinLength(evaluate(expr->arguments->front()));
+    }
     const auto callee = evaluate(expr->callee);
-    const auto paramSize = expr->arguments->size();
+    const auto callable = resolveCall(expr, callee);
+    const auto base = _stack.size();
+    try {
+        pushArguments(expr);
+        auto result = callable->call(this, std::span(_stack).subspan(base));
+        _stack.resize(base);
+        return result;
+    } catch ([[maybe_unused]] const RuntimeError &err) {
+        _stack.resize(base);
+        throw;
+    }
+}
+
+Callable *Interpreter::resolveCall(CallExpr *expr, const Value &callee) {
+    if (!callee.isObject(ObjectType::CALLABLE)) {
+        throw RuntimeError(expr->paren, "No callable found");
+    }
+    const auto holder = callee.as<CallableHolder>();
+    auto &cache = expr->cache;
     Callable *callable = nullptr;
-    if (const auto holder = dynamic_cast<CallableHolder *>(callee.get())) {
-        for (const auto &c: holder->callables) {
-            if (paramSize == c->parameterSize()) {
-                callable = c.get();
-                break;
-            }
-        }
-        // No matching function with exact parameter size
-        // So let's find a varargs function
-        for (const auto &c: holder->callables) {
-            if (const auto varargFunc = dynamic_cast<FunctionCallable *>(c.get());
-                varargFunc != nullptr && varargFunc->isVarargs && paramSize >= varargFunc->parameterSize() - 1) {
-                callable = c.get();
-                break;
-            }
+    for (const auto &entry: cache.entries) {
+        if (entry.callee == callee && entry.version == holder->version) {
+            callable = entry.callable;
+            break;
         }
+    }
+    if (callable == nullptr) {
+        callable = resolveOverload(holder, expr->arguments->size());
         if (callable == nullptr) {
             throw RuntimeError(expr->paren, "No callable found");
         }
-    } else {
-        throw RuntimeError(expr->paren, "No callable found");
+        cache.entries[cache.next] = {callee, holder->version, callable};
+        cache.next = (cache.next + 1) % CallSiteCache::SIZE;
     }
-    std::vector<std::shared_ptr<ValueHolder> > realArgs;
+    return callable;
+}
+
+void Interpreter::pushArguments(const CallExpr *expr) {
     for (const auto argument: *expr->arguments) {
-        const auto argVal = evaluate(argument);
-        realArgs.push_back(argVal);
+        _stack.push_back(evaluate(argument));
     }
-    const auto result = callable->call(this, realArgs);
-    return result;
 }
 
-void Interpreter::executeBlock(std::vector<Stmt *> *stmts, std::shared_ptr<RuntimeScope> scope) {
-    const auto prevScope = _currentScope;
+std::vector<Value> Interpreter::evaluateArguments(const CallExpr *expr) const {
+    std::vector<Value> args;
+    args.reserve(expr->arguments->size());
+    for (const auto argument: *expr->arguments) {
+        args.push_back(evaluate(argument));
+    }
+    return args;
+}
+
+Completion Interpreter::executeBlock(std::vector<Stmt *> *stmts, std::shared_ptr<RuntimeScope> scope) {
+    Collector::instance()->maybeCollect();
+    auto prevScope = std::move(_currentScope);
+    auto completion = Completion::NORMAL;
     try {
         _currentScope = std::move(scope);
         for (const auto stmt: *stmts) {
-            execute(stmt);
+            if ((completion = execute(stmt)) != Completion::NORMAL) {
+                break;
+            }
         }
     } catch ([[maybe_unused]] const RuntimeError &err) {
+        _currentScope = std::move(prevScope);
         throw;
     }
-    _currentScope = prevScope;
+    recycleScope(std::exchange(_currentScope, std::move(prevScope)));
+    return completion;
 }
 
-void Interpreter::resolve(const int depth, Expr *expr) {
-    _scopesTable[expr] = depth;
+std::shared_ptr<RuntimeScope> Interpreter::acquireScope(std::shared_ptr<RuntimeScope> parent, const int slotCount) {
+    if (_scopePool.empty()) {
+        return std::allocate_shared<RuntimeScope>(PoolAllocator<RuntimeScope>(), std::move(parent), slotCount);
+    }
+    auto scope = std::move(_scopePool.back());
+    _scopePool.pop_back();
+    scope->reset(std::move(parent), slotCount);
+    return scope;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitArrayExpr(ArrayExpr *expr) {
-    const auto arrayHolder = std::make_shared<ArrayValueHolder>();
+void Interpreter::recycleScope(std::shared_ptr<RuntimeScope> scope) {
+    // Captured by a closure
+    if (scope.use_count() != 1) {
+        return;
+    }
+    scope->clear();
+    if (_scopePool.size() < SCOPE_POOL_MAX) {
+        _scopePool.push_back(std::move(scope));
+    }
+}
+
+Value Interpreter::takeReturnValue() {
+    return std::move(_returnValue);
+}
+
+bool Interpreter::callNative(FunctionStmt *fun, const std::span<const Value> args, Value &result) {
+    return _jit.call(fun, args, result);
+}
+
+Interpreter::TailCall Interpreter::takeTailCall() {
+    return std::exchange(_tailCall, {});
+}
+
+Value Interpreter::visitArrayExpr(ArrayExpr *expr) {
+    const auto array = expr->localIndex >= 0
+                           ? _currentScope->local(expr->localIndex, ObjectType::ARRAY)
+                           : Value::ofObject(new ArrayValueHolder());
+    const auto arrayHolder = array.as<ArrayValueHolder>();
     for (const auto element: *expr->elements) {
         arrayHolder->values.push_back(evaluate(element));
     }
-    return arrayHolder;
+    return array;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitIndexedCallExpr(IndexedCallExpr *expr) {
-    const auto callee = evaluate(expr->callee);
-    if (const auto arrayHolder = dynamic_cast<ArrayValueHolder *>(callee.get())) {
-        const auto index = evaluate(expr->index);
-        const auto indexHolder = dynamic_cast<IntegerValueHolder *>(index.get());
-        if (!indexHolder) {
-            throw RuntimeError(expr->bracket, "Array index not an integer");
+Value &Interpreter::elementRef(const Value &callee, const Value &index, const Token *bracket, const bool insert) {
+    if (callee.isObject(ObjectType::ARRAY)) {
+        auto &values = callee.as<ArrayValueHolder>()->values;
+        if (!index.isInt()) {
+            throw RuntimeError(bracket, "Array index not an integer");
+        }
+        if (index.asInt() < 0 || index.asInt() >= std::ssize(values)) {
+            throw RuntimeError(bracket, "Array index out of range");
         }
-        return arrayHolder->values[indexHolder->value];
+        return values[index.asInt()];
     }
-    if (const auto mapHolder = dynamic_cast<MapValueHolder *>(callee.get())) {
-        const auto key = evaluate(expr->index);
-        if (!mapHolder->values.contains(key)) {
-            throw RuntimeError(expr->bracket, "Key not found");
+    if (callee.isObject(ObjectType::MAP)) {
+        auto &values = callee.as<MapValueHolder>()->values;
+        if (insert) {
+            return values[index];
+        }
+        const auto it = values.find(index);
+        if (it == values.end()) {
+            throw RuntimeError(bracket, "Key not found");
         }
-        return mapHolder->values[key];
+        return it->second;
     }
-    throw RuntimeError(expr->bracket, "Not an array");
+    throw RuntimeError(bracket, "Expression not an array or a map");
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
-    const auto arr = evaluate(expr->callee);
-    if (const auto arrHolder = dynamic_cast<ArrayValueHolder *>(arr.get())) {
-        const auto index = evaluate(expr->index);
-        const auto indexHolder = dynamic_cast<IntegerValueHolder *>(index.get());
-        if (!indexHolder) {
-            throw RuntimeError(expr->bracket, "Array index not an integer");
-        }
-        const auto value = evaluate(expr->value);
-        arrHolder->values[indexHolder->value] = value;
-        return value;
-    }
-    if (const auto mapHolder = dynamic_cast<MapValueHolder *>(arr.get())) {
-        const auto key = evaluate(expr->index);
-        const auto value = evaluate(expr->value);
-        mapHolder->values[key] = value;
-        return value;
-    }
-    throw RuntimeError(expr->bracket, "Expression not an array or a map");
+Value Interpreter::visitIndexedCallExpr(IndexedCallExpr *expr) {
+    const auto callee = evaluate(expr->callee);
+    const auto index = evaluate(expr->index);
+    return elementRef(callee, index, expr->bracket, false);
+}
+
+Value Interpreter::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
+    const auto callee = evaluate(expr->callee);
+    const auto index = evaluate(expr->index);
+    const auto value = evaluate(expr->value);
+    elementRef(callee, index, expr->bracket, true) = value;
+    return value;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitMapExpr(MapExpr *expr) {
-    const auto mapHolder = std::make_shared<MapValueHolder>();
-    for (const auto [k, v]: *expr->elements) {
+Value Interpreter::visitMapExpr(MapExpr *expr) {
+    const auto map = expr->localIndex >= 0
+                         ? _currentScope->local(expr->localIndex, ObjectType::MAP)
+                         : Value::ofObject(new MapValueHolder());
+    const auto mapHolder = map.as<MapValueHolder>();
+    for (const auto &[k, v]: *expr->elements) {
         const auto keyVal = evaluate(k);
-        const auto valueVal = evaluate(v);
-        mapHolder->values[keyVal] = valueVal;
+        mapHolder->values[keyVal] = evaluate(v);
     }
-    return mapHolder;
+    return map;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
-    auto rvalue = evaluate(expr->expr);
-    checkNumberOperand(expr->op, {rvalue});
-    if (isDouble(rvalue)) {
-        double val = asDouble(rvalue);
-        switch (expr->op->type()) {
-            case PLUS_PLUS: ++val;
-                break;
-            case MINUS_MINUS: --val;
-                break;
-            default: throw RuntimeError(expr->op, "Unsupported type");
-        }
-        dynamic_cast<DoubleValueHolder *>(rvalue.get())->value = val;
-        return rvalue;
+Value Interpreter::step(Expr *target, const Token *op, const bool isPrefix) {
+    const int delta = op->type() == PLUS_PLUS ? 1 : -1;
+    auto stepped = [op, delta](const Value &value) {
+        checkNumberOperand(op, {value});
+        return value.isDouble() ? Value::ofDouble(value.asDouble() + delta) : Value::ofInt(value.asInt() + delta);
+    };
+    if (target->kind == ExprKind::VARIABLE) {
+        const auto variable = static_cast<VariableExpr *>(target);
+        const auto oldVal = lookup(variable->name, variable->depth, variable->slot);
+        const auto newVal = stepped(oldVal);
+        assign(variable->name, variable->depth, variable->slot, newVal);
+        return isPrefix ? newVal : oldVal;
     }
-    int val = asInt(rvalue);
-    switch (expr->op->type()) {
-        case PLUS_PLUS: ++val;
-            break;
-        case MINUS_MINUS: --val;
-            break;
-        default: throw RuntimeError(expr->op, "Unsupported type");
+    if (target->kind == ExprKind::INDEXED_CALL) {
+        const auto indexed = static_cast<IndexedCallExpr *>(target);
+        const auto callee = evaluate(indexed->callee);
+        const auto index = evaluate(indexed->index);
+        auto &element = elementRef(callee, index, indexed->bracket, false);
+        const auto oldVal = element;
+        element = stepped(oldVal);
+        return isPrefix ? element : oldVal;
     }
-    dynamic_cast<IntegerValueHolder *>(rvalue.get())->value = val;
-    return rvalue;
+    // Not assignable, only the resulting value matters
+    const auto value = evaluate(target);
+    const auto newVal = stepped(value);
+    return isPrefix ? newVal : value;
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
-    auto rvalue = evaluate(expr->expr);
-    checkNumberOperand(expr->op, {rvalue});
-    if (isDouble(rvalue)) {
-        double val = asDouble(rvalue);
-        double oldVal = val;
-        switch (expr->op->type()) {
-            case PLUS_PLUS: ++val;
-                break;
-            case MINUS_MINUS: --val;
-                break;
-            default: throw RuntimeError(expr->op, "Unsupported type");
-        }
-        dynamic_cast<DoubleValueHolder *>(rvalue.get())->value = val;
-        return std::make_shared<DoubleValueHolder>(oldVal);
-    }
-    int val = asInt(rvalue);
-    int oldVal = val;
-    switch (expr->op->type()) {
-        case PLUS_PLUS: ++val;
-            break;
-        case MINUS_MINUS: --val;
-            break;
-        default: throw RuntimeError(expr->op, "Unsupported type");
+Value Interpreter::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    return step(expr->expr, expr->op, true);
+}
+
+Value Interpreter::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    return step(expr->expr, expr->op, false);
+}
+
+Value Interpreter::visitInvariantExpr(InvariantExpr *expr) {
+    const auto index = _invariantBase + expr->slot;
+    if (!_invariants[index]) {
+        auto value = evaluate(expr->expr);
+        _invariants[index] = std::move(value);
     }
-    dynamic_cast<IntegerValueHolder *>(rvalue.get())->value = val;
-    return std::make_shared<IntegerValueHolder>(oldVal);
+    return *_invariants[index];
 }
 
-std::shared_ptr<ValueHolder> Interpreter::visitStringLiteralExpr(StringLiteralExpr *expr) {
+Value Interpreter::visitStringLiteralExpr(StringLiteralExpr *expr) {
     std::string result;
-    for (const auto insideExpr: expr->values) {
-        const auto value = evaluate(insideExpr);
-        result.append(value->toString());
+    for (const auto insideExpr: *expr->values) {
+        result.append(evaluate(insideExpr).toString());
     }
-    return std::make_shared<StringValueHolder>(result);
+    return makeString(std::move(result));
 }
@@ -4,93 +4,168 @@
 
 #ifndef INTERPRETER_HPP
 #define INTERPRETER_HPP
+#include <optional>
+#include <span>
 #include <vector>
 
 #include "runtime_scope.hpp"
+#include "../jit/jit.hpp"
 #include "../parser/stmt.hpp"
 
-class Interpreter final : public StmtVisitor<void>, public ExprVisitor<std::shared_ptr<ValueHolder> > {
+// How a statement finished. Anything but NORMAL skips the rest of the enclosing statements until a loop or a function
+// call consumes it.
+enum class Completion {
+    NORMAL, BREAK, CONTINUE, RETURN
+};
+
+class Interpreter final : public StmtVisitor<Completion>, public ExprVisitor<Value> {
+    static constexpr ulong SCOPE_POOL_MAX = 256;
 
     std::shared_ptr<RuntimeScope> _currentScope;
     std::shared_ptr<RuntimeScope> _globalScope;
-    std::map<Expr *, int> _scopesTable;
+public:
+    // Call a return statement completes with, made by FunctionCallable::call once the returning function is left
+    struct TailCall {
+        // Keeps the callable alive
+        Value callee;
+        Callable *callable = nullptr;
+        std::vector<Value> args;
+    };
+
+private:
+    // Arguments of the calls being made, evaluated right onto the stack and handed to the callees as spans
+    std::vector<Value> _stack;
+    // Value of the return statement being completed
+    Value _returnValue;
+    TailCall _tailCall;
+    // Scopes of finished blocks and calls which nothing captured, reused instead of allocating new ones
+    std::vector<std::shared_ptr<RuntimeScope> > _scopePool;
+    // Values of the InvariantExprs of every running loop, the ones of the innermost loop start at _invariantBase
+    std::vector<std::optional<Value> > _invariants;
+    ulong _invariantBase = 0;
+    Jit _jit;
+
+    Completion execute(Stmt *stmt) const;
+
+    static bool checkNumberOperand(const Token *op, std::initializer_list<Value> operands);
+
+    static std::string asString(const Value &value);
+
+    static Value &elementRef(const Value &callee, const Value &index, const Token *bracket, bool insert);
+
+    // A negative depth means the variable is global, then slot caches its global slot once resolved
+    Value lookup(const Token *name, int depth, int &slot) const;
+
+    void assign(const Token *name, int depth, int &slot, const Value &value) const;
+
+    int globalSlot(const Token *name, int &slot) const;
 
-    void execute(Stmt *stmt) const;
+    Value step(Expr *target, const Token *op, bool isPrefix);
 
-    static bool checkNumberOperand(Token *op, std::initializer_list<std::shared_ptr<ValueHolder> > operands);
+    // Picks the operation a BinaryExpr specializes to after its first evaluation
+    static BinarySpecialization specialize(TokenType type, const Value &leftVal, const Value &rightVal);
 
-    static bool isTruthy(const std::shared_ptr<ValueHolder>& value);
+    void recycleScope(std::shared_ptr<RuntimeScope> scope);
 
-    static bool isDouble(const std::shared_ptr<ValueHolder>& value);
+    // Makes room for the invariants of a loop being entered, returns the base to restore when it's left
+    ulong beginInvariants(int count);
 
-    static double asDouble(const std::shared_ptr<ValueHolder>& value);
+    void endInvariants(ulong enclosingBase);
 
-    static int asInt(const std::shared_ptr<ValueHolder>& value);
+    // Picks the overload taking exactly argCount arguments, or else a varargs one
+    static Callable *resolveOverload(const CallableHolder *holder, ulong argCount);
 
-    static bool isString(const std::shared_ptr<ValueHolder>& value);
+    // Overload of the evaluated callee to call, cached at the call site
+    static Callable *resolveCall(CallExpr *expr, const Value &callee);
 
-    static std::string asString(const std::shared_ptr<ValueHolder>& value);
+    std::vector<Value> evaluateArguments(const CallExpr *expr) const;
 
-    std::shared_ptr<ValueHolder> lookup(const Token *name, Expr *expr);
+    // Nested calls push their own arguments on top and pop them again
+    void pushArguments(const CallExpr *expr);
 
 public:
-    Interpreter();
+    explicit Interpreter(bool isJitEnabled = true);
 
     ~Interpreter() override;
 
-    void interpret(std::vector<Stmt *> *stmts) const;
+    void interpret(std::vector<Stmt *> *stmts);
+
+    // Operators on already evaluated operands, throw a RuntimeError on invalid operands
+    static Value binaryOp(const Token *op, const Value &leftVal, const Value &rightVal);
+
+    static Value unaryOp(const Token *op, const Value &right);
 
-    void resolve(int depth, Expr *expr);
 
 protected:
-    void visitExprStmt(ExprStmt *stmt) override;
+    Completion visitExprStmt(ExprStmt *stmt) override;
+
+    Completion visitVarStmt(VarStmt *stmt) override;
+
+    Completion visitBlockStmt(BlockStmt *stmt) override;
+
+    Completion visitIfStmt(IfStmt *stmt) override;
+
+    Completion visitWhileStmt(WhileStmt *stmt) override;
 
-    void visitVarStmt(VarStmt *stmt) override;
+    Completion visitFunctionStmt(FunctionStmt *stmt) override;
 
-    void visitBlockStmt(BlockStmt *stmt) override;
+    Completion visitReturnStmt(ReturnStmt *stmt) override;
 
-    void visitIfStmt(IfStmt *stmt) override;
+    Completion visitBreakStmt(BreakStmt *stmt) override;
 
-    void visitWhileStmt(WhileStmt *stmt) override;
+    Completion visitContinueStmt(ContinueStmt *stmt) override;
 
-    void visitFunctionStmt(FunctionStmt *stmt) override;
+    Completion visitCountedLoopStmt(CountedLoopStmt *stmt) override;
 
-    void visitReturnStmt(ReturnStmt *stmt) override;
+    Value visitBinaryExpr(BinaryExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitBinaryExpr(BinaryExpr *expr) override;
+    Value visitGroupingExpr(GroupingExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitGroupingExpr(GroupingExpr *expr) override;
+    Value visitLiteralExpr(LiteralExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitLiteralExpr(LiteralExpr *expr) override;
+    Value visitUnaryExpr(UnaryExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitUnaryExpr(UnaryExpr *expr) override;
+    Value visitTernaryExpr(TernaryExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitTernaryExpr(TernaryExpr *expr) override;
+    Value visitVariableExpr(VariableExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitVariableExpr(VariableExpr *expr) override;
+    Value visitAssignExpr(AssignExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitAssignExpr(AssignExpr *expr) override;
+    Value visitLogicalExpr(LogicalExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitLogicalExpr(LogicalExpr *expr) override;
+    Value visitCallExpr(CallExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitCallExpr(CallExpr *expr) override;
+    Value visitArrayExpr(ArrayExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitArrayExpr(ArrayExpr *expr) override;
+    Value visitIndexedCallExpr(IndexedCallExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitIndexedCallExpr(IndexedCallExpr *expr) override;
+    Value visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+    Value visitMapExpr(MapExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitMapExpr(MapExpr *expr) override;
+    Value visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+    Value visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+    Value visitStringLiteralExpr(StringLiteralExpr *expr) override;
 
-    std::shared_ptr<ValueHolder> visitStringLiteralExpr(StringLiteralExpr *expr) override;
+    Value visitInvariantExpr(InvariantExpr *expr) override;
 public:
-    void executeBlock(std::vector<Stmt *> *stmts, std::shared_ptr<RuntimeScope> scope);
-    std::shared_ptr<ValueHolder> evaluate(Expr *expr) const;
+    // Runs the statements in scope, which is recycled afterward unless something else still holds it
+    Completion executeBlock(std::vector<Stmt *> *stmts, std::shared_ptr<RuntimeScope> scope);
+
+    std::shared_ptr<RuntimeScope> acquireScope(std::shared_ptr<RuntimeScope> parent, int slotCount);
+
+    // Takes the value of the last completed return statement
+    Value takeReturnValue();
+
+    // Takes the call of the last completed return statement, the callable is null if it returned a value instead
+    TailCall takeTailCall();
+
+    // Runs a call of fun as native code once the Jit compiled it, returns false if it has to be interpreted
+    bool callNative(FunctionStmt *fun, std::span<const Value> args, Value &result);
+
+    Value evaluate(Expr *expr) const;
 };
 
 #endif //INTERPRETER_HPP
@@ -0,0 +1,244 @@
+#include "loop_optimizer.hpp"
+
+LoopOptimizer::LoopOptimizer(const VariableAnalyzer *analyzer, Arena *arena): _analyzer(analyzer), _arena(arena) {
+}
+
+Stmt *LoopOptimizer::optimize(WhileStmt *loop) {
+    const auto info = _analyzer->loops.find(loop);
+    if (info == _analyzer->loops.end()) {
+        return loop;
+    }
+    _loop = &info->second;
+    _invariantCount = 0;
+    if (const auto counted = countedLoop(loop)) {
+        hoist(counted->body);
+        counted->invariantCount = _invariantCount;
+        return counted;
+    }
+    if (loop->condition) {
+        hoist(loop->condition);
+    }
+    hoist(loop->body);
+    if (loop->increment) {
+        hoist(loop->increment);
+    }
+    loop->invariantCount = _invariantCount;
+    return loop;
+}
+
+const Token *LoopOptimizer::declarationOf(const Expr *variable) const {
+    if (variable->kind != ExprKind::VARIABLE) {
+        return nullptr;
+    }
+    const auto it = _analyzer->bindings.find(static_cast<const VariableExpr *>(variable));
+    return it == _analyzer->bindings.end() ? nullptr : it->second;
+}
+
+bool LoopOptimizer::isInvariant(const Token *declaration) const {
+    return !_analyzer->functions.contains(declaration) && !_loop->declarations.contains(declaration) &&
+           !_loop->assignments.contains(declaration) &&
+           !(_loop->hasCall && _analyzer->assignedByCalls.contains(declaration));
+}
+
+bool LoopOptimizer::isInvariant(const Expr *expr) const {
+    switch (expr->kind) {
+        case ExprKind::LITERAL: return true;
+        case ExprKind::VARIABLE: {
+            const auto declaration = declarationOf(expr);
+            return declaration && isInvariant(declaration);
+        }
+        case ExprKind::GROUPING: return isInvariant(static_cast<const GroupingExpr *>(expr)->expr);
+        case ExprKind::UNARY: return isInvariant(static_cast<const UnaryExpr *>(expr)->right);
+        case ExprKind::BINARY: {
+            const auto binary = static_cast<const BinaryExpr *>(expr);
+            return isInvariant(binary->left) && isInvariant(binary->right);
+        }
+        case ExprKind::LOGICAL: {
+            const auto logical = static_cast<const LogicalExpr *>(expr);
+            return isInvariant(logical->left) && isInvariant(logical->right);
+        }
+        case ExprKind::TERNARY: {
+            const auto ternary = static_cast<const TernaryExpr *>(expr);
+            return isInvariant(ternary->condition) && isInvariant(ternary->left) && isInvariant(ternary->right);
+        }
+        case ExprKind::STRING_LITERAL: {
+            for (const auto value: *static_cast<const StringLiteralExpr *>(expr)->values) {
+                if (!isInvariant(value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            // Calls may have side effects, containers and elements may be modified
+            return false;
+    }
+}
+
+CountedLoopStmt *LoopOptimizer::countedLoop(const WhileStmt *loop) const {
+    if (loop->condition == nullptr || loop->condition->kind != ExprKind::BINARY || loop->increment == nullptr) {
+        return nullptr;
+    }
+    const auto condition = static_cast<BinaryExpr *>(loop->condition);
+    int step;
+    switch (condition->op->type()) {
+        case LESS:
+        case LESS_EQUAL: step = 1;
+            break;
+        case GREATER:
+        case GREATER_EQUAL: step = -1;
+            break;
+        default: return nullptr;
+    }
+    const Expr *target;
+    const Token *stepOp;
+    if (loop->increment->kind == ExprKind::PREFIX_AUTO_UNARY) {
+        target = static_cast<PrefixAutoUnaryExpr *>(loop->increment)->expr;
+        stepOp = static_cast<PrefixAutoUnaryExpr *>(loop->increment)->op;
+    } else if (loop->increment->kind == ExprKind::SUFFIX_AUTO_UNARY) {
+        target = static_cast<SuffixAutoUnaryExpr *>(loop->increment)->expr;
+        stepOp = static_cast<SuffixAutoUnaryExpr *>(loop->increment)->op;
+    } else {
+        return nullptr;
+    }
+    const auto counter = declarationOf(condition->left);
+    if (counter == nullptr || counter != declarationOf(target) || (stepOp->type() == PLUS_PLUS ? 1 : -1) != step) {
+        return nullptr;
+    }
+    // The increment has to be the only assignment the loop can run
+    if (_analyzer->functions.contains(counter) || _loop->declarations.contains(counter) ||
+        _loop->assignments.at(counter) != 1 || (_loop->hasCall && _analyzer->assignedByCalls.contains(counter))) {
+        return nullptr;
+    }
+    if (!isInvariant(condition->right)) {
+        return nullptr;
+    }
+    return _arena->make<CountedLoopStmt>(condition, loop->body, loop->increment, step);
+}
+
+void LoopOptimizer::hoist(Expr *&expr) {
+    auto operation = expr;
+    while (operation->kind == ExprKind::GROUPING) {
+        operation = static_cast<GroupingExpr *>(operation)->expr;
+    }
+    // Reading a literal or a variable is as cheap as reading the cached value
+    if (operation->kind != ExprKind::LITERAL && operation->kind != ExprKind::VARIABLE && isInvariant(expr)) {
+        expr = _arena->make<InvariantExpr>(expr, _invariantCount++);
+        return;
+    }
+    switch (expr->kind) {
+        case ExprKind::BINARY: {
+            const auto binary = static_cast<BinaryExpr *>(expr);
+            hoist(binary->left);
+            hoist(binary->right);
+            break;
+        }
+        case ExprKind::GROUPING: hoist(static_cast<GroupingExpr *>(expr)->expr);
+            break;
+        case ExprKind::UNARY: hoist(static_cast<UnaryExpr *>(expr)->right);
+            break;
+        case ExprKind::STRING_LITERAL: {
+            for (auto &value: *static_cast<StringLiteralExpr *>(expr)->values) {
+                hoist(value);
+            }
+            break;
+        }
+        case ExprKind::TERNARY: {
+            const auto ternary = static_cast<TernaryExpr *>(expr);
+            hoist(ternary->condition);
+            hoist(ternary->left);
+            hoist(ternary->right);
+            break;
+        }
+        case ExprKind::ASSIGN: hoist(static_cast<AssignExpr *>(expr)->value);
+            break;
+        case ExprKind::LOGICAL: {
+            const auto logical = static_cast<LogicalExpr *>(expr);
+            hoist(logical->left);
+            hoist(logical->right);
+            break;
+        }
+        case ExprKind::CALL: {
+            const auto call = static_cast<CallExpr *>(expr);
+            hoist(call->callee);
+            for (auto &arg: *call->arguments) {
+                hoist(arg);
+            }
+            break;
+        }
+        case ExprKind::INDEXED_CALL: {
+            const auto indexed = static_cast<IndexedCallExpr *>(expr);
+            hoist(indexed->callee);
+            hoist(indexed->index);
+            break;
+        }
+        case ExprKind::ARRAY: {
+            for (auto &element: *static_cast<ArrayExpr *>(expr)->elements) {
+                hoist(element);
+            }
+            break;
+        }
+        case ExprKind::INDEXED_ELE_ASSIGN: {
+            const auto assign = static_cast<ArrayElementAssignExpr *>(expr);
+            hoist(assign->callee);
+            hoist(assign->index);
+            hoist(assign->value);
+            break;
+        }
+        case ExprKind::MAP: {
+            for (auto &[key, value]: *static_cast<MapExpr *>(expr)->elements) {
+                hoist(key);
+                hoist(value);
+            }
+            break;
+        }
+        case ExprKind::PREFIX_AUTO_UNARY: hoist(static_cast<PrefixAutoUnaryExpr *>(expr)->expr);
+            break;
+        case ExprKind::SUFFIX_AUTO_UNARY: hoist(static_cast<SuffixAutoUnaryExpr *>(expr)->expr);
+            break;
+        case ExprKind::LITERAL:
+        case ExprKind::VARIABLE:
+        case ExprKind::INVARIANT:
+            break;
+    }
+}
+
+void LoopOptimizer::hoist(Stmt *stmt) {
+    switch (stmt->kind) {
+        case StmtKind::EXPR: hoist(static_cast<ExprStmt *>(stmt)->expr);
+            break;
+        case StmtKind::VAR: {
+            if (const auto var = static_cast<VarStmt *>(stmt); var->initializer) {
+                hoist(var->initializer);
+            }
+            break;
+        }
+        case StmtKind::BLOCK: {
+            for (const auto s: *static_cast<BlockStmt *>(stmt)->stmts) {
+                hoist(s);
+            }
+            break;
+        }
+        case StmtKind::IF: {
+            const auto ifStmt = static_cast<IfStmt *>(stmt);
+            hoist(ifStmt->condition);
+            hoist(ifStmt->thenBlock);
+            if (ifStmt->elseBlock) {
+                hoist(ifStmt->elseBlock);
+            }
+            break;
+        }
+        case StmtKind::RETURN: {
+            if (const auto returnStmt = static_cast<ReturnStmt *>(stmt); returnStmt->value) {
+                hoist(returnStmt->value);
+            }
+            break;
+        }
+        case StmtKind::WHILE:
+        case StmtKind::COUNTED_LOOP:
+        case StmtKind::FUNCTION:
+        case StmtKind::BREAK:
+        case StmtKind::CONTINUE:
+            break;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef LOOP_OPTIMIZER_HPP
+#define LOOP_OPTIMIZER_HPP
+
+#include "variable_analyzer.hpp"
+#include "../utils/arena.hpp"
+
+// Rewrites loops after their bodies have been optimized. For loops stepping a counter towards an invariant limit
+// become CountedLoopStmts, and side effect free expressions whose operands don't change in the loop are wrapped in
+// InvariantExprs so that they are evaluated once per run of the loop. Nested loops and functions are left to
+// themselves.
+class LoopOptimizer final {
+    const VariableAnalyzer *_analyzer;
+    Arena *_arena;
+    // Summary of the loop being optimized
+    const VariableAnalyzer::LoopInfo *_loop = nullptr;
+    int _invariantCount = 0;
+
+    bool isInvariant(const Expr *expr) const;
+
+    bool isInvariant(const Token *declaration) const;
+
+    const Token *declarationOf(const Expr *variable) const;
+
+    // Returns nullptr if the loop doesn't count
+    CountedLoopStmt *countedLoop(const WhileStmt *loop) const;
+
+    void hoist(Expr *&expr);
+
+    void hoist(Stmt *stmt);
+
+public:
+    LoopOptimizer(const VariableAnalyzer *analyzer, Arena *arena);
+
+    // Returns the statement to replace the loop with
+    Stmt *optimize(WhileStmt *loop);
+};
+
+#endif //LOOP_OPTIMIZER_HPP
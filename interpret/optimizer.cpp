@@ -0,0 +1,289 @@
+#include "optimizer.hpp"
+
+#include "interpreter.hpp"
+
+Optimizer::Optimizer(Arena *arena, const int inlineBudget): _arena(arena), _loopOptimizer(&_analyzer, arena),
+                                                           _inliner(&_analyzer, arena, inlineBudget) {
+}
+
+void Optimizer::optimize(std::vector<Stmt *> *stmts) {
+    _analyzer.analyze(stmts);
+    optimizeAll(stmts);
+}
+
+void Optimizer::optimize(Expr *&expr) {
+    expr = expr->accept((ExprVisitor *) this);
+}
+
+Stmt *Optimizer::optimize(Stmt *stmt) {
+    return stmt->accept((StmtVisitor *) this);
+}
+
+void Optimizer::optimizeAll(std::vector<Stmt *> *stmts) {
+    ulong count = 0;
+    for (const auto stmt: *stmts) {
+        if (const auto result = optimize(stmt)) {
+            // Only a declaration in a list of statements is sure to have run before the calls bound to it
+            if (result->kind == StmtKind::FUNCTION) {
+                _inliner.consider(static_cast<FunctionStmt *>(result));
+            }
+            (*stmts)[count++] = result;
+        }
+    }
+    stmts->resize(count);
+}
+
+Stmt *Optimizer::optimizeBody(Stmt *stmt) {
+    if (const auto result = optimize(stmt)) {
+        return result;
+    }
+    return _arena->make<BlockStmt>(_arena->make<std::vector<Stmt *> >());
+}
+
+Expr *Optimizer::constant(const Token *token, Value value) const {
+    return _arena->make<LiteralExpr>(token, std::move(value));
+}
+
+bool Optimizer::isConstant(const Expr *expr) {
+    return expr->kind == ExprKind::LITERAL;
+}
+
+const Value &Optimizer::constantOf(const Expr *expr) {
+    return static_cast<const LiteralExpr *>(expr)->constant;
+}
+
+bool Optimizer::isDeclaration(const Stmt *stmt) {
+    return stmt->kind == StmtKind::VAR || stmt->kind == StmtKind::FUNCTION;
+}
+
+Expr *Optimizer::visitBinaryExpr(BinaryExpr *expr) {
+    optimize(expr->left);
+    optimize(expr->right);
+    if (isConstant(expr->left) && isConstant(expr->right)) {
+        try {
+            return constant(expr->op, Interpreter::binaryOp(expr->op, constantOf(expr->left),
+                                                            constantOf(expr->right)));
+        } catch ([[maybe_unused]] const RuntimeError &e) {
+            // Leave it to fail at runtime
+        }
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitGroupingExpr(GroupingExpr *expr) {
+    optimize(expr->expr);
+    return isConstant(expr->expr) ? expr->expr : expr;
+}
+
+Expr *Optimizer::visitLiteralExpr(LiteralExpr *expr) {
+    return expr;
+}
+
+Expr *Optimizer::visitUnaryExpr(UnaryExpr *expr) {
+    optimize(expr->right);
+    if (isConstant(expr->right)) {
+        try {
+            return constant(expr->op, Interpreter::unaryOp(expr->op, constantOf(expr->right)));
+        } catch ([[maybe_unused]] const RuntimeError &e) {
+            // Leave it to fail at runtime
+        }
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitTernaryExpr(TernaryExpr *expr) {
+    optimize(expr->condition);
+    optimize(expr->left);
+    optimize(expr->right);
+    if (isConstant(expr->condition)) {
+        // Both branches are evaluated, so the other one can only be dropped if evaluating it can't be observed
+        const bool isLeft = constantOf(expr->condition).isTruthy();
+        if (_analyzer.isTrivial(isLeft ? expr->right : expr->left)) {
+            return isLeft ? expr->left : expr->right;
+        }
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitVariableExpr(VariableExpr *expr) {
+    const auto binding = _analyzer.bindings.find(expr);
+    if (binding == _analyzer.bindings.end() || _analyzer.reassigned.contains(binding->second)) {
+        return expr;
+    }
+    const auto var = _analyzer.variables.find(binding->second);
+    if (var == _analyzer.variables.end() || var->second->initializer == nullptr ||
+        !isConstant(var->second->initializer)) {
+        return expr;
+    }
+    return constant(expr->name, constantOf(var->second->initializer));
+}
+
+Expr *Optimizer::visitAssignExpr(AssignExpr *expr) {
+    optimize(expr->value);
+    return expr;
+}
+
+Expr *Optimizer::visitLogicalExpr(LogicalExpr *expr) {
+    optimize(expr->left);
+    optimize(expr->right);
+    if (isConstant(expr->left)) {
+        const bool isTruthy = constantOf(expr->left).isTruthy();
+        if (expr->op->type() == OR) {
+            return isTruthy ? expr->left : expr->right;
+        }
+        return isTruthy ? expr->right : expr->left;
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitCallExpr(CallExpr *expr) {
+    optimize(expr->callee);
+    for (auto &arg: *expr->arguments) {
+        optimize(arg);
+    }
+    if (const auto inlined = _inliner.inlineCall(expr)) {
+        // The body may fold with the arguments in place
+        return inlined->accept((ExprVisitor *) this);
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitArrayExpr(ArrayExpr *expr) {
+    for (auto &element: *expr->elements) {
+        optimize(element);
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitIndexedCallExpr(IndexedCallExpr *expr) {
+    optimize(expr->callee);
+    optimize(expr->index);
+    return expr;
+}
+
+Expr *Optimizer::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
+    optimize(expr->callee);
+    optimize(expr->index);
+    optimize(expr->value);
+    return expr;
+}
+
+Expr *Optimizer::visitMapExpr(MapExpr *expr) {
+    for (auto &[fst, snd]: *expr->elements) {
+        optimize(fst);
+        optimize(snd);
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    // The target of a step has to stay a variable or an element
+    if (expr->expr->kind != ExprKind::VARIABLE) {
+        optimize(expr->expr);
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    if (expr->expr->kind != ExprKind::VARIABLE) {
+        optimize(expr->expr);
+    }
+    return expr;
+}
+
+Expr *Optimizer::visitInvariantExpr(InvariantExpr *expr) {
+    return expr;
+}
+
+Expr *Optimizer::visitStringLiteralExpr(StringLiteralExpr *expr) {
+    bool isAllConstant = true;
+    for (auto &e: *expr->values) {
+        optimize(e);
+        isAllConstant = isAllConstant && isConstant(e);
+    }
+    if (!isAllConstant || expr->values->empty()) {
+        return expr;
+    }
+    std::string result;
+    for (const auto e: *expr->values) {
+        result.append(constantOf(e).toString());
+    }
+    return constant(static_cast<LiteralExpr *>(expr->values->front())->value, makeString(std::move(result)));
+}
+
+Stmt *Optimizer::visitExprStmt(ExprStmt *stmt) {
+    optimize(stmt->expr);
+    return stmt;
+}
+
+Stmt *Optimizer::visitVarStmt(VarStmt *stmt) {
+    if (stmt->initializer) {
+        optimize(stmt->initializer);
+    }
+    return stmt;
+}
+
+Stmt *Optimizer::visitBlockStmt(BlockStmt *stmt) {
+    optimizeAll(stmt->stmts);
+    return stmt;
+}
+
+Stmt *Optimizer::visitIfStmt(IfStmt *stmt) {
+    optimize(stmt->condition);
+    // A declaration as a branch still has to be resolved, so such ifs are kept whole
+    if (!isConstant(stmt->condition) || isDeclaration(stmt->thenBlock) ||
+        (stmt->elseBlock && isDeclaration(stmt->elseBlock))) {
+        stmt->thenBlock = optimizeBody(stmt->thenBlock);
+        if (stmt->elseBlock) {
+            stmt->elseBlock = optimizeBody(stmt->elseBlock);
+        }
+        return stmt;
+    }
+    if (constantOf(stmt->condition).isTruthy()) {
+        return optimize(stmt->thenBlock);
+    }
+    return stmt->elseBlock ? optimize(stmt->elseBlock) : nullptr;
+}
+
+Stmt *Optimizer::visitWhileStmt(WhileStmt *stmt) {
+    if (stmt->condition) {
+        optimize(stmt->condition);
+        if (isConstant(stmt->condition)) {
+            if (constantOf(stmt->condition).isTruthy()) {
+                stmt->condition = nullptr;
+            } else if (!isDeclaration(stmt->body)) {
+                return nullptr;
+            }
+        }
+    }
+    stmt->body = optimizeBody(stmt->body);
+    if (stmt->increment) {
+        optimize(stmt->increment);
+    }
+    return _loopOptimizer.optimize(stmt);
+}
+
+Stmt *Optimizer::visitFunctionStmt(FunctionStmt *stmt) {
+    optimizeAll(stmt->bodyBlock->stmts);
+    return stmt;
+}
+
+Stmt *Optimizer::visitReturnStmt(ReturnStmt *stmt) {
+    if (stmt->value) {
+        optimize(stmt->value);
+    }
+    return stmt;
+}
+
+Stmt *Optimizer::visitBreakStmt(BreakStmt *stmt) {
+    return stmt;
+}
+
+Stmt *Optimizer::visitContinueStmt(ContinueStmt *stmt) {
+    return stmt;
+}
+
+Stmt *Optimizer::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    stmt->body = optimizeBody(stmt->body);
+    return stmt;
+}
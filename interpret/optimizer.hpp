@@ -0,0 +1,104 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+#include <vector>
+
+#include "inliner.hpp"
+#include "loop_optimizer.hpp"
+#include "variable_analyzer.hpp"
+#include "../utils/arena.hpp"
+
+// Simplifies the tree before it gets resolved. Operations on constants are folded with the same semantics as the
+// Interpreter, variables that are never reassigned after a constant initializer are replaced by the constant and
+// branches that can never run are dropped. Calls of small functions are inlined by the Inliner and loops are then
+// handed to the LoopOptimizer.
+class Optimizer final : public ExprVisitor<Expr *>, public StmtVisitor<Stmt *> {
+    Arena *_arena;
+    VariableAnalyzer _analyzer;
+    LoopOptimizer _loopOptimizer;
+    Inliner _inliner;
+
+    void optimize(Expr *&expr);
+
+    // Returns nullptr if the statement can be removed
+    Stmt *optimize(Stmt *stmt);
+
+    // Drops the removed statements from the list
+    void optimizeAll(std::vector<Stmt *> *stmts);
+
+    // Keeps single statement bodies non-null
+    Stmt *optimizeBody(Stmt *stmt);
+
+    Expr *constant(const Token *token, Value value) const;
+
+    static bool isConstant(const Expr *expr);
+
+    static const Value &constantOf(const Expr *expr);
+
+    static bool isDeclaration(const Stmt *stmt);
+
+protected:
+    Expr *visitBinaryExpr(BinaryExpr *expr) override;
+
+    Expr *visitGroupingExpr(GroupingExpr *expr) override;
+
+    Expr *visitLiteralExpr(LiteralExpr *expr) override;
+
+    Expr *visitUnaryExpr(UnaryExpr *expr) override;
+
+    Expr *visitTernaryExpr(TernaryExpr *expr) override;
+
+    Expr *visitVariableExpr(VariableExpr *expr) override;
+
+    Expr *visitAssignExpr(AssignExpr *expr) override;
+
+    Expr *visitLogicalExpr(LogicalExpr *expr) override;
+
+    Expr *visitCallExpr(CallExpr *expr) override;
+
+    Expr *visitArrayExpr(ArrayExpr *expr) override;
+
+    Expr *visitIndexedCallExpr(IndexedCallExpr *expr) override;
+
+    Expr *visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+
+    Expr *visitMapExpr(MapExpr *expr) override;
+
+    Expr *visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+
+    Expr *visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+
+    Expr *visitStringLiteralExpr(StringLiteralExpr *expr) override;
+
+    Expr *visitInvariantExpr(InvariantExpr *expr) override;
+
+    Stmt *visitExprStmt(ExprStmt *stmt) override;
+
+    Stmt *visitVarStmt(VarStmt *stmt) override;
+
+    Stmt *visitBlockStmt(BlockStmt *stmt) override;
+
+    Stmt *visitIfStmt(IfStmt *stmt) override;
+
+    Stmt *visitWhileStmt(WhileStmt *stmt) override;
+
+    Stmt *visitFunctionStmt(FunctionStmt *stmt) override;
+
+    Stmt *visitReturnStmt(ReturnStmt *stmt) override;
+
+    Stmt *visitBreakStmt(BreakStmt *stmt) override;
+
+    Stmt *visitContinueStmt(ContinueStmt *stmt) override;
+
+    Stmt *visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
+public:
+    // New nodes are allocated in the arena owning the tree, functions with bodies of up to inlineBudget nodes are
+    // inlined
+    explicit Optimizer(Arena *arena, int inlineBudget = Inliner::DEFAULT_BUDGET);
+
+    ~Optimizer() override = default;
+
+    void optimize(std::vector<Stmt *> *stmts);
+};
+
+#endif //OPTIMIZER_HPP
@@ -6,9 +6,6 @@
 
 #include "../utils/logger.hpp"
 
-Resolver::Resolver(Interpreter *interpreter): _interpreter(interpreter) {
-}
-
 void Resolver::visitBinaryExpr(BinaryExpr *expr) {
     resolve(expr->left);
     resolve(expr->right);
@@ -32,16 +29,15 @@ void Resolver::visitTernaryExpr(TernaryExpr *expr) {
 }
 
 void Resolver::visitVariableExpr(VariableExpr *expr) {
-    if (!_scopes.empty() && _scopes.back().contains(expr->name->lexeme()) && _scopes.back()[expr->name->lexeme()] ==
-        false) {
-        Logger::instance()->logError(expr->name, "");
-    }
-    resolveLocalVariable(expr, expr->name->lexeme());
+    resolveLocalVariable(expr->name->lexeme(), expr->depth, expr->slot);
 }
 
 void Resolver::visitAssignExpr(AssignExpr *expr) {
     resolve(expr->value);
-    resolveLocalVariable(expr, expr->name->lexeme());
+    resolveLocalVariable(expr->name->lexeme(), expr->depth, expr->slot);
+    if (expr->depth < 0) {
+        _redefinedGlobals.emplace(expr->name->lexeme());
+    }
 }
 
 void Resolver::visitLogicalExpr(LogicalExpr *expr) {
@@ -54,6 +50,21 @@ void Resolver::visitCallExpr(CallExpr *expr) {
     for (const auto arg: *expr->arguments) {
         resolve(arg);
     }
+    expr->intrinsic = Intrinsic::NONE;
+    // Every builtin takes exactly one argument
+    if (expr->callee->kind == ExprKind::VARIABLE && expr->arguments->size() == 1) {
+        if (const auto callee = static_cast<VariableExpr *>(expr->callee);
+            callee->depth < 0 && intrinsicOf(callee->name->lexeme()) != Intrinsic::NONE) {
+            _builtinCalls.push_back(expr);
+        }
+    }
+}
+
+Intrinsic Resolver::intrinsicOf(const std::string_view name) {
+    if (name == "print") return Intrinsic::PRINT;
+    if (name == "println") return Intrinsic::PRINTLN;
+    if (name == "length") return Intrinsic::LENGTH;
+    return Intrinsic::NONE;
 }
 
 Resolver::~Resolver() = default;
@@ -67,12 +78,19 @@ void Resolver::visitVarStmt(VarStmt *stmt) {
     if (stmt->initializer) {
         resolve(stmt->initializer);
     }
-    define(stmt->name);
+    stmt->slot = define(stmt->name);
 }
 
 void Resolver::visitBlockStmt(BlockStmt *stmt) {
+    if (!declaresLocals(stmt)) {
+        // Runs in the enclosing scope, so don't count it as a level either
+        stmt->slotCount = 0;
+        resolve(static_cast<const std::vector<Stmt *> *>(stmt->stmts));
+        return;
+    }
     beginScope();
-    resolve(stmt->stmts);
+    resolve(static_cast<const std::vector<Stmt *> *>(stmt->stmts));
+    stmt->slotCount = static_cast<int>(_scopes.back().size());
     endScope();
 }
 
@@ -85,21 +103,42 @@ void Resolver::visitIfStmt(IfStmt *stmt) {
 }
 
 void Resolver::visitWhileStmt(WhileStmt *stmt) {
-    resolve(stmt->condition);
+    if (stmt->condition) {
+        resolve(stmt->condition);
+    }
+    ++_loopDepth;
     resolve(stmt->body);
+    --_loopDepth;
+    if (stmt->increment) {
+        resolve(stmt->increment);
+    }
 }
 
 void Resolver::visitFunctionStmt(FunctionStmt *stmt) {
     declare(stmt->name);
-    define(stmt->name);
+    stmt->slot = define(stmt->name);
     resolveFunction(stmt);
 }
 
 void Resolver::visitReturnStmt(ReturnStmt *stmt) {
     if (_block_type != FUNCTION) {
-        throw RuntimeError(stmt->keyword, "Cannot return from outside a function");
+        error(stmt->keyword, "Cannot return from outside a function.");
+    }
+    if (stmt->value) {
+        resolve(stmt->value);
+    }
+}
+
+void Resolver::visitBreakStmt(BreakStmt *stmt) {
+    if (_loopDepth == 0) {
+        error(stmt->keyword, "Cannot break outside a loop.");
+    }
+}
+
+void Resolver::visitContinueStmt(ContinueStmt *stmt) {
+    if (_loopDepth == 0) {
+        error(stmt->keyword, "Cannot continue outside a loop.");
     }
-    resolve(stmt->value);
 }
 
 void Resolver::resolve(Expr *expr) {
@@ -111,31 +150,76 @@ void Resolver::resolve(Stmt *stmt) {
 }
 
 void Resolver::resolve(std::vector<Stmt *> *stmts) {
+    resolve(static_cast<const std::vector<Stmt *> *>(stmts));
+    // A redefinition may run before any of the calls, so it rules out the builtin everywhere
+    for (const auto call: _builtinCalls) {
+        if (const auto name = static_cast<VariableExpr *>(call->callee)->name->lexeme();
+            !_redefinedGlobals.contains(name)) {
+            call->intrinsic = intrinsicOf(name);
+        }
+    }
+    _builtinCalls.clear();
+    _redefinedGlobals.clear();
+}
+
+void Resolver::resolve(const std::vector<Stmt *> *stmts) {
     for (const auto stmt: *stmts) {
         resolve(stmt);
     }
 }
 
-void Resolver::resolveFunction(const FunctionStmt *func) {
+bool Resolver::declaresLocals(const BlockStmt *block) {
+    for (const auto stmt: *block->stmts) {
+        if (declaresLocal(stmt)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Resolver::declaresLocal(const Stmt *stmt) {
+    // Single statement bodies declare into the enclosing block, nested blocks have scopes of their own
+    switch (stmt->kind) {
+        case StmtKind::VAR:
+        case StmtKind::FUNCTION: return true;
+        case StmtKind::IF: {
+            const auto ifStmt = static_cast<const IfStmt *>(stmt);
+            return declaresLocal(ifStmt->thenBlock) || (ifStmt->elseBlock && declaresLocal(ifStmt->elseBlock));
+        }
+        case StmtKind::WHILE: return declaresLocal(static_cast<const WhileStmt *>(stmt)->body);
+        case StmtKind::COUNTED_LOOP: return declaresLocal(static_cast<const CountedLoopStmt *>(stmt)->body);
+        default: return false;
+    }
+}
+
+void Resolver::resolveFunction(FunctionStmt *func) {
     const auto enclosingType = _block_type;
+    const auto enclosingLoopDepth = _loopDepth;
     _block_type = FUNCTION;
+    _loopDepth = 0;
     beginScope();
     for (const auto param: *func->params) {
         declare(param->name);
-        define(param->name);
+        param->slot = define(param->name);
     }
-    resolve(func->bodyBlock->stmts);
+    resolve(static_cast<const std::vector<Stmt *> *>(func->bodyBlock->stmts));
+    func->slotCount = static_cast<int>(_scopes.back().size());
     endScope();
     _block_type = enclosingType;
+    _loopDepth = enclosingLoopDepth;
 }
 
-void Resolver::resolveLocalVariable(Expr *expr, const std::string &name) const {
+void Resolver::resolveLocalVariable(const std::string_view name, int &depth, int &slot) const {
     for (int i = static_cast<int>(_scopes.size()) - 1; i >= 0; i--) {
-        if (_scopes[i].contains(name)) {
-            _interpreter->resolve(static_cast<int>(_scopes.size()) - 1 - i, expr);
+        if (const auto it = _scopes[i].find(name); it != _scopes[i].end()) {
+            depth = static_cast<int>(_scopes.size()) - 1 - i;
+            slot = it->second;
             return;
         }
     }
+    // Not found in any local scope, leave it to the globals
+    depth = -1;
+    slot = -1;
 }
 
 void Resolver::beginScope() {
@@ -146,22 +230,30 @@ void Resolver::endScope() {
     _scopes.pop_back();
 }
 
-void Resolver::define(const Token *name) {
+int Resolver::define(const Token *name) {
     if (_scopes.empty()) {
-        return;
+        _redefinedGlobals.emplace(name->lexeme());
+        return -1;
+    }
+    auto &top = _scopes.back();
+    // Redeclaring a name reuses its slot, so that function overloads get merged
+    const auto [it, inserted] = top.try_emplace(std::string(name->lexeme()), static_cast<int>(top.size()));
+    return it->second;
+}
+
+void Resolver::error(const Token *token, const std::string &message) const {
+    if (_isReporting) {
+        Logger::instance()->logError(token, message);
     }
-    _scopes.back()[name->lexeme()] = true;
 }
 
 void Resolver::declare(const Token *name) const {
     if (_scopes.empty()) {
         return;
     }
-    auto top = _scopes.back();
-    if (top.contains(name->lexeme())) {
-        Logger::instance()->logError(name, "Variable already declared.");
+    if (_scopes.back().contains(name->lexeme())) {
+        error(name, "Variable already declared.");
     }
-    top[name->lexeme()] = false;
 }
 
 void Resolver::visitArrayExpr(ArrayExpr *expr) {
@@ -178,6 +270,7 @@ void Resolver::visitIndexedCallExpr(IndexedCallExpr *expr) {
 void Resolver::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
     resolve(expr->callee);
     resolve(expr->index);
+    resolve(expr->value);
 }
 
 void Resolver::visitMapExpr(MapExpr *expr) {
@@ -196,7 +289,19 @@ void Resolver::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
 }
 
 void Resolver::visitStringLiteralExpr(StringLiteralExpr *expr) {
-    for (Expr *e : expr->values) {
+    for (Expr *e : *expr->values) {
         resolve(e);
     }
 }
+
+void Resolver::visitInvariantExpr(InvariantExpr *expr) {
+    resolve(expr->expr);
+}
+
+void Resolver::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    resolve(stmt->condition);
+    ++_loopDepth;
+    resolve(stmt->body);
+    --_loopDepth;
+    resolve(stmt->increment);
+}
@@ -5,10 +5,10 @@
 #ifndef RESOLVER_HPP
 #define RESOLVER_HPP
 #include <map>
+#include <set>
 #include <stack>
 #include <string>
 
-#include "interpreter.hpp"
 #include "../parser/expr.hpp"
 #include "../parser/stmt.hpp"
 
@@ -17,27 +17,39 @@ enum BlockType {
 };
 
 class Resolver final : public ExprVisitor<void>, public StmtVisitor<void> {
-    std::vector<std::map<std::string, bool>> _scopes;
+    // Every local scope maps its names to the slots they occupy in the runtime scope
+    std::vector<std::map<std::string, int, std::less<> > > _scopes;
     BlockType _block_type = GLOBAL;
-
-    Interpreter *_interpreter;
+    // Number of loops enclosing the current statement within the current function
+    int _loopDepth = 0;
+    // Calls of unshadowed builtins, which become intrinsics unless the program redefines their global
+    std::vector<CallExpr *> _builtinCalls;
+    std::set<std::string, std::less<> > _redefinedGlobals;
+    // Off when resolving again a tree whose errors were reported already
+    bool _isReporting;
 
     void resolve(Expr *expr);
 
     void resolve(Stmt *stmt);
 
-    void resolveFunction(const FunctionStmt *func);
+    void resolve(const std::vector<Stmt *> *stmts);
+
+    static Intrinsic intrinsicOf(std::string_view name);
+
+    void resolveFunction(FunctionStmt *func);
 
-    void resolveLocalVariable(Expr *expr, const std::string &name) const;
+    void resolveLocalVariable(std::string_view name, int &depth, int &slot) const;
 
     void beginScope();
 
     void endScope();
 
-    void define(const Token *name);
+    int define(const Token *name);
 
     void declare(const Token *name) const;
 
+    void error(const Token *token, const std::string &message) const;
+
 protected:
     void visitBinaryExpr(BinaryExpr *expr) override;
 
@@ -75,6 +87,12 @@ protected:
 
     void visitReturnStmt(ReturnStmt *stmt) override;
 
+    void visitBreakStmt(BreakStmt *stmt) override;
+
+    void visitContinueStmt(ContinueStmt *stmt) override;
+
+    void visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
     void visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
 
     void visitMapExpr(MapExpr *expr) override;
@@ -85,10 +103,21 @@ protected:
 
     void visitStringLiteralExpr(StringLiteralExpr *expr) override;
 
+    void visitInvariantExpr(InvariantExpr *expr) override;
+
+    // Whether the statement declares into the block it is part of
+    static bool declaresLocal(const Stmt *stmt);
+
 public:
-    explicit Resolver(Interpreter *interpreter);
+    // Whether the block declares anything itself and so needs a scope of its own
+    static bool declaresLocals(const BlockStmt *block);
+
+    explicit Resolver(const bool isReporting = true): _isReporting(isReporting) {
+    }
+
     ~Resolver() override;
 
+    // Assigns depths and slots, and can be run again after the tree was changed
     void resolve(std::vector<Stmt *> *stmts);
 };
 
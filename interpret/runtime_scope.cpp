@@ -4,52 +4,47 @@
 
 #include "runtime_scope.hpp"
 
+#include <iterator>
 #include <memory>
-#include <stdexcept>
 
 #include "callable.hpp"
 
-std::shared_ptr<ValueHolder> RuntimeScope::UNINITIALIZED_OBJECT = std::make_shared<ValueHolder>();
-
-RuntimeScope::RuntimeScope(std::shared_ptr<RuntimeScope> parentScope): _parent(std::move(parentScope)) {
+RuntimeScope::RuntimeScope(std::shared_ptr<RuntimeScope> parentScope, const int slotCount): _parent(
+        std::move(parentScope)), _slots(slotCount) {
+    track();
 }
 
-std::shared_ptr<ValueHolder> RuntimeScope::define(const std::string &name, std::shared_ptr<ValueHolder> value) {
-    std::shared_ptr<ValueHolder> oldVal = _definitions[name];
-    const auto oldFun = dynamic_cast<CallableHolder *>(oldVal.get());
-    if (const auto newFun = dynamic_cast<CallableHolder *>(value.get()); oldFun && newFun) {
-        // Merge functions
-        auto oldFunMap = std::map<int, std::shared_ptr<Callable>>();
-        for (const auto &oldF : oldFun->callables) {
-            oldFunMap[oldF->parameterSize()] = oldF;
-        }
-        for (const auto &newF: newFun->callables) {
-            oldFunMap[newF->parameterSize()] = newF;
-        }
-        oldFun->callables.clear();
-        for (const auto &oldF : oldFunMap) {
-            oldFun->callables.push_back(oldF.second);
-        }
-    } else {
-        // Replace symbol
-        _definitions[name] = std::move(value);
+void RuntimeScope::mergeCallables(CallableHolder *oldFun, const CallableHolder *newFun) {
+    auto oldFunMap = std::map<int, std::shared_ptr<Callable>>();
+    for (const auto &oldF : oldFun->callables) {
+        oldFunMap[oldF->parameterSize()] = oldF;
+    }
+    for (const auto &newF: newFun->callables) {
+        oldFunMap[newF->parameterSize()] = newF;
     }
+    oldFun->callables.clear();
+    ++oldFun->version;
+    for (const auto &oldF : oldFunMap) {
+        oldFun->callables.push_back(oldF.second);
+    }
+}
+
+Value RuntimeScope::define(const std::string_view name, Value value) {
+    const auto slot = globalSlot(name);
+    Value oldVal = _globals[slot].value;
+    defineGlobal(slot, std::move(value));
     return oldVal;
 }
 
-std::shared_ptr<ValueHolder> RuntimeScope::get(const std::string &name) {
-    std::shared_ptr<ValueHolder> value;
-    if (_definitions.contains(name)) {
-        value = _definitions[name];
-    } else if (_parent != nullptr) {
-        value = _parent->get(name);
-    } else {
-        throw std::runtime_error("No such variable");
+void RuntimeScope::define(const int slot, Value value) {
+    if (slot >= std::ssize(_slots)) {
+        _slots.resize(slot + 1);
     }
-    if (value == UNINITIALIZED_OBJECT) {
-        throw std::runtime_error("Uninitialized variable");
+    if (auto &oldVal = _slots[slot]; oldVal.isObject(ObjectType::CALLABLE) && value.isObject(ObjectType::CALLABLE)) {
+        mergeCallables(oldVal.as<CallableHolder>(), value.as<CallableHolder>());
+    } else {
+        oldVal = std::move(value);
     }
-    return value;
 }
 
 RuntimeScope *RuntimeScope::ancestorScope(const int depth, RuntimeScope *root) {
@@ -59,28 +54,119 @@ RuntimeScope *RuntimeScope::ancestorScope(const int depth, RuntimeScope *root) {
     return root;
 }
 
-std::shared_ptr<ValueHolder> RuntimeScope::get(const int depth, const std::string &name) {
-    return ancestorScope(depth, this)->_definitions.at(name);
+Value RuntimeScope::get(const int depth, const int slot) {
+    return ancestorScope(depth, this)->_slots[slot];
+}
+
+void RuntimeScope::assign(const int depth, const int slot, Value value) {
+    ancestorScope(depth, this)->_slots[slot] = std::move(value);
 }
 
-std::shared_ptr<ValueHolder> RuntimeScope::assign(const std::string &name, const std::shared_ptr<ValueHolder> &value) {
-    if (_definitions.contains(name)) {
-        const auto oldVal = _definitions[name];
-        _definitions[name] = value;
-        return oldVal;
+int RuntimeScope::globalSlot(const std::string_view name) {
+    if (const auto it = _globalSlots.find(name); it != _globalSlots.end()) {
+        return it->second;
     }
-    if (_parent != nullptr) {
-        return _parent->assign(name, value);
+    const auto slot = static_cast<int>(_globals.size());
+    _globals.push_back({std::string(name), Value(), false});
+    _globalSlots.emplace(name, slot);
+    return slot;
+}
+
+bool RuntimeScope::isDefined(const int globalSlot) const {
+    return _globals[globalSlot].isDefined;
+}
+
+const std::string &RuntimeScope::globalName(const int globalSlot) const {
+    return _globals[globalSlot].name;
+}
+
+Value &RuntimeScope::global(const int globalSlot) {
+    return _globals[globalSlot].value;
+}
+
+void RuntimeScope::defineGlobal(const int globalSlot, Value value) {
+    auto &global = _globals[globalSlot];
+    if (global.value.isObject(ObjectType::CALLABLE) && value.isObject(ObjectType::CALLABLE)) {
+        mergeCallables(global.value.as<CallableHolder>(), value.as<CallableHolder>());
+    } else {
+        // Replace symbol
+        global.value = std::move(value);
     }
-    throw std::runtime_error("No such variable");
+    global.isDefined = true;
 }
 
-std::shared_ptr<ValueHolder> RuntimeScope::assign(const int depth, const std::string &name,
-                                                  std::shared_ptr<ValueHolder> value) {
-    RuntimeScope *ancestor = ancestorScope(depth, this);
-    const auto oldVal = ancestor->_definitions[name];
-    ancestor->_definitions[name] = std::move(value);
-    return oldVal;
+void RuntimeScope::reset(std::shared_ptr<RuntimeScope> parentScope, const int slotCount) {
+    _parent = std::move(parentScope);
+    _slots.resize(slotCount);
+}
+
+Value RuntimeScope::local(const int localIndex, const ObjectType type) {
+    if (localIndex >= std::ssize(_region)) {
+        _region.resize(localIndex + 1);
+    }
+    auto &local = _region[localIndex];
+    if (local.isObject(type) && local.isUnique()) {
+        empty(local);
+    } else if (type == ObjectType::ARRAY) {
+        local = Value::ofObject(new ArrayValueHolder());
+    } else {
+        local = Value::ofObject(new MapValueHolder());
+    }
+    return local;
+}
+
+void RuntimeScope::empty(const Value &container) {
+    // Keeps the storage of the elements for the next run
+    if (container.isObject(ObjectType::ARRAY)) {
+        container.as<ArrayValueHolder>()->values.clear();
+    } else {
+        container.as<MapValueHolder>()->values.clear();
+    }
+}
+
+void RuntimeScope::clear() {
+    _parent = nullptr;
+    _slots.clear();
+    for (auto &local: _region) {
+        // Something still holding a container keeps it for itself
+        if (local.isUnique()) {
+            empty(local);
+        } else {
+            local = {};
+        }
+    }
+}
+
+long RuntimeScope::refCount() const {
+    return weak_from_this().use_count();
+}
+
+void RuntimeScope::traverse(const Tracer visit) {
+    if (_parent) {
+        visit(_parent.get());
+    }
+    for (const auto &global: _globals) {
+        global.value.trace(visit);
+    }
+    for (const auto &slot: _slots) {
+        slot.trace(visit);
+    }
+    for (const auto &local: _region) {
+        local.trace(visit);
+    }
+}
+
+void RuntimeScope::clearReferences() {
+    _parent = nullptr;
+    for (auto &global: _globals) {
+        global.value = {};
+    }
+    _slots.clear();
+    _region.clear();
+}
+
+std::shared_ptr<void> RuntimeScope::pin() {
+    return shared_from_this();
 }
 
 RuntimeScope::~RuntimeScope() = default;
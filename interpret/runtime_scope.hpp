@@ -7,32 +7,80 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "../lexical/value_holder.hpp"
 
-class RuntimeScope {
+// Scopes are tracked by the Collector, since a closure defined in a scope may be stored in it
+class RuntimeScope final : public Traceable, public std::enable_shared_from_this<RuntimeScope> {
+    struct Global {
+        std::string name;
+        Value value;
+        bool isDefined = false;
+    };
+
     std::shared_ptr<RuntimeScope> _parent;
 
-    std::map<std::string, std::shared_ptr<ValueHolder> > _definitions;
+    // Globals, only used by the global scope. Every name gets a stable slot the first time it is seen, so that callers
+    // can cache the slot instead of looking the name up again.
+    std::map<std::string, int, std::less<> > _globalSlots;
+    std::vector<Global> _globals;
+
+    // Locals, indexed by the slots the Resolver assigned
+    std::vector<Value> _slots;
+
+    // Containers the EscapeAnalyzer found to stay in the scope, indexed by their local index. They are kept across
+    // runs of the scope and reused while nothing else holds them.
+    std::vector<Value> _region;
 
     static RuntimeScope *ancestorScope(int depth, RuntimeScope *root);
 
+    static void empty(const Value &container);
+
 public:
-    static std::shared_ptr<ValueHolder> UNINITIALIZED_OBJECT;
+    explicit RuntimeScope(std::shared_ptr<RuntimeScope> parentScope, int slotCount = 0);
+
+    // Merges overloads of a function into an existing one, overloads with the same parameter size get replaced
+    static void mergeCallables(CallableHolder *oldFun, const CallableHolder *newFun);
+
+    Value define(std::string_view name, Value value);
+
+    void define(int slot, Value value);
+
+    Value get(int depth, int slot);
+
+    void assign(int depth, int slot, Value value);
+
+    // Slot of a global, added as undefined if the name is new
+    int globalSlot(std::string_view name);
+
+    [[nodiscard]] bool isDefined(int globalSlot) const;
+
+    [[nodiscard]] const std::string &globalName(int globalSlot) const;
+
+    // Only valid if the global is defined
+    Value &global(int globalSlot);
+
+    void defineGlobal(int globalSlot, Value value);
+
+    // Empty array or map of the given type for the local index, reused if nothing else holds the last one
+    Value local(int localIndex, ObjectType type);
 
-    explicit RuntimeScope(std::shared_ptr<RuntimeScope> parentScope);
+    // Rebinds a cleared scope, so that it can be reused for another block or call
+    void reset(std::shared_ptr<RuntimeScope> parentScope, int slotCount);
 
-    std::shared_ptr<ValueHolder> define(const std::string &name, std::shared_ptr<ValueHolder> value);
+    // Drops the parent and all locals, and empties the containers of the region
+    void clear();
 
-    std::shared_ptr<ValueHolder> get(const std::string &name);
+    [[nodiscard]] long refCount() const override;
 
-    std::shared_ptr<ValueHolder> get(int depth, const std::string &name);
+    void traverse(Tracer visit) override;
 
-    std::shared_ptr<ValueHolder> assign(const std::string &name, const std::shared_ptr<ValueHolder>& value);
+    void clearReferences() override;
 
-    std::shared_ptr<ValueHolder> assign(int depth, const std::string &name, std::shared_ptr<ValueHolder> value);
+    std::shared_ptr<void> pin() override;
 
-    ~RuntimeScope();
+    ~RuntimeScope() override;
 };
 
 #endif //SCOPE_HPP
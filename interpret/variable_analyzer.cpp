@@ -0,0 +1,262 @@
+#include "variable_analyzer.hpp"
+
+#include "resolver.hpp"
+
+void VariableAnalyzer::analyze(std::vector<Stmt *> *stmts) {
+    _scopes.emplace_back();
+    analyze(static_cast<const std::vector<Stmt *> *>(stmts));
+    for (const auto &[name, enclosingLoops, isInFunction]: _unboundAssignments) {
+        if (const auto it = _scopes.front().find(name); it != _scopes.front().end()) {
+            assigned(it->second, enclosingLoops, isInFunction);
+        }
+    }
+    _scopes.clear();
+    _functionDepths.clear();
+    _unboundAssignments.clear();
+}
+
+void VariableAnalyzer::analyze(Expr *expr) {
+    expr->accept((ExprVisitor *) this);
+}
+
+void VariableAnalyzer::analyze(Stmt *stmt) {
+    stmt->accept((StmtVisitor *) this);
+}
+
+void VariableAnalyzer::analyze(const std::vector<Stmt *> *stmts) {
+    for (const auto stmt: *stmts) {
+        analyze(stmt);
+    }
+}
+
+void VariableAnalyzer::declare(const Token *name) {
+    for (const auto loop: _loops) {
+        loop->declarations.insert(name);
+    }
+    auto &scope = _scopes.back();
+    if (const auto it = scope.find(name->lexeme()); it != scope.end()) {
+        // Both declarations write the same variable
+        reassigned.insert(it->second);
+        reassigned.insert(name);
+        it->second = name;
+    } else {
+        scope.emplace(name->lexeme(), name);
+    }
+    _functionDepths[name] = _functionDepth;
+}
+
+bool VariableAnalyzer::isTrivial(const Expr *expr) const {
+    switch (expr->kind) {
+        case ExprKind::LITERAL: return true;
+        case ExprKind::VARIABLE: return bindings.contains(static_cast<const VariableExpr *>(expr));
+        case ExprKind::GROUPING: return isTrivial(static_cast<const GroupingExpr *>(expr)->expr);
+        default: return false;
+    }
+}
+
+const Token *VariableAnalyzer::lookup(const std::string_view name) const {
+    for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it) {
+        if (const auto found = it->find(name); found != it->end()) {
+            return found->second;
+        }
+    }
+    return nullptr;
+}
+
+void VariableAnalyzer::assigned(const Token *name) {
+    if (const auto declaration = lookup(name->lexeme())) {
+        assigned(declaration, _loops, _functionDepth > _functionDepths[declaration]);
+    } else {
+        _unboundAssignments.push_back({name->lexeme(), _loops, _functionDepth > 0});
+    }
+}
+
+void VariableAnalyzer::assigned(const Token *declaration, const std::vector<LoopInfo *> &loops,
+                                const bool isInFunction) {
+    reassigned.insert(declaration);
+    if (isInFunction) {
+        assignedByCalls.insert(declaration);
+    }
+    for (const auto loop: loops) {
+        ++loop->assignments[declaration];
+    }
+}
+
+void VariableAnalyzer::visitBinaryExpr(BinaryExpr *expr) {
+    analyze(expr->left);
+    analyze(expr->right);
+}
+
+void VariableAnalyzer::visitGroupingExpr(GroupingExpr *expr) {
+    analyze(expr->expr);
+}
+
+void VariableAnalyzer::visitLiteralExpr([[maybe_unused]] LiteralExpr *expr) {
+}
+
+void VariableAnalyzer::visitUnaryExpr(UnaryExpr *expr) {
+    analyze(expr->right);
+}
+
+void VariableAnalyzer::visitTernaryExpr(TernaryExpr *expr) {
+    analyze(expr->condition);
+    analyze(expr->left);
+    analyze(expr->right);
+}
+
+void VariableAnalyzer::visitVariableExpr(VariableExpr *expr) {
+    if (const auto declaration = lookup(expr->name->lexeme())) {
+        bindings[expr] = declaration;
+    }
+}
+
+void VariableAnalyzer::visitAssignExpr(AssignExpr *expr) {
+    analyze(expr->value);
+    assigned(expr->name);
+}
+
+void VariableAnalyzer::visitLogicalExpr(LogicalExpr *expr) {
+    analyze(expr->left);
+    analyze(expr->right);
+}
+
+void VariableAnalyzer::visitCallExpr(CallExpr *expr) {
+    for (const auto loop: _loops) {
+        loop->hasCall = true;
+    }
+    analyze(expr->callee);
+    for (const auto arg: *expr->arguments) {
+        analyze(arg);
+    }
+}
+
+void VariableAnalyzer::visitArrayExpr(ArrayExpr *expr) {
+    for (const auto element: *expr->elements) {
+        analyze(element);
+    }
+}
+
+void VariableAnalyzer::visitIndexedCallExpr(IndexedCallExpr *expr) {
+    analyze(expr->callee);
+    analyze(expr->index);
+}
+
+void VariableAnalyzer::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
+    analyze(expr->callee);
+    analyze(expr->index);
+    analyze(expr->value);
+}
+
+void VariableAnalyzer::visitMapExpr(MapExpr *expr) {
+    for (const auto &[fst, snd]: *expr->elements) {
+        analyze(fst);
+        analyze(snd);
+    }
+}
+
+void VariableAnalyzer::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    if (expr->expr->kind == ExprKind::VARIABLE) {
+        assigned(static_cast<VariableExpr *>(expr->expr)->name);
+    }
+    analyze(expr->expr);
+}
+
+void VariableAnalyzer::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    if (expr->expr->kind == ExprKind::VARIABLE) {
+        assigned(static_cast<VariableExpr *>(expr->expr)->name);
+    }
+    analyze(expr->expr);
+}
+
+void VariableAnalyzer::visitStringLiteralExpr(StringLiteralExpr *expr) {
+    for (const auto e: *expr->values) {
+        analyze(e);
+    }
+}
+
+void VariableAnalyzer::visitInvariantExpr(InvariantExpr *expr) {
+    analyze(expr->expr);
+}
+
+void VariableAnalyzer::visitExprStmt(ExprStmt *stmt) {
+    analyze(stmt->expr);
+}
+
+void VariableAnalyzer::visitVarStmt(VarStmt *stmt) {
+    if (stmt->initializer) {
+        analyze(stmt->initializer);
+    }
+    declare(stmt->name);
+    variables[stmt->name] = stmt;
+}
+
+void VariableAnalyzer::visitBlockStmt(BlockStmt *stmt) {
+    const bool hasScope = Resolver::declaresLocals(stmt);
+    if (hasScope) {
+        _scopes.emplace_back();
+    }
+    analyze(static_cast<const std::vector<Stmt *> *>(stmt->stmts));
+    if (hasScope) {
+        _scopes.pop_back();
+    }
+}
+
+void VariableAnalyzer::visitIfStmt(IfStmt *stmt) {
+    analyze(stmt->condition);
+    analyze(stmt->thenBlock);
+    if (stmt->elseBlock) {
+        analyze(stmt->elseBlock);
+    }
+    // A declaration that is only run conditionally may never hold its initializer
+    for (const auto branch: {stmt->thenBlock, stmt->elseBlock}) {
+        if (branch && branch->kind == StmtKind::VAR) {
+            reassigned.insert(static_cast<VarStmt *>(branch)->name);
+        }
+    }
+}
+
+void VariableAnalyzer::visitWhileStmt(WhileStmt *stmt) {
+    _loops.push_back(&loops[stmt]);
+    if (stmt->condition) {
+        analyze(stmt->condition);
+    }
+    analyze(stmt->body);
+    if (stmt->increment) {
+        analyze(stmt->increment);
+    }
+    _loops.pop_back();
+    if (stmt->body->kind == StmtKind::VAR) {
+        reassigned.insert(static_cast<VarStmt *>(stmt->body)->name);
+    }
+}
+
+void VariableAnalyzer::visitFunctionStmt(FunctionStmt *stmt) {
+    declare(stmt->name);
+    functions.insert(stmt->name);
+    ++_functionDepth;
+    _scopes.emplace_back();
+    for (const auto param: *stmt->params) {
+        declare(param->name);
+    }
+    analyze(static_cast<const std::vector<Stmt *> *>(stmt->bodyBlock->stmts));
+    _scopes.pop_back();
+    --_functionDepth;
+}
+
+void VariableAnalyzer::visitReturnStmt(ReturnStmt *stmt) {
+    if (stmt->value) {
+        analyze(stmt->value);
+    }
+}
+
+void VariableAnalyzer::visitBreakStmt([[maybe_unused]] BreakStmt *stmt) {
+}
+
+void VariableAnalyzer::visitContinueStmt([[maybe_unused]] ContinueStmt *stmt) {
+}
+
+void VariableAnalyzer::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    analyze(stmt->condition);
+    analyze(stmt->body);
+    analyze(stmt->increment);
+}
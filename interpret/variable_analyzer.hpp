@@ -0,0 +1,127 @@
+#ifndef VARIABLE_ANALYZER_HPP
+#define VARIABLE_ANALYZER_HPP
+#include <map>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../parser/expr.hpp"
+#include "../parser/stmt.hpp"
+
+// Binds variable uses to their declarations with the same scoping rules as the Resolver, and finds where every
+// variable is assigned. A declaration is identified by the name token of its var statement, parameter or function.
+class VariableAnalyzer final : public ExprVisitor<void>, public StmtVisitor<void> {
+public:
+    struct LoopInfo {
+        // Number of assignments to every variable in the loop, including the functions declared in it
+        std::unordered_map<const Token *, int> assignments;
+        // Variables declared in the loop, which start over on every iteration
+        std::set<const Token *> declarations;
+        bool hasCall = false;
+    };
+
+private:
+    // Assignment to a name no declaration was visible for, which can only be a global declared later
+    struct UnboundAssignment {
+        std::string_view name;
+        std::vector<LoopInfo *> loops;
+        bool isInFunction;
+    };
+
+    // The first scope is the global one
+    std::vector<std::map<std::string_view, const Token *> > _scopes;
+    // Number of functions enclosing every declaration
+    std::unordered_map<const Token *, int> _functionDepths;
+    int _functionDepth = 0;
+    // Loops enclosing the current node, across function boundaries
+    std::vector<LoopInfo *> _loops;
+    std::vector<UnboundAssignment> _unboundAssignments;
+
+    void analyze(Expr *expr);
+
+    void analyze(Stmt *stmt);
+
+    void analyze(const std::vector<Stmt *> *stmts);
+
+    void declare(const Token *name);
+
+    const Token *lookup(std::string_view name) const;
+
+    void assigned(const Token *name);
+
+    void assigned(const Token *declaration, const std::vector<LoopInfo *> &loops, bool isInFunction);
+
+protected:
+    void visitBinaryExpr(BinaryExpr *expr) override;
+
+    void visitGroupingExpr(GroupingExpr *expr) override;
+
+    void visitLiteralExpr(LiteralExpr *expr) override;
+
+    void visitUnaryExpr(UnaryExpr *expr) override;
+
+    void visitTernaryExpr(TernaryExpr *expr) override;
+
+    void visitVariableExpr(VariableExpr *expr) override;
+
+    void visitAssignExpr(AssignExpr *expr) override;
+
+    void visitLogicalExpr(LogicalExpr *expr) override;
+
+    void visitCallExpr(CallExpr *expr) override;
+
+    void visitArrayExpr(ArrayExpr *expr) override;
+
+    void visitIndexedCallExpr(IndexedCallExpr *expr) override;
+
+    void visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+
+    void visitMapExpr(MapExpr *expr) override;
+
+    void visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+
+    void visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+
+    void visitStringLiteralExpr(StringLiteralExpr *expr) override;
+
+    void visitInvariantExpr(InvariantExpr *expr) override;
+
+    void visitExprStmt(ExprStmt *stmt) override;
+
+    void visitVarStmt(VarStmt *stmt) override;
+
+    void visitBlockStmt(BlockStmt *stmt) override;
+
+    void visitIfStmt(IfStmt *stmt) override;
+
+    void visitWhileStmt(WhileStmt *stmt) override;
+
+    void visitFunctionStmt(FunctionStmt *stmt) override;
+
+    void visitReturnStmt(ReturnStmt *stmt) override;
+
+    void visitBreakStmt(BreakStmt *stmt) override;
+
+    void visitContinueStmt(ContinueStmt *stmt) override;
+
+    void visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
+public:
+    // Declaration of every variable read that was declared before
+    std::unordered_map<const VariableExpr *, const Token *> bindings;
+    std::unordered_map<const Token *, VarStmt *> variables;
+    std::set<const Token *> functions;
+    // Variables whose value may change after their declaration
+    std::set<const Token *> reassigned;
+
+    // Literals and declared variables, which can neither fail nor change anything
+    [[nodiscard]] bool isTrivial(const Expr *expr) const;
+    // Variables assigned by functions nested in the one declaring them, which any call may run
+    std::set<const Token *> assignedByCalls;
+    std::unordered_map<const WhileStmt *, LoopInfo> loops;
+
+    void analyze(std::vector<Stmt *> *stmts);
+};
+
+#endif //VARIABLE_ANALYZER_HPP
@@ -0,0 +1,273 @@
+#include "assembler.hpp"
+
+static constexpr uint8_t REX_W = 0x48;
+
+static uint8_t encoding(const Register reg) {
+    return static_cast<uint8_t>(reg);
+}
+
+static uint8_t encoding(const XmmRegister reg) {
+    return static_cast<uint8_t>(reg);
+}
+
+void Assembler::emit(const uint8_t byte) {
+    _code.push_back(byte);
+}
+
+void Assembler::emit32(const uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        emit(static_cast<uint8_t>(value >> i * 8));
+    }
+}
+
+void Assembler::emit64(const uint64_t value) {
+    emit32(static_cast<uint32_t>(value));
+    emit32(static_cast<uint32_t>(value >> 32));
+}
+
+void Assembler::modRM(const uint8_t reg, const uint8_t rm) {
+    emit(0xC0 | reg << 3 | rm);
+}
+
+void Assembler::memory(const uint8_t reg, const Register base, const int32_t disp) {
+    emit(0x80 | reg << 3 | encoding(base));
+    if (base == Register::RSP) {
+        emit(0x24);
+    }
+    emit32(disp);
+}
+
+void Assembler::sse(const uint8_t prefix, const uint8_t opcode, const XmmRegister dst, const XmmRegister src) {
+    emit(prefix);
+    emit(0x0F);
+    emit(opcode);
+    modRM(encoding(dst), encoding(src));
+}
+
+void Assembler::arithmetic32(const uint8_t opcode, const Register dst, const Register src) {
+    emit(opcode);
+    modRM(encoding(src), encoding(dst));
+}
+
+void Assembler::jump(const std::initializer_list<uint8_t> &opcode, Label &label) {
+    for (const auto byte: opcode) {
+        emit(byte);
+    }
+    if (label._position >= 0) {
+        emit32(static_cast<uint32_t>(label._position - static_cast<long>(size() + 4)));
+    } else {
+        label._uses.push_back(size());
+        emit32(0);
+    }
+}
+
+void Assembler::patch32(const ulong offset, const uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        _code[offset + i] = static_cast<uint8_t>(value >> i * 8);
+    }
+}
+
+void Assembler::push(const Register reg) {
+    emit(0x50 + encoding(reg));
+}
+
+void Assembler::pop(const Register reg) {
+    emit(0x58 + encoding(reg));
+}
+
+void Assembler::mov(const Register dst, const Register src) {
+    emit(REX_W);
+    arithmetic32(0x89, dst, src);
+}
+
+void Assembler::movImm(const Register dst, const uint32_t value) {
+    emit(0xB8 + encoding(dst));
+    emit32(value);
+}
+
+void Assembler::movImm64(const Register dst, const uint64_t value) {
+    emit(REX_W);
+    emit(0xB8 + encoding(dst));
+    emit64(value);
+}
+
+void Assembler::load(const Register dst, const Register base, const int32_t disp) {
+    emit(REX_W);
+    emit(0x8B);
+    memory(encoding(dst), base, disp);
+}
+
+void Assembler::store(const Register base, const int32_t disp, const Register src) {
+    emit(REX_W);
+    emit(0x89);
+    memory(encoding(src), base, disp);
+}
+
+void Assembler::loadSd(const XmmRegister dst, const Register base, const int32_t disp) {
+    emit(0xF2);
+    emit(0x0F);
+    emit(0x10);
+    memory(encoding(dst), base, disp);
+}
+
+void Assembler::storeSd(const Register base, const int32_t disp, const XmmRegister src) {
+    emit(0xF2);
+    emit(0x0F);
+    emit(0x11);
+    memory(encoding(src), base, disp);
+}
+
+void Assembler::addImm(const Register dst, const int32_t value) {
+    emit(REX_W);
+    emit(0x81);
+    modRM(0, encoding(dst));
+    emit32(value);
+}
+
+ulong Assembler::subImm(const Register dst, const int32_t value) {
+    emit(REX_W);
+    emit(0x81);
+    modRM(5, encoding(dst));
+    const auto offset = size();
+    emit32(value);
+    return offset;
+}
+
+void Assembler::add32(const Register dst, const Register src) {
+    arithmetic32(0x01, dst, src);
+}
+
+void Assembler::sub32(const Register dst, const Register src) {
+    arithmetic32(0x29, dst, src);
+}
+
+void Assembler::and32(const Register dst, const Register src) {
+    arithmetic32(0x21, dst, src);
+}
+
+void Assembler::or32(const Register dst, const Register src) {
+    arithmetic32(0x09, dst, src);
+}
+
+void Assembler::xor32(const Register dst, const Register src) {
+    arithmetic32(0x31, dst, src);
+}
+
+void Assembler::cmp32(const Register left, const Register right) {
+    arithmetic32(0x39, left, right);
+}
+
+void Assembler::test32(const Register left, const Register right) {
+    arithmetic32(0x85, left, right);
+}
+
+void Assembler::imul32(const Register dst, const Register src) {
+    emit(0x0F);
+    emit(0xAF);
+    modRM(encoding(dst), encoding(src));
+}
+
+void Assembler::neg32(const Register reg) {
+    emit(0xF7);
+    modRM(3, encoding(reg));
+}
+
+void Assembler::cdq() {
+    emit(0x99);
+}
+
+void Assembler::idiv32(const Register divisor) {
+    emit(0xF7);
+    modRM(7, encoding(divisor));
+}
+
+void Assembler::setcc(const Condition condition, const Register dst) {
+    emit(0x0F);
+    emit(0x90 + static_cast<uint8_t>(condition));
+    modRM(0, encoding(dst));
+}
+
+void Assembler::movzx8(const Register dst, const Register src) {
+    emit(0x0F);
+    emit(0xB6);
+    modRM(encoding(dst), encoding(src));
+}
+
+void Assembler::btc64(const Register reg, const uint8_t bit) {
+    emit(REX_W);
+    emit(0x0F);
+    emit(0xBA);
+    modRM(7, encoding(reg));
+    emit(bit);
+}
+
+void Assembler::movsd(const XmmRegister dst, const XmmRegister src) {
+    sse(0xF2, 0x10, dst, src);
+}
+
+void Assembler::addsd(const XmmRegister dst, const XmmRegister src) {
+    sse(0xF2, 0x58, dst, src);
+}
+
+void Assembler::subsd(const XmmRegister dst, const XmmRegister src) {
+    sse(0xF2, 0x5C, dst, src);
+}
+
+void Assembler::mulsd(const XmmRegister dst, const XmmRegister src) {
+    sse(0xF2, 0x59, dst, src);
+}
+
+void Assembler::divsd(const XmmRegister dst, const XmmRegister src) {
+    sse(0xF2, 0x5E, dst, src);
+}
+
+void Assembler::ucomisd(const XmmRegister left, const XmmRegister right) {
+    sse(0x66, 0x2E, left, right);
+}
+
+void Assembler::cvtsi2sd(const XmmRegister dst, const Register src) {
+    emit(0xF2);
+    emit(0x0F);
+    emit(0x2A);
+    modRM(encoding(dst), encoding(src));
+}
+
+void Assembler::movq(const XmmRegister dst, const Register src) {
+    emit(0x66);
+    emit(REX_W);
+    emit(0x0F);
+    emit(0x6E);
+    modRM(encoding(dst), encoding(src));
+}
+
+void Assembler::movq(const Register dst, const XmmRegister src) {
+    emit(0x66);
+    emit(REX_W);
+    emit(0x0F);
+    emit(0x7E);
+    modRM(encoding(src), encoding(dst));
+}
+
+void Assembler::jmp(Label &label) {
+    jump({0xE9}, label);
+}
+
+void Assembler::jcc(const Condition condition, Label &label) {
+    jump({0x0F, static_cast<uint8_t>(0x80 + static_cast<uint8_t>(condition))}, label);
+}
+
+void Assembler::bind(Label &label) {
+    label._position = static_cast<long>(size());
+    for (const auto use: label._uses) {
+        patch32(use, static_cast<uint32_t>(label._position - static_cast<long>(use + 4)));
+    }
+    label._uses.clear();
+}
+
+void Assembler::leave() {
+    emit(0xC9);
+}
+
+void Assembler::ret() {
+    emit(0xC3);
+}
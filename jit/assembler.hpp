@@ -0,0 +1,151 @@
+#ifndef ASSEMBLER_HPP
+#define ASSEMBLER_HPP
+#include <cstdint>
+#include <initializer_list>
+#include <sys/types.h>
+#include <vector>
+
+// General purpose registers, only the ones encodable without a REX.R or REX.B prefix
+enum class Register : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI
+};
+
+enum class XmmRegister : uint8_t {
+    XMM0, XMM1
+};
+
+// Condition codes of jcc and setcc. The signed ones test the flags of int comparisons, the unsigned ones the flags
+// set by ucomisd.
+enum class Condition : uint8_t {
+    BELOW = 0x2, ABOVE_EQUAL = 0x3, EQUAL = 0x4, NOT_EQUAL = 0x5, BELOW_EQUAL = 0x6, ABOVE = 0x7,
+    PARITY = 0xA, NOT_PARITY = 0xB, LESS = 0xC, GREATER_EQUAL = 0xD, LESS_EQUAL = 0xE, GREATER = 0xF
+};
+
+// Position in the code that jumps can target before it is known
+class Label final {
+    friend class Assembler;
+
+    long _position = -1;
+    // Offsets of the rel32 operands jumping here, patched once the label is bound
+    std::vector<ulong> _uses;
+};
+
+// Encodes the few x86-64 instructions the JitCompiler emits. Memory operands are a base register plus a 32-bit
+// displacement, integer arithmetic is 32-bit like the ints of the language.
+class Assembler final {
+    std::vector<uint8_t> _code;
+
+    void emit(uint8_t byte);
+
+    void emit32(uint32_t value);
+
+    void emit64(uint64_t value);
+
+    void modRM(uint8_t reg, uint8_t rm);
+
+    // ModR/M of [base + disp], with the SIB byte rsp as base needs
+    void memory(uint8_t reg, Register base, int32_t disp);
+
+    void sse(uint8_t prefix, uint8_t opcode, XmmRegister dst, XmmRegister src);
+
+    void arithmetic32(uint8_t opcode, Register dst, Register src);
+
+    void jump(const std::initializer_list<uint8_t> &opcode, Label &label);
+
+public:
+    [[nodiscard]] const std::vector<uint8_t> &code() const {
+        return _code;
+    }
+
+    [[nodiscard]] ulong size() const {
+        return _code.size();
+    }
+
+    // Overwrites the 32-bit immediate at offset
+    void patch32(ulong offset, uint32_t value);
+
+    void push(Register reg);
+
+    void pop(Register reg);
+
+    void mov(Register dst, Register src);
+
+    // Zero extends the immediate into the whole register
+    void movImm(Register dst, uint32_t value);
+
+    void movImm64(Register dst, uint64_t value);
+
+    void load(Register dst, Register base, int32_t disp);
+
+    void store(Register base, int32_t disp, Register src);
+
+    void loadSd(XmmRegister dst, Register base, int32_t disp);
+
+    void storeSd(Register base, int32_t disp, XmmRegister src);
+
+    void addImm(Register dst, int32_t value);
+
+    // Returns the offset of the immediate, for frames whose size is only known at the end
+    ulong subImm(Register dst, int32_t value);
+
+    void add32(Register dst, Register src);
+
+    void sub32(Register dst, Register src);
+
+    void and32(Register dst, Register src);
+
+    void or32(Register dst, Register src);
+
+    void xor32(Register dst, Register src);
+
+    void cmp32(Register left, Register right);
+
+    void test32(Register left, Register right);
+
+    void imul32(Register dst, Register src);
+
+    void neg32(Register reg);
+
+    // Sign extends eax into edx for idiv32
+    void cdq();
+
+    // Divides edx:eax, the quotient goes to eax
+    void idiv32(Register divisor);
+
+    // Only the low byte registers of rax to rbx can be set
+    void setcc(Condition condition, Register dst);
+
+    void movzx8(Register dst, Register src);
+
+    void btc64(Register reg, uint8_t bit);
+
+    void movsd(XmmRegister dst, XmmRegister src);
+
+    void addsd(XmmRegister dst, XmmRegister src);
+
+    void subsd(XmmRegister dst, XmmRegister src);
+
+    void mulsd(XmmRegister dst, XmmRegister src);
+
+    void divsd(XmmRegister dst, XmmRegister src);
+
+    void ucomisd(XmmRegister left, XmmRegister right);
+
+    void cvtsi2sd(XmmRegister dst, Register src);
+
+    void movq(XmmRegister dst, Register src);
+
+    void movq(Register dst, XmmRegister src);
+
+    void jmp(Label &label);
+
+    void jcc(Condition condition, Label &label);
+
+    void bind(Label &label);
+
+    void leave();
+
+    void ret();
+};
+
+#endif //ASSEMBLER_HPP
@@ -0,0 +1,28 @@
+#include "jit.hpp"
+
+#include "jit_compiler.hpp"
+
+bool Jit::call(FunctionStmt *fun, const std::span<const Value> args, Value &result) {
+    if (!JIT_SUPPORTED || !isEnabled) {
+        return false;
+    }
+    if (fun->nativeCode == nullptr) {
+        if (++fun->callCount != HOT_CALL_COUNT) {
+            return false;
+        }
+        std::vector<NativeType> paramTypes;
+        for (const auto &arg: args) {
+            const auto type = NativeCode::typeOf(arg);
+            if (!type) {
+                return false;
+            }
+            paramTypes.push_back(*type);
+        }
+        auto code = JitCompiler::compile(fun, paramTypes);
+        if (code == nullptr) {
+            return false;
+        }
+        fun->nativeCode = _codes.emplace_back(std::move(code)).get();
+    }
+    return fun->nativeCode->run(args, result);
+}
@@ -0,0 +1,24 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+#include <memory>
+#include <vector>
+
+#include "native_code.hpp"
+#include "../parser/stmt.hpp"
+
+// Tiers functions up from the Interpreter to native code. Calls are counted per function until it gets hot, it is
+// then compiled once for the types of the arguments of that call. Functions that can't be compiled stay interpreted.
+class Jit final {
+    static constexpr ulong HOT_CALL_COUNT = 1000;
+
+    // Code of every compiled function, the FunctionStmts only point at it
+    std::vector<std::unique_ptr<NativeCode> > _codes;
+
+public:
+    bool isEnabled = true;
+
+    // Returns false if the call has to be interpreted
+    bool call(FunctionStmt *fun, std::span<const Value> args, Value &result);
+};
+
+#endif //JIT_HPP
@@ -0,0 +1,500 @@
+#include "jit_compiler.hpp"
+
+std::unique_ptr<NativeCode> JitCompiler::compile(const FunctionStmt *fun, const std::vector<NativeType> &paramTypes) {
+    if (fun->params->size() != paramTypes.size() || paramTypes.size() > NativeCode::MAX_PARAMS) {
+        return nullptr;
+    }
+    JitCompiler compiler;
+    auto &assembler = compiler._asm;
+    try {
+        assembler.push(Register::RBP);
+        assembler.mov(Register::RBP, Register::RSP);
+        const auto frameSize = assembler.subImm(Register::RSP, 0);
+        // The parameters share one scope with the body, the raw arguments are copied from rdi into their slots
+        compiler._scopes.emplace_back();
+        for (ulong i = 0; i < paramTypes.size(); ++i) {
+            const auto param = fun->params->at(i);
+            if (param->isVararg) {
+                return nullptr;
+            }
+            assembler.load(Register::RAX, Register::RDI, static_cast<int32_t>(i * 8));
+            assembler.store(Register::RBP, offsetOf(compiler.declare(param->name, paramTypes[i])), Register::RAX);
+        }
+        for (const auto stmt: *fun->bodyBlock->stmts) {
+            compiler.emit(stmt);
+        }
+        // Running off the end returns null, which is left to the interpreter as well
+        assembler.bind(compiler._bailout);
+        assembler.movImm(Register::RAX, 1);
+        assembler.leave();
+        assembler.ret();
+        if (!compiler._returnType) {
+            return nullptr;
+        }
+        // Keeps rsp 16 bytes aligned
+        assembler.patch32(frameSize, (compiler._slotCount * 8 + 15) & ~15);
+    } catch ([[maybe_unused]] const Unsupported &e) {
+        return nullptr;
+    }
+    return NativeCode::make(assembler.code(), paramTypes, *compiler._returnType);
+}
+
+NativeType JitCompiler::emit(Expr *expr) {
+    return expr->accept((ExprVisitor *) this);
+}
+
+void JitCompiler::emit(Stmt *stmt) {
+    stmt->accept((StmtVisitor *) this);
+}
+
+void JitCompiler::emitBody(Stmt *stmt) {
+    // A declaration as a branch or a loop body may leave its variable unset
+    if (stmt->kind == StmtKind::VAR) {
+        throw Unsupported();
+    }
+    emit(stmt);
+}
+
+JitCompiler::Variable JitCompiler::declare(const Token *name, const NativeType type) {
+    const Variable variable{_slotCount++, type};
+    _scopes.back()[name->lexeme()] = variable;
+    return variable;
+}
+
+const JitCompiler::Variable &JitCompiler::lookup(const Token *name) const {
+    for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it) {
+        if (const auto found = it->find(name->lexeme()); found != it->end()) {
+            return found->second;
+        }
+    }
+    // Globals and variables captured from enclosing functions may be changed by anyone
+    throw Unsupported();
+}
+
+int JitCompiler::offsetOf(const Variable &variable) {
+    return -8 * (variable.slot + 1);
+}
+
+void JitCompiler::load(const Variable &variable) {
+    if (variable.type == NativeType::DOUBLE) {
+        _asm.loadSd(XmmRegister::XMM0, Register::RBP, offsetOf(variable));
+    } else {
+        _asm.load(Register::RAX, Register::RBP, offsetOf(variable));
+    }
+}
+
+void JitCompiler::store(const Variable &variable) {
+    if (variable.type == NativeType::DOUBLE) {
+        _asm.storeSd(Register::RBP, offsetOf(variable), XmmRegister::XMM0);
+    } else {
+        _asm.store(Register::RBP, offsetOf(variable), Register::RAX);
+    }
+}
+
+void JitCompiler::push(const NativeType type) {
+    if (type == NativeType::DOUBLE) {
+        _asm.movq(Register::RAX, XmmRegister::XMM0);
+    }
+    _asm.push(Register::RAX);
+}
+
+void JitCompiler::jumpIfFalsy(const NativeType type, Label &label) {
+    // Doubles are always truthy, even zero
+    if (type != NativeType::DOUBLE) {
+        _asm.test32(Register::RAX, Register::RAX);
+        _asm.jcc(Condition::EQUAL, label);
+    }
+}
+
+void JitCompiler::jumpIfTruthy(const NativeType type, Label &label) {
+    if (type == NativeType::DOUBLE) {
+        _asm.jmp(label);
+    } else {
+        _asm.test32(Register::RAX, Register::RAX);
+        _asm.jcc(Condition::NOT_EQUAL, label);
+    }
+}
+
+bool JitCompiler::isNumber(const NativeType type) {
+    return type == NativeType::INT || type == NativeType::DOUBLE;
+}
+
+NativeType JitCompiler::step(Expr *target, const Token *op, const bool isPrefix) {
+    if (target->kind != ExprKind::VARIABLE) {
+        throw Unsupported();
+    }
+    const auto variable = lookup(static_cast<VariableExpr *>(target)->name);
+    const int delta = op->type() == PLUS_PLUS ? 1 : -1;
+    load(variable);
+    if (!isPrefix) {
+        push(variable.type);
+    }
+    if (variable.type == NativeType::INT) {
+        _asm.addImm(Register::RAX, delta);
+    } else if (variable.type == NativeType::DOUBLE) {
+        _asm.movImm(Register::RCX, static_cast<uint32_t>(delta));
+        _asm.cvtsi2sd(XmmRegister::XMM1, Register::RCX);
+        _asm.addsd(XmmRegister::XMM0, XmmRegister::XMM1);
+    } else {
+        throw Unsupported();
+    }
+    store(variable);
+    if (!isPrefix) {
+        _asm.pop(Register::RAX);
+        if (variable.type == NativeType::DOUBLE) {
+            _asm.movq(XmmRegister::XMM0, Register::RAX);
+        }
+    }
+    return variable.type;
+}
+
+void JitCompiler::loop(Expr *condition, Stmt *body, Expr *increment) {
+    Label start, next, end;
+    _asm.bind(start);
+    if (condition) {
+        jumpIfFalsy(emit(condition), end);
+    }
+    _loops.push_back({&end, &next});
+    emitBody(body);
+    _loops.pop_back();
+    _asm.bind(next);
+    if (increment) {
+        emit(increment);
+    }
+    _asm.jmp(start);
+    _asm.bind(end);
+}
+
+void JitCompiler::visitExprStmt(ExprStmt *stmt) {
+    emit(stmt->expr);
+}
+
+void JitCompiler::visitVarStmt(VarStmt *stmt) {
+    if (stmt->initializer == nullptr) {
+        throw Unsupported();
+    }
+    // Declared after the initializer, which still sees any variable it shadows
+    const auto type = emit(stmt->initializer);
+    store(declare(stmt->name, type));
+}
+
+void JitCompiler::visitBlockStmt(BlockStmt *stmt) {
+    _scopes.emplace_back();
+    for (const auto s: *stmt->stmts) {
+        emit(s);
+    }
+    _scopes.pop_back();
+}
+
+void JitCompiler::visitIfStmt(IfStmt *stmt) {
+    Label elseBranch, end;
+    jumpIfFalsy(emit(stmt->condition), elseBranch);
+    emitBody(stmt->thenBlock);
+    if (stmt->elseBlock) {
+        _asm.jmp(end);
+    }
+    _asm.bind(elseBranch);
+    if (stmt->elseBlock) {
+        emitBody(stmt->elseBlock);
+    }
+    _asm.bind(end);
+}
+
+void JitCompiler::visitWhileStmt(WhileStmt *stmt) {
+    loop(stmt->condition, stmt->body, stmt->increment);
+}
+
+void JitCompiler::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    // The limit is invariant and side effect free, so comparing with it on every step gives the same result
+    loop(stmt->condition, stmt->body, stmt->increment);
+}
+
+void JitCompiler::visitFunctionStmt([[maybe_unused]] FunctionStmt *stmt) {
+    throw Unsupported();
+}
+
+void JitCompiler::visitReturnStmt(ReturnStmt *stmt) {
+    if (stmt->value == nullptr) {
+        throw Unsupported();
+    }
+    const auto type = emit(stmt->value);
+    if (_returnType && *_returnType != type) {
+        throw Unsupported();
+    }
+    _returnType = type;
+    if (type == NativeType::DOUBLE) {
+        _asm.storeSd(Register::RSI, 0, XmmRegister::XMM0);
+    } else {
+        _asm.store(Register::RSI, 0, Register::RAX);
+    }
+    _asm.xor32(Register::RAX, Register::RAX);
+    _asm.leave();
+    _asm.ret();
+}
+
+void JitCompiler::visitBreakStmt([[maybe_unused]] BreakStmt *stmt) {
+    if (_loops.empty()) {
+        throw Unsupported();
+    }
+    _asm.jmp(*_loops.back().breakLabel);
+}
+
+void JitCompiler::visitContinueStmt([[maybe_unused]] ContinueStmt *stmt) {
+    if (_loops.empty()) {
+        throw Unsupported();
+    }
+    _asm.jmp(*_loops.back().continueLabel);
+}
+
+NativeType JitCompiler::visitBinaryExpr(BinaryExpr *expr) {
+    const auto leftType = emit(expr->left);
+    push(leftType);
+    const auto rightType = emit(expr->right);
+    if (!isNumber(leftType) || !isNumber(rightType)) {
+        throw Unsupported();
+    }
+    const auto type = expr->op->type();
+    if (leftType == NativeType::INT && rightType == NativeType::INT) {
+        _asm.mov(Register::RCX, Register::RAX);
+        _asm.pop(Register::RAX);
+        Condition condition;
+        switch (type) {
+            case PLUS: _asm.add32(Register::RAX, Register::RCX);
+                return NativeType::INT;
+            case MINUS: _asm.sub32(Register::RAX, Register::RCX);
+                return NativeType::INT;
+            case STAR: _asm.imul32(Register::RAX, Register::RCX);
+                return NativeType::INT;
+            case SLASH: {
+                // The interpreter reports the division by zero
+                _asm.test32(Register::RCX, Register::RCX);
+                _asm.jcc(Condition::EQUAL, _bailout);
+                _asm.cdq();
+                _asm.idiv32(Register::RCX);
+                return NativeType::INT;
+            }
+            case GREATER: condition = Condition::GREATER;
+                break;
+            case GREATER_EQUAL: condition = Condition::GREATER_EQUAL;
+                break;
+            case LESS: condition = Condition::LESS;
+                break;
+            case LESS_EQUAL: condition = Condition::LESS_EQUAL;
+                break;
+            case EQUAL_EQUAL: condition = Condition::EQUAL;
+                break;
+            case BANG_EQUAL: condition = Condition::NOT_EQUAL;
+                break;
+            default: throw Unsupported();
+        }
+        _asm.cmp32(Register::RAX, Register::RCX);
+        _asm.setcc(condition, Register::RAX);
+        _asm.movzx8(Register::RAX, Register::RAX);
+        return NativeType::BOOL;
+    }
+    // Any double operand makes it a double operation, the left one goes to xmm0 and the right one to xmm1
+    if (rightType == NativeType::INT) {
+        _asm.cvtsi2sd(XmmRegister::XMM1, Register::RAX);
+    } else {
+        _asm.movsd(XmmRegister::XMM1, XmmRegister::XMM0);
+    }
+    _asm.pop(Register::RAX);
+    if (leftType == NativeType::INT) {
+        _asm.cvtsi2sd(XmmRegister::XMM0, Register::RAX);
+    } else {
+        _asm.movq(XmmRegister::XMM0, Register::RAX);
+    }
+    switch (type) {
+        case PLUS: _asm.addsd(XmmRegister::XMM0, XmmRegister::XMM1);
+            return NativeType::DOUBLE;
+        case MINUS: _asm.subsd(XmmRegister::XMM0, XmmRegister::XMM1);
+            return NativeType::DOUBLE;
+        case STAR: _asm.mulsd(XmmRegister::XMM0, XmmRegister::XMM1);
+            return NativeType::DOUBLE;
+        case SLASH: _asm.divsd(XmmRegister::XMM0, XmmRegister::XMM1);
+            return NativeType::DOUBLE;
+        // ucomisd sets the unsigned conditions, and all of them but inequality fail on NaN
+        case GREATER: _asm.ucomisd(XmmRegister::XMM0, XmmRegister::XMM1);
+            _asm.setcc(Condition::ABOVE, Register::RAX);
+            break;
+        case GREATER_EQUAL: _asm.ucomisd(XmmRegister::XMM0, XmmRegister::XMM1);
+            _asm.setcc(Condition::ABOVE_EQUAL, Register::RAX);
+            break;
+        case LESS: _asm.ucomisd(XmmRegister::XMM1, XmmRegister::XMM0);
+            _asm.setcc(Condition::ABOVE, Register::RAX);
+            break;
+        case LESS_EQUAL: _asm.ucomisd(XmmRegister::XMM1, XmmRegister::XMM0);
+            _asm.setcc(Condition::ABOVE_EQUAL, Register::RAX);
+            break;
+        case EQUAL_EQUAL: {
+            _asm.ucomisd(XmmRegister::XMM0, XmmRegister::XMM1);
+            _asm.setcc(Condition::EQUAL, Register::RAX);
+            _asm.setcc(Condition::NOT_PARITY, Register::RCX);
+            _asm.and32(Register::RAX, Register::RCX);
+            break;
+        }
+        case BANG_EQUAL: {
+            _asm.ucomisd(XmmRegister::XMM0, XmmRegister::XMM1);
+            _asm.setcc(Condition::NOT_EQUAL, Register::RAX);
+            _asm.setcc(Condition::PARITY, Register::RCX);
+            _asm.or32(Register::RAX, Register::RCX);
+            break;
+        }
+        default: throw Unsupported();
+    }
+    _asm.movzx8(Register::RAX, Register::RAX);
+    return NativeType::BOOL;
+}
+
+NativeType JitCompiler::visitGroupingExpr(GroupingExpr *expr) {
+    return emit(expr->expr);
+}
+
+NativeType JitCompiler::visitLiteralExpr(LiteralExpr *expr) {
+    const auto &constant = expr->constant;
+    if (constant.isInt()) {
+        _asm.movImm(Register::RAX, static_cast<uint32_t>(constant.asInt()));
+        return NativeType::INT;
+    }
+    if (constant.isDouble()) {
+        const double value = constant.asDouble();
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        _asm.movImm64(Register::RAX, bits);
+        _asm.movq(XmmRegister::XMM0, Register::RAX);
+        return NativeType::DOUBLE;
+    }
+    if (constant.isBool()) {
+        _asm.movImm(Register::RAX, constant.asBool());
+        return NativeType::BOOL;
+    }
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitUnaryExpr(UnaryExpr *expr) {
+    const auto type = emit(expr->right);
+    switch (expr->op->type()) {
+        case PLUS: {
+            if (!isNumber(type)) {
+                throw Unsupported();
+            }
+            return type;
+        }
+        case MINUS: {
+            if (type == NativeType::INT) {
+                _asm.neg32(Register::RAX);
+            } else if (type == NativeType::DOUBLE) {
+                _asm.movq(Register::RAX, XmmRegister::XMM0);
+                _asm.btc64(Register::RAX, 63);
+                _asm.movq(XmmRegister::XMM0, Register::RAX);
+            } else {
+                throw Unsupported();
+            }
+            return type;
+        }
+        case BANG: {
+            if (type == NativeType::DOUBLE) {
+                _asm.xor32(Register::RAX, Register::RAX);
+            } else {
+                _asm.test32(Register::RAX, Register::RAX);
+                _asm.setcc(Condition::EQUAL, Register::RAX);
+                _asm.movzx8(Register::RAX, Register::RAX);
+            }
+            return NativeType::BOOL;
+        }
+        default: throw Unsupported();
+    }
+}
+
+NativeType JitCompiler::visitTernaryExpr(TernaryExpr *expr) {
+    // Both branches are evaluated like in the interpreter, which reports any error in them
+    if (emit(expr->condition) == NativeType::DOUBLE) {
+        _asm.movImm(Register::RAX, 1);
+    }
+    _asm.push(Register::RAX);
+    const auto type = emit(expr->left);
+    push(type);
+    if (emit(expr->right) != type) {
+        throw Unsupported();
+    }
+    Label end;
+    _asm.pop(Register::RCX);
+    _asm.pop(Register::RDX);
+    _asm.test32(Register::RDX, Register::RDX);
+    _asm.jcc(Condition::EQUAL, end);
+    if (type == NativeType::DOUBLE) {
+        _asm.movq(XmmRegister::XMM0, Register::RCX);
+    } else {
+        _asm.mov(Register::RAX, Register::RCX);
+    }
+    _asm.bind(end);
+    return type;
+}
+
+NativeType JitCompiler::visitVariableExpr(VariableExpr *expr) {
+    const auto &variable = lookup(expr->name);
+    load(variable);
+    return variable.type;
+}
+
+NativeType JitCompiler::visitAssignExpr(AssignExpr *expr) {
+    const auto type = emit(expr->value);
+    const auto &variable = lookup(expr->name);
+    if (variable.type != type) {
+        throw Unsupported();
+    }
+    store(variable);
+    return type;
+}
+
+NativeType JitCompiler::visitLogicalExpr(LogicalExpr *expr) {
+    const auto type = emit(expr->left);
+    Label end;
+    if (expr->op->type() == OR) {
+        jumpIfTruthy(type, end);
+    } else {
+        jumpIfFalsy(type, end);
+    }
+    if (emit(expr->right) != type) {
+        throw Unsupported();
+    }
+    _asm.bind(end);
+    return type;
+}
+
+NativeType JitCompiler::visitCallExpr([[maybe_unused]] CallExpr *expr) {
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitArrayExpr([[maybe_unused]] ArrayExpr *expr) {
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitIndexedCallExpr([[maybe_unused]] IndexedCallExpr *expr) {
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitIndexedEleAssignExpr([[maybe_unused]] ArrayElementAssignExpr *expr) {
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitMapExpr([[maybe_unused]] MapExpr *expr) {
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    return step(expr->expr, expr->op, true);
+}
+
+NativeType JitCompiler::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    return step(expr->expr, expr->op, false);
+}
+
+NativeType JitCompiler::visitStringLiteralExpr([[maybe_unused]] StringLiteralExpr *expr) {
+    throw Unsupported();
+}
+
+NativeType JitCompiler::visitInvariantExpr(InvariantExpr *expr) {
+    // Cheap enough to evaluate natively on every iteration
+    return emit(expr->expr);
+}
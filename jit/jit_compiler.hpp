@@ -0,0 +1,133 @@
+#ifndef JIT_COMPILER_HPP
+#define JIT_COMPILER_HPP
+#include <map>
+#include <optional>
+#include <string_view>
+
+#include "assembler.hpp"
+#include "native_code.hpp"
+#include "../parser/stmt.hpp"
+
+// Compiles a function to native code for the types of its parameters. Only functions computing with ints, doubles and
+// bools in their own parameters and locals are supported. They can't call anything nor touch other variables or
+// objects, so bailing out of them, on a division by zero or a function ending without a return, just means running
+// the call again in the interpreter.
+//
+// Every variable keeps the type of its initializer. Locals live in the native frame, expressions leave their result
+// in eax or xmm0 and keep the operands waiting for it on the native stack.
+class JitCompiler final : public ExprVisitor<NativeType>, public StmtVisitor<void> {
+    // Thrown on anything native code isn't emitted for
+    struct Unsupported {
+    };
+
+    struct Variable {
+        int slot;
+        NativeType type;
+    };
+
+    struct Loop {
+        Label *breakLabel;
+        Label *continueLabel;
+    };
+
+    Assembler _asm;
+    // Variables of the function by name, the innermost scope last
+    std::vector<std::map<std::string_view, Variable> > _scopes;
+    std::vector<Loop> _loops;
+    // Returns from the native code without a result, so that the call is interpreted instead
+    Label _bailout;
+    int _slotCount = 0;
+    std::optional<NativeType> _returnType;
+
+    JitCompiler() = default;
+
+    NativeType emit(Expr *expr);
+
+    void emit(Stmt *stmt);
+
+    void emitBody(Stmt *stmt);
+
+    Variable declare(const Token *name, NativeType type);
+
+    const Variable &lookup(const Token *name) const;
+
+    void load(const Variable &variable);
+
+    void store(const Variable &variable);
+
+    // Pushes the result of the last expression as raw bits
+    void push(NativeType type);
+
+    void jumpIfFalsy(NativeType type, Label &label);
+
+    void jumpIfTruthy(NativeType type, Label &label);
+
+    NativeType step(Expr *target, const Token *op, bool isPrefix);
+
+    void loop(Expr *condition, Stmt *body, Expr *increment);
+
+    static bool isNumber(NativeType type);
+
+    static int offsetOf(const Variable &variable);
+
+protected:
+    void visitExprStmt(ExprStmt *stmt) override;
+
+    void visitVarStmt(VarStmt *stmt) override;
+
+    void visitBlockStmt(BlockStmt *stmt) override;
+
+    void visitIfStmt(IfStmt *stmt) override;
+
+    void visitWhileStmt(WhileStmt *stmt) override;
+
+    void visitFunctionStmt(FunctionStmt *stmt) override;
+
+    void visitReturnStmt(ReturnStmt *stmt) override;
+
+    void visitBreakStmt(BreakStmt *stmt) override;
+
+    void visitContinueStmt(ContinueStmt *stmt) override;
+
+    void visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
+    NativeType visitBinaryExpr(BinaryExpr *expr) override;
+
+    NativeType visitGroupingExpr(GroupingExpr *expr) override;
+
+    NativeType visitLiteralExpr(LiteralExpr *expr) override;
+
+    NativeType visitUnaryExpr(UnaryExpr *expr) override;
+
+    NativeType visitTernaryExpr(TernaryExpr *expr) override;
+
+    NativeType visitVariableExpr(VariableExpr *expr) override;
+
+    NativeType visitAssignExpr(AssignExpr *expr) override;
+
+    NativeType visitLogicalExpr(LogicalExpr *expr) override;
+
+    NativeType visitCallExpr(CallExpr *expr) override;
+
+    NativeType visitArrayExpr(ArrayExpr *expr) override;
+
+    NativeType visitIndexedCallExpr(IndexedCallExpr *expr) override;
+
+    NativeType visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+
+    NativeType visitMapExpr(MapExpr *expr) override;
+
+    NativeType visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+
+    NativeType visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+
+    NativeType visitStringLiteralExpr(StringLiteralExpr *expr) override;
+
+    NativeType visitInvariantExpr(InvariantExpr *expr) override;
+
+public:
+    // Returns nullptr if the function can't be compiled
+    static std::unique_ptr<NativeCode> compile(const FunctionStmt *fun, const std::vector<NativeType> &paramTypes);
+};
+
+#endif //JIT_COMPILER_HPP
@@ -0,0 +1,101 @@
+#include "native_code.hpp"
+
+#if JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+NativeCode::NativeCode(void *memory, const ulong size, std::vector<NativeType> paramTypes,
+                       const NativeType returnType): _memory(memory), _size(size),
+                                                     _paramTypes(std::move(paramTypes)), _returnType(returnType) {
+}
+
+std::unique_ptr<NativeCode> NativeCode::make(const std::vector<uint8_t> &code, std::vector<NativeType> paramTypes,
+                                             const NativeType returnType) {
+#if JIT_SUPPORTED
+    const auto pageSize = static_cast<ulong>(sysconf(_SC_PAGESIZE));
+    const auto size = (code.size() + pageSize - 1) / pageSize * pageSize;
+    const auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(memory, code.data(), code.size());
+    // Never writable and executable at once
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return std::unique_ptr<NativeCode>(new NativeCode(memory, size, std::move(paramTypes), returnType));
+#else
+    return nullptr;
+#endif
+}
+
+std::optional<NativeType> NativeCode::typeOf(const Value &value) {
+    if (value.isInt()) {
+        return NativeType::INT;
+    }
+    if (value.isDouble()) {
+        return NativeType::DOUBLE;
+    }
+    if (value.isBool()) {
+        return NativeType::BOOL;
+    }
+    return std::nullopt;
+}
+
+NativeCode::~NativeCode() {
+#if JIT_SUPPORTED
+    munmap(_memory, _size);
+#endif
+}
+
+bool NativeCode::run(const std::span<const Value> args, Value &result) const {
+    if (args.size() != _paramTypes.size()) {
+        return false;
+    }
+    uint64_t rawArgs[MAX_PARAMS];
+    for (ulong i = 0; i < args.size(); ++i) {
+        switch (_paramTypes[i]) {
+            case NativeType::INT: {
+                if (!args[i].isInt()) {
+                    return false;
+                }
+                rawArgs[i] = static_cast<uint32_t>(args[i].asInt());
+                break;
+            }
+            case NativeType::DOUBLE: {
+                if (!args[i].isDouble()) {
+                    return false;
+                }
+                const double value = args[i].asDouble();
+                std::memcpy(&rawArgs[i], &value, sizeof(value));
+                break;
+            }
+            case NativeType::BOOL: {
+                if (!args[i].isBool()) {
+                    return false;
+                }
+                rawArgs[i] = args[i].asBool();
+                break;
+            }
+        }
+    }
+    uint64_t rawResult;
+    if (reinterpret_cast<Entry>(_memory)(rawArgs, &rawResult) != 0) {
+        return false;
+    }
+    switch (_returnType) {
+        case NativeType::INT: result = Value::ofInt(static_cast<int>(rawResult));
+            break;
+        case NativeType::DOUBLE: {
+            double value;
+            std::memcpy(&value, &rawResult, sizeof(value));
+            result = Value::ofDouble(value);
+            break;
+        }
+        case NativeType::BOOL: result = Value::ofBool(static_cast<uint32_t>(rawResult) != 0);
+            break;
+    }
+    return true;
+}
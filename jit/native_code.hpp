@@ -0,0 +1,57 @@
+#ifndef NATIVE_CODE_HPP
+#define NATIVE_CODE_HPP
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "../lexical/value.hpp"
+
+// Native code is only emitted for x86-64 with the System V calling convention, elsewhere everything is interpreted
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+// Types of the values native code works with. Ints and bools are held in 32-bit registers, doubles in SSE ones.
+enum class NativeType : uint8_t {
+    INT, DOUBLE, BOOL
+};
+
+// Machine code of a function compiled for the types of its parameters, in executable memory of its own
+class NativeCode final {
+public:
+    static constexpr ulong MAX_PARAMS = 16;
+
+    // Takes the raw parameters and where to put the raw result, returns non-zero when the code bailed out
+    using Entry = int (*)(const uint64_t *args, uint64_t *result);
+
+private:
+    void *_memory;
+    ulong _size;
+    std::vector<NativeType> _paramTypes;
+    NativeType _returnType;
+
+    NativeCode(void *memory, ulong size, std::vector<NativeType> paramTypes, NativeType returnType);
+
+public:
+    // Returns nullptr if no executable memory could be mapped
+    static std::unique_ptr<NativeCode> make(const std::vector<uint8_t> &code, std::vector<NativeType> paramTypes,
+                                            NativeType returnType);
+
+    static std::optional<NativeType> typeOf(const Value &value);
+
+    NativeCode(const NativeCode &) = delete;
+
+    NativeCode &operator=(const NativeCode &) = delete;
+
+    ~NativeCode();
+
+    // Runs the code if the arguments have the types it was compiled for. Returns false when a guard fails, the call
+    // then has to be interpreted from the start instead.
+    bool run(std::span<const Value> args, Value &result) const;
+};
+
+#endif //NATIVE_CODE_HPP
@@ -8,7 +8,7 @@
 #include "token_type.hpp"
 #include "../utils/utils.hpp"
 
-Lexer::Lexer(std::string *codes): codes(codes) {
+Lexer::Lexer(std::string *codes, Arena *arena): codes(codes), arena(arena) {
     codeLength = codes->size();
 }
 
@@ -17,14 +17,11 @@ void Lexer::tokenize() {
         start = current;
         scanToken();
     }
-    tokens.push_back(new Token(FILE_EOF, "", line));
+    tokens.push_back(arena->make<Token>(FILE_EOF, codes->data(), current, 0, line));
 }
 
 Lexer::~Lexer() {
     delete codes;
-    for (const auto &token: tokens) {
-        delete token;
-    }
 }
 
 bool Lexer::isAtEnd() const {
@@ -124,8 +121,7 @@ char Lexer::advance() {
 }
 
 void Lexer::addToken(std::vector<Token *> &tokens, const TokenType type, const uint start, const uint len) const {
-    const auto code = codes->substr(start, len);
-    tokens.push_back(new Token(type, code, line));
+    tokens.push_back(arena->make<Token>(type, codes->data(), start, len, line));
 }
 
 void Lexer::addToken(std::vector<Token *> &tokens, const TokenType type) const {
@@ -138,8 +134,7 @@ void Lexer::addToken(const TokenType type) {
 
 void Lexer::processIdentifier(std::vector<Token *> &tokens) {
     while (isLegalIdentifierChar(peek())) advance();
-    const auto lexeme = codes->substr(start, current - start);
-    const auto type = SoxKeywords::instance()->getKeyword(lexeme);
+    const auto type = SoxKeywords::instance()->getKeyword(std::string_view(*codes).substr(start, current - start));
     addToken(tokens, type);
 }
 
@@ -171,7 +166,6 @@ void Lexer::processNumberLiteral(const char c, std::vector<Token *> &tokens) {
         } else if (isLegalOctalNumber(peek())) {
             while (isLegalOctalNumber(peek())) advance();
         }
-        const auto lexeme = codes->substr(start, current - start);
         addToken(tokens, INT);
     }
 }
@@ -265,9 +259,9 @@ void Lexer::processStringLiteral() {
     advance();
     // We don't need '"' in string, so minus 1
     addToken(stringTokens, STRING, start, current - start - 1);
-    stringTokens.push_back(new Token(FILE_EOF, "", line));
-    auto *token = new StringToken(codes->substr(originalStart + 1, current - originalStart - 2), line,
-                                  stringTokens);
+    stringTokens.push_back(arena->make<Token>(FILE_EOF, codes->data(), current, 0, line));
+    auto *token = arena->make<StringToken>(codes->data(), originalStart + 1, current - originalStart - 2, line,
+                                           stringTokens);
     tokens.push_back(token);
 }
 
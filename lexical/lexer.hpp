@@ -7,6 +7,7 @@
 
 #include <vector>
 #include "token.hpp"
+#include "../utils/arena.hpp"
 
 class Lexer {
     unsigned int start = 0;
@@ -14,6 +15,8 @@ class Lexer {
     unsigned int line = 1;
     unsigned int codeLength = 0;
     std::string *codes;
+    // Owns the tokens
+    Arena *arena;
 
     std::vector<Token *> tokens;
 
@@ -47,7 +50,7 @@ protected:
     const char CHAR_EOF = 0;
 
 public:
-    explicit Lexer(std::string *);
+    Lexer(std::string *codes, Arena *arena);
 
     void tokenize();
 
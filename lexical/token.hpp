@@ -7,16 +7,21 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
 #include "token_type.hpp"
 
+// Refers to its lexeme in the source buffer instead of owning a copy, so the source has to outlive the token
 class Token {
-    TokenType _type;
-    std::string _lexeme;
+    const char *_source;
+    uint _offset;
+    uint _length;
     uint _line;
+    TokenType _type;
 
 public:
-    Token(const TokenType type, std::string lexeme, const uint line): _type(type),
-                                                                      _lexeme(std::move(lexeme)), _line(line) {
+    Token(const TokenType type, const char *source, const uint offset, const uint length, const uint line):
+        _source(source), _offset(offset), _length(length), _line(line), _type(type) {
     }
 
     virtual ~Token() = default;
@@ -25,8 +30,8 @@ public:
         return _type;
     }
 
-    [[nodiscard]] const std::string &lexeme() const {
-        return _lexeme;
+    [[nodiscard]] std::string_view lexeme() const {
+        return {_source + _offset, _length};
     }
 
     [[nodiscard]] uint line() const {
@@ -37,7 +42,8 @@ public:
         if (_type == FILE_EOF) {
             return "Token(EOF)";
         }
-        return std::string("Token(") + std::to_string(_type) + "," + _lexeme + ", " + std::to_string(_line) + ")";
+        return std::string("Token(") + std::to_string(_type) + "," + std::string(lexeme()) + ", " +
+               std::to_string(_line) + ")";
     }
 };
 
@@ -45,14 +51,8 @@ class StringToken final : public Token {
 public:
     std::vector<Token *> tokens;
 
-    StringToken(const std::string &lexeme, const uint line,
-                std::vector<Token *> tokens): Token(STRING, lexeme, line), tokens(std::move(tokens)) {
-    }
-
-    ~StringToken() override {
-        for (const auto token : tokens) {
-            delete token;
-        }
+    StringToken(const char *source, const uint offset, const uint length, const uint line,
+                std::vector<Token *> tokens): Token(STRING, source, offset, length, line), tokens(std::move(tokens)) {
     }
 };
 
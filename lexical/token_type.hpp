@@ -16,7 +16,7 @@ enum TokenType {
 
     IDENTIFIER, STRING, INT, DOUBLE,
 
-    AND, CLASS, ELSE, FALSE, FUN, FOR, IF, NULL_PTR, OR,
+    AND, BREAK, CLASS, CONTINUE, ELSE, FALSE, FUN, FOR, IF, NULL_PTR, OR,
     PRINT, RETURN, SUPER, THIS, TRUE, VAR, VARARGS, VERTICAL_BAR, WHILE,
 
     QUESTION_MARK, COLON,
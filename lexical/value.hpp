@@ -0,0 +1,278 @@
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/types.h>
+
+#include "../utils/collector.hpp"
+#include "../utils/pool.hpp"
+
+enum class ObjectType {
+    STRING, ARRAY, MAP, CALLABLE
+};
+
+// Base of every heap allocated runtime object. Objects are reference counted by the Values pointing at them, the
+// interpreter is single threaded so the count is a plain integer. Strings can't reference anything, all other objects
+// are tracked by the Collector.
+class ValueHolder : public Traceable {
+    friend class Value;
+
+    uint _refCount = 0;
+
+public:
+    const ObjectType type;
+
+    explicit ValueHolder(const ObjectType type): type(type) {
+        if (type != ObjectType::STRING) {
+            track();
+        }
+    }
+
+    ~ValueHolder() override = default;
+
+    // Every object comes from the Pool, the virtual destructor hands the size of the actual type back to it
+    static void *operator new(const size_t size) {
+        return Pool::instance()->allocate(size);
+    }
+
+    static void operator delete(void *pointer, const size_t size) {
+        Pool::instance()->deallocate(pointer, size);
+    }
+
+    [[nodiscard]] long refCount() const override {
+        return _refCount;
+    }
+
+    std::shared_ptr<void> pin() override;
+
+    virtual std::string toString() {
+        return "null";
+    }
+
+    virtual bool equals(const ValueHolder *other) {
+        return this == other;
+    }
+
+    virtual ulong hash() {
+        return reinterpret_cast<ulong>(static_cast<void *>(this));
+    }
+};
+
+// A NaN-boxed 64 bit value. Doubles are stored as themselves, everything else lives in the payload of a quiet NaN:
+// null and booleans as small tags, integers in the low 32 bits and objects as a pointer with the sign bit set. Strings
+// also set the bit tagging integers, so that they can be told apart without loading the object.
+class Value {
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t TAG_INT = 0x0001000000000000;
+    static constexpr uint64_t TAG_NULL = 1;
+    static constexpr uint64_t TAG_FALSE = 2;
+    static constexpr uint64_t TAG_TRUE = 3;
+    static constexpr uint64_t OBJECT_MASK = SIGN_BIT | QNAN;
+    static constexpr uint64_t TAG_STRING = TAG_INT;
+    static constexpr uint64_t POINTER_MASK = TAG_STRING - 1;
+
+    uint64_t _bits;
+
+    explicit Value(const uint64_t bits, int): _bits(bits) {
+    }
+
+    void retain() const {
+        if (isObject()) {
+            ++asObject()->_refCount;
+        }
+    }
+
+    void release() const {
+        if (isObject()) {
+            if (const auto object = asObject(); --object->_refCount == 0) {
+                delete object;
+            }
+        }
+    }
+
+public:
+    Value(): _bits(QNAN | TAG_NULL) {
+    }
+
+    Value(const Value &other): _bits(other._bits) {
+        retain();
+    }
+
+    Value(Value &&other) noexcept: _bits(other._bits) {
+        other._bits = QNAN | TAG_NULL;
+    }
+
+    Value &operator=(const Value &other) {
+        // other may be an element of the object released here
+        const auto bits = other._bits;
+        other.retain();
+        release();
+        _bits = bits;
+        return *this;
+    }
+
+    Value &operator=(Value &&other) noexcept {
+        if (this != &other) {
+            const auto bits = other._bits;
+            other._bits = QNAN | TAG_NULL;
+            release();
+            _bits = bits;
+        }
+        return *this;
+    }
+
+    ~Value() {
+        release();
+    }
+
+    static Value ofBool(const bool value) {
+        return Value(QNAN | (value ? TAG_TRUE : TAG_FALSE), 0);
+    }
+
+    static Value ofInt(const int value) {
+        return Value(QNAN | TAG_INT | static_cast<uint32_t>(value), 0);
+    }
+
+    static Value ofDouble(const double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return Value(bits, 0);
+    }
+
+    // Takes shared ownership of a freshly allocated object
+    static Value ofObject(ValueHolder *object) {
+        const auto tag = object->type == ObjectType::STRING ? TAG_STRING : 0;
+        Value value(OBJECT_MASK | tag | reinterpret_cast<uint64_t>(object), 0);
+        value.retain();
+        return value;
+    }
+
+    [[nodiscard]] bool isNull() const {
+        return _bits == (QNAN | TAG_NULL);
+    }
+
+    [[nodiscard]] bool isBool() const {
+        return (_bits | 1) == (QNAN | TAG_TRUE);
+    }
+
+    [[nodiscard]] bool isInt() const {
+        return (_bits & (OBJECT_MASK | TAG_INT)) == (QNAN | TAG_INT);
+    }
+
+    [[nodiscard]] bool isDouble() const {
+        return (_bits & QNAN) != QNAN;
+    }
+
+    [[nodiscard]] bool isNumber() const {
+        return isInt() || isDouble();
+    }
+
+    [[nodiscard]] bool isObject() const {
+        return (_bits & OBJECT_MASK) == OBJECT_MASK;
+    }
+
+    [[nodiscard]] bool isObject(const ObjectType type) const {
+        return isObject() && asObject()->type == type;
+    }
+
+    [[nodiscard]] bool isString() const {
+        return (_bits & (OBJECT_MASK | TAG_STRING)) == (OBJECT_MASK | TAG_STRING);
+    }
+
+    // Whether this is the only reference to its object
+    [[nodiscard]] bool isUnique() const {
+        return isObject() && asObject()->_refCount == 1;
+    }
+
+    [[nodiscard]] bool asBool() const {
+        return _bits == (QNAN | TAG_TRUE);
+    }
+
+    [[nodiscard]] int asInt() const {
+        return static_cast<int>(static_cast<uint32_t>(_bits));
+    }
+
+    [[nodiscard]] double asDouble() const {
+        double value;
+        std::memcpy(&value, &_bits, sizeof(value));
+        return value;
+    }
+
+    // Widens integers, only valid if isNumber()
+    [[nodiscard]] double asNumber() const {
+        return isInt() ? asInt() : asDouble();
+    }
+
+    [[nodiscard]] ValueHolder *asObject() const {
+        return reinterpret_cast<ValueHolder *>(_bits & POINTER_MASK);
+    }
+
+    template<class T>
+    [[nodiscard]] T *as() const {
+        return static_cast<T *>(asObject());
+    }
+
+    [[nodiscard]] bool isTruthy() const {
+        if (isBool()) return asBool();
+        if (isInt()) return asInt() != 0;
+        return !isNull();
+    }
+
+    [[nodiscard]] std::string toString() const {
+        if (isInt()) return std::to_string(asInt());
+        if (isDouble()) return std::to_string(asDouble());
+        if (isBool()) return asBool() ? "true" : "false";
+        if (isObject()) return asObject()->toString();
+        return "null";
+    }
+
+    [[nodiscard]] bool equals(const Value &other) const {
+        if (isObject() && other.isObject()) {
+            return asObject()->equals(other.asObject());
+        }
+        if (isDouble() && other.isDouble()) {
+            return asDouble() == other.asDouble();
+        }
+        return _bits == other._bits;
+    }
+
+    [[nodiscard]] ulong hash() const {
+        if (isInt()) return asInt();
+        if (isBool()) return asBool() ? 1231 : 1237;
+        if (isObject()) return asObject()->hash();
+        return _bits ^ (_bits >> 32);
+    }
+
+    // Identity comparison
+    bool operator==(const Value &other) const {
+        return _bits == other._bits;
+    }
+
+    // Reports the object to the Collector, strings aren't tracked
+    void trace(const Tracer visit) const {
+        if ((_bits & (OBJECT_MASK | TAG_STRING)) == OBJECT_MASK) {
+            visit(asObject());
+        }
+    }
+};
+
+inline std::shared_ptr<void> ValueHolder::pin() {
+    return std::make_shared<Value>(Value::ofObject(this));
+}
+
+struct ValueHash {
+    size_t operator()(const Value &value) const {
+        return value.hash();
+    }
+};
+
+struct ValueEquals {
+    bool operator()(const Value &lhs, const Value &rhs) const {
+        return lhs.equals(rhs);
+    }
+};
+
+#endif //VALUE_HPP
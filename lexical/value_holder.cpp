@@ -0,0 +1,13 @@
+#include "value_holder.hpp"
+
+#include "../interpret/callable.hpp"
+
+void CallableHolder::traverse(const Tracer visit) {
+    for (const auto &callable: callables) {
+        visit(callable.get());
+    }
+}
+
+void CallableHolder::clearReferences() {
+    callables.clear();
+}
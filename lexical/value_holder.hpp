@@ -5,43 +5,29 @@
 #ifndef VALUE_HOLDER_HPP
 #define VALUE_HOLDER_HPP
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
 
-class ValueHolder {
-public:
-    virtual ~ValueHolder() = default;
-
-    virtual std::string toString() {
-        return "null";
-    }
-
-    virtual bool equals(const ValueHolder *other) {
-        return this == other;
-    }
-
-    virtual ulong hash() {
-        return reinterpret_cast<ulong>(static_cast<void *>(this));
-    }
-};
+#include "value.hpp"
 
 class StringValueHolder final : public ValueHolder {
     ulong _hash = 0;
 
 public:
-    explicit StringValueHolder(std::string &value) : value(std::move(value)) {
+    explicit StringValueHolder(std::string value) : ValueHolder(ObjectType::STRING), value(std::move(value)) {
     }
 
-    std::string value;
+    const std::string value;
 
     std::string toString() override {
         return value;
     }
 
     bool equals(const ValueHolder *other) override {
-        if (const auto otherValue = dynamic_cast<const StringValueHolder *>(other)) {
-            return value == otherValue->value;
+        if (other->type == ObjectType::STRING) {
+            return value == static_cast<const StringValueHolder *>(other)->value;
         }
         return false;
     }
@@ -58,107 +44,29 @@ public:
     }
 };
 
-class IntegerValueHolder final : public ValueHolder {
-public:
-    explicit IntegerValueHolder(const int value) : value(value) {
-    }
-
-    int value;
-
-    void invert() {
-        value = -value;
-    }
-
-    std::string toString() override {
-        return std::to_string(value);
-    }
-
-    bool equals(const ValueHolder *other) override {
-        if (const auto otherValue = dynamic_cast<const IntegerValueHolder *>(other)) {
-            return value == otherValue->value;
-        }
-        return false;
-    }
-
-    ulong hash() override {
-        return value;
-    }
-};
-
-typedef union {
-    uint64_t bits;
-    double d;
-} Double;
-
-class DoubleValueHolder final : public ValueHolder {
-    Double _d{};
-
-public:
-    explicit DoubleValueHolder(const double value) : value(value) {
-    }
-
-    double value;
-
-    void invert() {
-        value = -value;
-    }
-
-    std::string toString() override {
-        return std::to_string(value);
-    }
-
-    bool equals(const ValueHolder *other) override {
-        if (const auto otherValue = dynamic_cast<const DoubleValueHolder *>(other)) {
-            return value == otherValue->value;
-        }
-        return false;
-    }
-
-    ulong hash() override {
-        _d.d = value;
-        return _d.bits ^ (_d.bits >> 32);
-    }
-};
-
-class BoolValueHolder final : public ValueHolder {
-public:
-    explicit BoolValueHolder(const bool value): value(value) {
-    }
-
-    bool value;
-
-    void invert() {
-        value = -value;
-    }
-
-    std::string toString() override {
-        return value ? "true" : "false";
-    }
-
-    bool equals(const ValueHolder *other) override {
-        if (const auto otherValue = dynamic_cast<const BoolValueHolder *>(other)) {
-            return value == otherValue->value;
-        }
-        return false;
-    }
-
-    ulong hash() override {
-        return value ? 1231 : 1237;
-    }
-};
+inline Value makeString(std::string value) {
+    return Value::ofObject(new StringValueHolder(std::move(value)));
+}
 
 class Callable;
 
 class CallableHolder final : public ValueHolder {
 public:
     std::vector<std::shared_ptr<Callable> > callables;
+    // Bumped whenever the overloads change, so that cached overload lookups can tell they are stale
+    uint version = 0;
 
-    explicit CallableHolder(const std::shared_ptr<Callable> &callable) {
+    explicit CallableHolder(const std::shared_ptr<Callable> &callable): ValueHolder(ObjectType::CALLABLE) {
         callables.push_back(callable);
     }
 
+    void traverse(Tracer visit) override;
+
+    void clearReferences() override;
+
     bool equals(const ValueHolder *other) override {
-        if (const auto otherValue = dynamic_cast<const CallableHolder *>(other)) {
+        if (other->type == ObjectType::CALLABLE) {
+            const auto otherValue = static_cast<const CallableHolder *>(other);
             if (otherValue->callables.size() != callables.size()) {
                 return false;
             }
@@ -175,19 +83,29 @@ public:
 
 class ArrayValueHolder final : public ValueHolder {
 public:
-    std::vector<std::shared_ptr<ValueHolder> > values;
+    std::vector<Value> values;
 
-    ArrayValueHolder() = default;
+    ArrayValueHolder(): ValueHolder(ObjectType::ARRAY) {
+    }
+
+    void traverse(const Tracer visit) override {
+        for (const auto &value: values) {
+            value.trace(visit);
+        }
+    }
+
+    void clearReferences() override {
+        values.clear();
+    }
 
     bool equals(const ValueHolder *other) override {
-        if (const auto otherValue = dynamic_cast<const ArrayValueHolder *>(other)) {
+        if (other->type == ObjectType::ARRAY) {
+            const auto otherValue = static_cast<const ArrayValueHolder *>(other);
             if (values.size() != otherValue->values.size()) {
                 return false;
             }
             for (auto i = 0; i < values.size(); ++i) {
-                const auto holder = values[i];
-                const auto otherHolder = otherValue->values[i];
-                if (!(holder->equals(otherHolder.get()))) {
+                if (!values[i].equals(otherValue->values[i])) {
                     return false;
                 }
             }
@@ -197,38 +115,38 @@ public:
     }
 };
 
-struct HolderHash {
-    size_t operator()(const std::shared_ptr<ValueHolder> &value) const {
-        return value->hash();
-    }
-};
-
-struct HolderEquals {
-    bool operator()(const std::shared_ptr<ValueHolder> &lhs, const std::shared_ptr<ValueHolder> &rhs) const {
-        return lhs->equals(rhs.get());
-    }
-};
-
-typedef std::unordered_map<std::shared_ptr<ValueHolder>, std::shared_ptr<ValueHolder>, HolderHash, HolderEquals> HolderMap;
+typedef std::unordered_map<Value, Value, ValueHash, ValueEquals> ValueMap;
 
 class MapValueHolder final : public ValueHolder {
 public:
-    HolderMap values;
+    ValueMap values;
+
+    MapValueHolder(): ValueHolder(ObjectType::MAP) {
+    }
 
-    MapValueHolder() = default;
+    void traverse(const Tracer visit) override {
+        for (const auto &[key, value]: values) {
+            key.trace(visit);
+            value.trace(visit);
+        }
+    }
+
+    void clearReferences() override {
+        values.clear();
+    }
 
     bool equals(const ValueHolder *other) override {
-        if (const auto otherHolder = dynamic_cast<const MapValueHolder *>(other)) {
-            const auto thisValues = values;
-            const auto otherValues = otherHolder->values;
-            if (thisValues.size() != otherValues.size()) {
+        if (other->type == ObjectType::MAP) {
+            const auto &otherValues = static_cast<const MapValueHolder *>(other)->values;
+            if (values.size() != otherValues.size()) {
                 return false;
             }
-            for (const auto &[key, value]: thisValues) {
-                if (otherValues.contains(key)) {
+            for (const auto &[key, value]: values) {
+                const auto it = otherValues.find(key);
+                if (it == otherValues.end()) {
                     return false;
                 }
-                if (const auto &otherValue = otherValues.at(key); !otherValue->equals(value.get())) {
+                if (!it->second.equals(value)) {
                     return false;
                 }
             }
@@ -1,22 +1,83 @@
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+#include "aot/c_emitter.hpp"
+#include "interpret/escape_analyzer.hpp"
 #include "interpret/interpreter.hpp"
+#include "interpret/optimizer.hpp"
 #include "interpret/resolver.hpp"
 #include "parser/parser.hpp"
+#include "utils/collector.hpp"
+#include "utils/logger.hpp"
+#include "utils/pool.hpp"
 #include "lexical/lexer.hpp"
+#include "vm/compiler.hpp"
+#include "vm/virtual_machine.hpp"
+
+enum Engine {
+    AST, VM
+};
+
+static Engine engine = AST;
+static bool optimize = true;
+static bool jit = true;
+static int inlineBudget = Inliner::DEFAULT_BUDGET;
+// Translates the script to C instead of running it when set
+static const char *emitC = nullptr;
+static bool gcStats = false;
+static bool poolStats = false;
+// Leaves the runtime heap of a run to the exit of the process instead of releasing it object by object. Only for
+// scripts, the process ends right after running them.
+static bool regionHeap = false;
 
 int runFile(const std::string& fileName);
 int runPrompt();
 int runCodes(std::string *codes);
+void printStats();
+[[noreturn]] void exitKeepingHeap();
 
 int main(const int argc, const char *argv[]) {
-    if (argc > 2) {
-        std::cout << "Usage: soxsh [script].";
+    const char *script = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (const std::string arg = argv[i]; arg == "--engine=ast") {
+            engine = AST;
+        } else if (arg == "--engine=vm") {
+            engine = VM;
+        } else if (arg == "--no-opt") {
+            optimize = false;
+        } else if (arg == "--no-jit") {
+            jit = false;
+        } else if (arg.starts_with("--inline-budget=")) {
+            inlineBudget = std::atoi(arg.c_str() + std::strlen("--inline-budget="));
+        } else if (arg == "--gc-stats") {
+            gcStats = true;
+        } else if (arg == "--pool-stats") {
+            poolStats = true;
+        } else if (arg == "--heap=pool") {
+            regionHeap = false;
+        } else if (arg == "--heap=region") {
+            regionHeap = true;
+        } else if (arg == "--emit-c" && i + 1 < argc) {
+            emitC = argv[++i];
+        } else if (script == nullptr && !arg.starts_with("--")) {
+            script = argv[i];
+        } else {
+            std::cout << "Usage: soxsh [--engine=ast|vm] [--no-opt] [--no-jit] [--inline-budget=n] [--gc-stats] [--pool-stats] [--heap=pool|region] [--emit-c out.c] [script].";
+            return 0;
+        }
+    }
+    if (emitC != nullptr && script == nullptr) {
+        std::cout << "Usage: soxsh --emit-c out.c script.";
         return 0;
     }
-    if (argc == 2) {
-        return runFile(std::string(argv[1]));
+    if (regionHeap && script == nullptr) {
+        std::cout << "Usage: soxsh --heap=region script.";
+        return 0;
+    }
+    if (script != nullptr) {
+        return runFile(std::string(script));
     }
     return runPrompt();
 }
@@ -36,16 +97,70 @@ int runPrompt() {
 }
 
 int runCodes(std::string *codes) {
-    Lexer l(codes);
+    // Owns the tokens and the syntax tree, so it has to outlive everything running them
+    Arena arena;
+    Lexer l(codes, &arena);
     l.tokenize();
-    Parser p(l.getTokens());
+    Parser p(l.getTokens(), &arena);
     const auto stmts = p.parse();
-    Interpreter interpreter;
-    Resolver resolver(&interpreter);
+    // Every engine gets the same static errors. They are only logged, the interpreters run the script anyway.
+    if (optimize) {
+        // Reported on the script as written, since the optimizer may prune the code containing them
+        Resolver diagnostics;
+        diagnostics.resolve(stmts);
+        // Runs before the final resolving, since it may remove statements and reshape blocks
+        Optimizer optimizer(&arena, inlineBudget);
+        optimizer.optimize(stmts);
+    }
+    Resolver resolver(!optimize);
     resolver.resolve(stmts);
-    interpreter.interpret(stmts);
-    for (const auto stmt : *stmts) {
-        delete stmt;
+    if (emitC != nullptr) {
+        if (Logger::instance()->hasError()) {
+            return 1;
+        }
+        std::ofstream out(emitC);
+        out << CEmitter::emit(stmts);
+        return out ? 0 : 1;
+    }
+    if (engine == VM) {
+        Compiler compiler;
+        if (const auto script = compiler.compile(stmts)) {
+            VirtualMachine vm;
+            vm.interpret(script);
+            if (regionHeap) {
+                exitKeepingHeap();
+            }
+        }
+    } else {
+        Interpreter interpreter(jit);
+        // Only the tree-walking engine keeps containers in scope regions
+        if (optimize) {
+            EscapeAnalyzer escapeAnalyzer;
+            escapeAnalyzer.analyze(stmts);
+        }
+        interpreter.interpret(stmts);
+        if (regionHeap) {
+            exitKeepingHeap();
+        }
     }
+    printStats();
     return 0;
 }
+
+void printStats() {
+    if (gcStats) {
+        Collector::instance()->printStats();
+    }
+    if (poolStats) {
+        Pool::instance()->printStats();
+    }
+}
+
+// Ends the process while the engine still references its globals, scopes and containers. Their memory goes back to
+// the system in one piece, which skips the cascade of releases that big or deeply nested data would take.
+void exitKeepingHeap() {
+    printStats();
+    std::cout.flush();
+    std::cerr.flush();
+    std::_Exit(0);
+}
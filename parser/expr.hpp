@@ -4,22 +4,47 @@
 
 #ifndef EXPR_HPP
 #define EXPR_HPP
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 
 #include "../lexical/token.hpp"
+#include "../lexical/value.hpp"
 
 template<class R>
 class ExprVisitor;
 
+class Callable;
+
+// Set by every node on construction, so that visitors can dispatch without RTTI
+enum class ExprKind {
+    BINARY, GROUPING, UNARY, LITERAL, STRING_LITERAL, TERNARY, VARIABLE, ASSIGN, LOGICAL, CALL,
+    INDEXED_CALL, ARRAY, INDEXED_ELE_ASSIGN, MAP, PREFIX_AUTO_UNARY, SUFFIX_AUTO_UNARY, INVARIANT
+};
+
+// Nodes are allocated in the Arena of their compilation and never deleted one by one
 class Expr {
 public:
+    const ExprKind kind;
+
+    explicit Expr(const ExprKind kind): kind(kind) {
+    }
+
     template<class R>
     R accept(ExprVisitor<R> *visitor) {
         return visitor->visitExpr(this);
     }
+};
 
-    virtual ~Expr() = default;
+// Operation a BinaryExpr has specialized itself to for the operand types it has seen. A specialized node checks that
+// its operands still have those types and deoptimizes to GENERIC for good once they don't.
+enum class BinarySpecialization : uint8_t {
+    UNINITIALIZED, GENERIC,
+    INT_ADD, INT_SUBTRACT, INT_MULTIPLY, INT_DIVIDE,
+    INT_GREATER, INT_GREATER_EQUAL, INT_LESS, INT_LESS_EQUAL, INT_EQUAL, INT_NOT_EQUAL,
+    DOUBLE_ADD, DOUBLE_SUBTRACT, DOUBLE_MULTIPLY, DOUBLE_DIVIDE,
+    DOUBLE_GREATER, DOUBLE_GREATER_EQUAL, DOUBLE_LESS, DOUBLE_LESS_EQUAL, DOUBLE_EQUAL, DOUBLE_NOT_EQUAL,
+    STRING_CONCAT
 };
 
 class BinaryExpr final : public Expr {
@@ -27,13 +52,10 @@ public:
     Expr *left;
     Expr *right;
     Token *op;
+    // Rewritten by the Interpreter as it runs
+    BinarySpecialization specialization = BinarySpecialization::UNINITIALIZED;
 
-    BinaryExpr(Expr *left, Token *op, Expr *right): left(left), right(right), op(op) {
-    }
-
-    ~BinaryExpr() override {
-        delete left;
-        delete right;
+    BinaryExpr(Expr *left, Token *op, Expr *right): Expr(ExprKind::BINARY), left(left), right(right), op(op) {
     }
 };
 
@@ -41,11 +63,7 @@ class GroupingExpr final : public Expr {
 public:
     Expr *expr;
 
-    explicit GroupingExpr(Expr *expr): expr(expr) {
-    }
-
-    ~GroupingExpr() override {
-        delete expr;
+    explicit GroupingExpr(Expr *expr): Expr(ExprKind::GROUPING), expr(expr) {
     }
 };
 
@@ -54,35 +72,26 @@ public:
     Expr *right;
     Token *op;
 
-    UnaryExpr(Expr *right, Token *op): right(right), op(op) {
-    }
-
-    ~UnaryExpr() override {
-        delete right;
+    UnaryExpr(Expr *right, Token *op): Expr(ExprKind::UNARY), right(right), op(op) {
     }
 };
 
 class LiteralExpr final : public Expr {
 public:
     const Token *value;
+    // Decoded once by the Parser, shared by every evaluation
+    const Value constant;
 
-    explicit LiteralExpr(const Token *value): value(value) {
+    LiteralExpr(const Token *value, Value constant): Expr(ExprKind::LITERAL), value(value),
+                                                     constant(std::move(constant)) {
     }
-
-    ~LiteralExpr() override = default;
 };
 
 class StringLiteralExpr final : public Expr {
 public:
-    const std::vector<Expr *> values;
-
-    explicit StringLiteralExpr(std::vector<Expr *> values): values(std::move(values)) {
-    }
+    std::vector<Expr *> *values;
 
-    ~StringLiteralExpr() override {
-        for (auto &v: values) {
-            delete v;
-        }
+    explicit StringLiteralExpr(std::vector<Expr *> *values): Expr(ExprKind::STRING_LITERAL), values(values) {
     }
 };
 
@@ -92,37 +101,31 @@ public:
     Expr *right;
     Expr *condition;
 
-    TernaryExpr(Expr *left, Expr *right, Expr *condition): left(left), right(right),
+    TernaryExpr(Expr *left, Expr *right, Expr *condition): Expr(ExprKind::TERNARY), left(left), right(right),
                                                            condition(condition) {
     }
-
-    ~TernaryExpr() override {
-        delete left;
-        delete right;
-        delete condition;
-    }
 };
 
 class VariableExpr final : public Expr {
 public:
     const Token *name;
+    // Resolved by the Resolver, depth -1 for globals. The slot of a global is filled in by the Interpreter on first use.
+    int depth = -1;
+    int slot = -1;
 
-    explicit VariableExpr(const Token *name): name(name) {
+    explicit VariableExpr(const Token *name): Expr(ExprKind::VARIABLE), name(name) {
     }
-
-    ~VariableExpr() override = default;
 };
 
 class AssignExpr final : public Expr {
 public:
     Expr *value;
     const Token *name;
+    // Same as VariableExpr
+    int depth = -1;
+    int slot = -1;
 
-    explicit AssignExpr(Expr *value, const Token *name): value(value), name(name) {
-    }
-
-    ~AssignExpr() override {
-        delete value;
+    explicit AssignExpr(Expr *value, const Token *name): Expr(ExprKind::ASSIGN), value(value), name(name) {
     }
 };
 
@@ -132,33 +135,45 @@ public:
     Expr *right;
     Token *op;
 
-    LogicalExpr(Expr *left, Expr *right, Token *op): left(left), right(right), op(op) {
+    LogicalExpr(Expr *left, Expr *right, Token *op): Expr(ExprKind::LOGICAL), left(left), right(right), op(op) {
     }
+};
 
-    ~LogicalExpr() override {
-        delete left;
-        delete right;
-    }
+// Overloads resolved for the last callees seen at a call site. The callee is kept alive by its entry, so neither its
+// address nor the cached callable can be reused while cached.
+struct CallSiteCache {
+    static constexpr int SIZE = 2;
+
+    struct Entry {
+        Value callee;
+        uint version = 0;
+        Callable *callable = nullptr;
+    };
+
+    Entry entries[SIZE];
+    // Entry to replace on the next miss
+    int next = 0;
+};
+
+// Builtin a call always reaches, recognized by the Resolver when nothing redefines the name of the builtin
+enum class Intrinsic : uint8_t {
+    NONE, PRINT, PRINTLN, LENGTH
 };
 
 class CallExpr final : public Expr {
 public:
     Expr *callee;
     const Token *paren;
-    const std::vector<Expr *> *arguments;
+    std::vector<Expr *> *arguments;
+    CallSiteCache cache;
+    // Computed in place with the single argument instead of being called
+    Intrinsic intrinsic = Intrinsic::NONE;
 
-    CallExpr(Expr *callee, const Token *paren, const std::vector<Expr *> *arguments): callee(callee),
+    CallExpr(Expr *callee, const Token *paren, std::vector<Expr *> *arguments): Expr(ExprKind::CALL),
+        callee(callee),
         paren(paren),
         arguments(arguments) {
     }
-
-    ~CallExpr() override {
-        delete callee;
-        for (auto &arg: *arguments) {
-            delete arg;
-        }
-        delete arguments;
-    }
 };
 
 class IndexedCallExpr final : public Expr {
@@ -167,13 +182,8 @@ public:
     const Token *bracket;
     Expr *index;
 
-    IndexedCallExpr(Expr *callee, const Token *bracket, Expr *index): callee(callee), bracket(bracket),
-                                                                      index(index) {
-    }
-
-    ~IndexedCallExpr() override {
-        delete callee;
-        delete index;
+    IndexedCallExpr(Expr *callee, const Token *bracket, Expr *index): Expr(ExprKind::INDEXED_CALL), callee(callee),
+                                                                      bracket(bracket), index(index) {
     }
 };
 
@@ -181,15 +191,11 @@ class ArrayExpr final : public Expr {
 public:
     Token *bracket;
     std::vector<Expr *> *elements;
+    // Index in the region of the scope evaluating it, assigned by the EscapeAnalyzer if the array never escapes it
+    int localIndex = -1;
 
-    ArrayExpr(Token *bracket, std::vector<Expr *> *elements): bracket(bracket), elements(elements) {
-    }
-
-    ~ArrayExpr() override {
-        for (const auto &element: *elements) {
-            delete element;
-        }
-        delete elements;
+    ArrayExpr(Token *bracket, std::vector<Expr *> *elements): Expr(ExprKind::ARRAY), bracket(bracket),
+                                                              elements(elements) {
     }
 };
 
@@ -200,13 +206,8 @@ public:
     Expr *value;
     const Token *bracket;
 
-    ArrayElementAssignExpr(Expr *callee, Expr *index, Expr *value, const Token *bracket): callee(callee), index(index),
-        value(value), bracket(bracket) {
-    }
-
-    ~ArrayElementAssignExpr() override {
-        delete callee;
-        delete index;
+    ArrayElementAssignExpr(Expr *callee, Expr *index, Expr *value, const Token *bracket):
+        Expr(ExprKind::INDEXED_ELE_ASSIGN), callee(callee), index(index), value(value), bracket(bracket) {
     }
 };
 
@@ -214,16 +215,11 @@ class MapExpr final : public Expr {
 public:
     Token *brace;
     std::vector<std::pair<Expr *, Expr *> > *elements;
+    // Index in the region of the scope evaluating it, assigned by the EscapeAnalyzer if the map never escapes it
+    int localIndex = -1;
 
-    MapExpr(Token *brace, std::vector<std::pair<Expr *, Expr *> > *elements): brace(brace), elements(elements) {
-    }
-
-    ~MapExpr() override {
-        for (const auto &element: *elements) {
-            delete element.first;
-            delete element.second;
-        }
-        delete elements;
+    MapExpr(Token *brace, std::vector<std::pair<Expr *, Expr *> > *elements): Expr(ExprKind::MAP), brace(brace),
+                                                                              elements(elements) {
     }
 };
 
@@ -232,7 +228,7 @@ public:
     Expr *expr;
     Token *op;
 
-    PrefixAutoUnaryExpr(Expr *expr, Token *op): expr(expr), op(op) {
+    PrefixAutoUnaryExpr(Expr *expr, Token *op): Expr(ExprKind::PREFIX_AUTO_UNARY), expr(expr), op(op) {
     }
 };
 
@@ -241,7 +237,19 @@ public:
     Expr *expr;
     Token *op;
 
-    SuffixAutoUnaryExpr(Expr *expr, Token *op): expr(expr), op(op) {
+    SuffixAutoUnaryExpr(Expr *expr, Token *op): Expr(ExprKind::SUFFIX_AUTO_UNARY), expr(expr), op(op) {
+    }
+};
+
+// A side effect free expression whose operands don't change while its innermost loop runs, inserted by the Optimizer.
+// It's evaluated the first time it's reached and reused for the rest of that run of the loop.
+class InvariantExpr final : public Expr {
+public:
+    Expr *expr;
+    // Index in the invariants of the loop
+    const int slot;
+
+    InvariantExpr(Expr *expr, const int slot): Expr(ExprKind::INVARIANT), expr(expr), slot(slot) {
     }
 };
 
@@ -251,53 +259,27 @@ public:
     virtual ~ExprVisitor() = default;
 
     R visitExpr(Expr *expr) {
-        if (const auto b = dynamic_cast<BinaryExpr *>(expr)) {
-            return visitBinaryExpr(b);
-        }
-        if (const auto c = dynamic_cast<CallExpr *>(expr)) {
-            return visitCallExpr(c);
-        }
-        if (const auto g = dynamic_cast<GroupingExpr *>(expr)) {
-            return visitGroupingExpr(g);
-        }
-        if (const auto l = dynamic_cast<LiteralExpr *>(expr)) {
-            return visitLiteralExpr(l);
-        }
-        if (const auto u = dynamic_cast<UnaryExpr *>(expr)) {
-            return visitUnaryExpr(u);
-        }
-        if (const auto tn = dynamic_cast<TernaryExpr *>(expr)) {
-            return visitTernaryExpr(tn);
-        }
-        if (const auto v = dynamic_cast<VariableExpr *>(expr)) {
-            return visitVariableExpr(v);
-        }
-        if (const auto a = dynamic_cast<AssignExpr *>(expr)) {
-            return visitAssignExpr(a);
-        }
-        if (const auto lg = dynamic_cast<LogicalExpr *>(expr)) {
-            return visitLogicalExpr(lg);
-        }
-        if (const auto arr = dynamic_cast<ArrayExpr *>(expr)) {
-            return visitArrayExpr(arr);
-        }
-        if (const auto index = dynamic_cast<IndexedCallExpr *>(expr)) {
-            return visitIndexedCallExpr(index);
-        }
-        if (const auto aeae = dynamic_cast<ArrayElementAssignExpr *>(expr)) {
-            return visitIndexedEleAssignExpr(aeae);
-        }
-        if (const auto mapExpr = dynamic_cast<MapExpr *>(expr)) {
-            return visitMapExpr(mapExpr);
-        }
-        if (const auto prefixAutoUnaryExpr = dynamic_cast<PrefixAutoUnaryExpr *>(expr)) {
-            return visitPrefixAutoUnaryExpr(prefixAutoUnaryExpr);
-        }
-        if (const auto suffixAutoUnaryExpr = dynamic_cast<SuffixAutoUnaryExpr *>(expr)) {
-            return visitSuffixAutoUnaryExpr(suffixAutoUnaryExpr);
-        }
-        if (const auto stringLiteral = dynamic_cast<StringLiteralExpr *>(expr)) {
-            return visitStringLiteralExpr(stringLiteral);
+        switch (expr->kind) {
+            case ExprKind::BINARY: return visitBinaryExpr(static_cast<BinaryExpr *>(expr));
+            case ExprKind::GROUPING: return visitGroupingExpr(static_cast<GroupingExpr *>(expr));
+            case ExprKind::UNARY: return visitUnaryExpr(static_cast<UnaryExpr *>(expr));
+            case ExprKind::LITERAL: return visitLiteralExpr(static_cast<LiteralExpr *>(expr));
+            case ExprKind::STRING_LITERAL: return visitStringLiteralExpr(static_cast<StringLiteralExpr *>(expr));
+            case ExprKind::TERNARY: return visitTernaryExpr(static_cast<TernaryExpr *>(expr));
+            case ExprKind::VARIABLE: return visitVariableExpr(static_cast<VariableExpr *>(expr));
+            case ExprKind::ASSIGN: return visitAssignExpr(static_cast<AssignExpr *>(expr));
+            case ExprKind::LOGICAL: return visitLogicalExpr(static_cast<LogicalExpr *>(expr));
+            case ExprKind::CALL: return visitCallExpr(static_cast<CallExpr *>(expr));
+            case ExprKind::INDEXED_CALL: return visitIndexedCallExpr(static_cast<IndexedCallExpr *>(expr));
+            case ExprKind::ARRAY: return visitArrayExpr(static_cast<ArrayExpr *>(expr));
+            case ExprKind::INDEXED_ELE_ASSIGN:
+                return visitIndexedEleAssignExpr(static_cast<ArrayElementAssignExpr *>(expr));
+            case ExprKind::MAP: return visitMapExpr(static_cast<MapExpr *>(expr));
+            case ExprKind::PREFIX_AUTO_UNARY:
+                return visitPrefixAutoUnaryExpr(static_cast<PrefixAutoUnaryExpr *>(expr));
+            case ExprKind::SUFFIX_AUTO_UNARY:
+                return visitSuffixAutoUnaryExpr(static_cast<SuffixAutoUnaryExpr *>(expr));
+            case ExprKind::INVARIANT: return visitInvariantExpr(static_cast<InvariantExpr *>(expr));
         }
         // This should not happen.
         throw std::runtime_error("Unknown expr type");
@@ -335,6 +317,8 @@ protected:
     virtual R visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) = 0;
 
     virtual R visitStringLiteralExpr(StringLiteralExpr *expr) = 0;
+
+    virtual R visitInvariantExpr(InvariantExpr *expr) = 0;
 };
 
 #endif //EXPR_HPP
@@ -8,7 +8,7 @@
 
 class ExprParser : public Parser {
 public:
-    explicit ExprParser(const std::vector<Token *> *tokens): Parser(tokens) {
+    ExprParser(const std::vector<Token *> *tokens, Arena *arena): Parser(tokens, arena) {
     }
 
     Expr *parse() {
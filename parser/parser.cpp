@@ -4,11 +4,13 @@
 
 #include "parser.hpp"
 
+#include <charconv>
+
 #include "expr_parser.hpp"
 #include "../utils/exception.hpp"
 #include "../utils/logger.hpp"
 
-Parser::Parser(const std::vector<Token *> *tokens): _tokens(tokens) {
+Parser::Parser(const std::vector<Token *> *tokens, Arena *arena): _tokens(tokens), _arena(arena) {
 }
 
 Parser::~Parser() = default;
@@ -18,7 +20,7 @@ bool Parser::isAtEnd() const {
 }
 
 std::vector<Stmt *> *Parser::parse() {
-    auto *stmts = new std::vector<Stmt *>();
+    auto *stmts = _arena->make<std::vector<Stmt *> >();
     try {
         while (!isAtEnd()) {
             stmts->push_back(statement());
@@ -45,6 +47,12 @@ Stmt *Parser::statement() {
     if (match(RETURN)) {
         return returnStatement();
     }
+    if (match(BREAK)) {
+        return breakStatement();
+    }
+    if (match(CONTINUE)) {
+        return continueStatement();
+    }
     return declarationStatement();
 }
 
@@ -71,7 +79,19 @@ Stmt *Parser::returnStatement() {
     const auto keyword = previous();
     const auto value = check(SEMICOLON) ? nullptr : expression();
     consume(SEMICOLON, "Expected ';' after return statement");
-    return new ReturnStmt(value, keyword);
+    return _arena->make<ReturnStmt>(value, keyword);
+}
+
+Stmt *Parser::breakStatement() {
+    const auto keyword = previous();
+    consume(SEMICOLON, "Expected ';' after break statement");
+    return _arena->make<BreakStmt>(keyword);
+}
+
+Stmt *Parser::continueStatement() {
+    const auto keyword = previous();
+    consume(SEMICOLON, "Expected ';' after continue statement");
+    return _arena->make<ContinueStmt>(keyword);
 }
 
 Stmt *Parser::forStatement() {
@@ -86,21 +106,14 @@ Stmt *Parser::forStatement() {
     }
     Expr *condition = !check(SEMICOLON) ? expression() : nullptr;
     consume(SEMICOLON, "Expected ';' after for statement");
-    const auto increment = !check(SEMICOLON) ? expression() : nullptr;
+    const auto increment = !check(R_PAREN) ? expression() : nullptr;
     consume(R_PAREN, "Expected ')' after for statement");
-    auto body = statement();
-    if (increment) {
-        auto *stmts = new std::vector<Stmt *>();
-        stmts->push_back(body);
-        stmts->push_back(new ExprStmt(increment));
-        body = new BlockStmt(stmts);
-    }
-    body = new WhileStmt(condition, body);
+    Stmt *body = _arena->make<WhileStmt>(condition, statement(), increment);
     if (initializer) {
-        auto *stmts = new std::vector<Stmt *>();
+        auto *stmts = _arena->make<std::vector<Stmt *> >();
         stmts->push_back(initializer);
         stmts->push_back(body);
-        body = new BlockStmt(stmts);
+        body = _arena->make<BlockStmt>(stmts);
     }
     return body;
 }
@@ -110,7 +123,7 @@ Stmt *Parser::whileStatement() {
     const auto condition = expression();
     consume(R_PAREN, "Expected ')' after while statement");
     const auto body = statement();
-    return new WhileStmt(condition, body);
+    return _arena->make<WhileStmt>(condition, body);
 }
 
 Stmt *Parser::ifStatement() {
@@ -119,7 +132,7 @@ Stmt *Parser::ifStatement() {
     consume(R_PAREN, "Expected ')' after if statement");
     const auto thenBranch = statement();
     const auto elseBranch = match(ELSE) ? statement() : nullptr;
-    return new IfStmt(condition, thenBranch, elseBranch);
+    return _arena->make<IfStmt>(condition, thenBranch, elseBranch);
 }
 
 Stmt *Parser::declarationStatement() {
@@ -135,7 +148,7 @@ Stmt *Parser::declarationStatement() {
 Stmt *Parser::functionDeclarationStatement() {
     const auto name = consume(IDENTIFIER, "Expected a function name");
     consume(L_PAREN, "Expect '(' after identifier");
-    const auto params = new std::vector<FunctionParam *>();
+    const auto params = _arena->make<std::vector<FunctionParam *> >();
     if (!check(R_PAREN)) {
         ulong varargsIndex = -1;
         do {
@@ -144,7 +157,7 @@ Stmt *Parser::functionDeclarationStatement() {
                 isVarargs = true;
             }
             const auto identifier = consume(IDENTIFIER, "Expect a parameter name");
-            params->push_back(new FunctionParam(identifier, isVarargs));
+            params->push_back(_arena->make<FunctionParam>(identifier, isVarargs));
             if (isVarargs && varargsIndex == -1) {
                 varargsIndex = params->size() - 1;
             }
@@ -155,33 +168,30 @@ Stmt *Parser::functionDeclarationStatement() {
     }
     consume(R_PAREN, "Expect ')' after parameters");
     consume(L_BRACE, "Expect '{' on function declaration");
-    const auto block = dynamic_cast<BlockStmt *>(blockStatement());
-    if (block == nullptr) {
-        error(peek(), "Missing function body");
-    }
-    return new FunctionStmt(name, params, block);
+    const auto block = static_cast<BlockStmt *>(blockStatement());
+    return _arena->make<FunctionStmt>(name, params, block);
 }
 
 Stmt *Parser::variableDeclarationStatement() {
     const auto name = consume(IDENTIFIER, "Expected a variable name");
     const auto initializer = match(EQUAL) ? expression() : nullptr;
     consume(SEMICOLON, "Expected ';' after variable declaration");
-    return new VarStmt(name, initializer);
+    return _arena->make<VarStmt>(name, initializer);
 }
 
 Stmt *Parser::expressionStatement() {
     const auto expr = expression();
     consume(SEMICOLON, "Expected ';' after expression");
-    return new ExprStmt(expr);
+    return _arena->make<ExprStmt>(expr);
 }
 
 Stmt *Parser::blockStatement() {
-    const auto stmts = new std::vector<Stmt *>();
+    const auto stmts = _arena->make<std::vector<Stmt *> >();
     while (!check(R_BRACE) && !isAtEnd()) {
         stmts->push_back(statement());
     }
     consume(R_BRACE, "Expected '}' after block statement");
-    return new BlockStmt(stmts);
+    return _arena->make<BlockStmt>(stmts);
 }
 
 Expr *Parser::expression() {
@@ -194,12 +204,14 @@ Expr *Parser::assignment() {
     if (match(EQUAL)) {
         const auto equals = previous();
         const auto rvalue = assignment();
-        if (const auto v = dynamic_cast<VariableExpr *>(expr)) {
-            const auto name = v->name;
-            return new AssignExpr(rvalue, name);
+        if (expr->kind == ExprKind::VARIABLE) {
+            const auto name = static_cast<VariableExpr *>(expr)->name;
+            return _arena->make<AssignExpr>(rvalue, name);
         }
-        if (const auto indexedCall = dynamic_cast<IndexedCallExpr *>(expr)) {
-            return new ArrayElementAssignExpr(indexedCall->callee, indexedCall->index, rvalue, indexedCall->bracket);
+        if (expr->kind == ExprKind::INDEXED_CALL) {
+            const auto indexedCall = static_cast<IndexedCallExpr *>(expr);
+            return _arena->make<ArrayElementAssignExpr>(indexedCall->callee, indexedCall->index, rvalue,
+                                                        indexedCall->bracket);
         }
         error(equals, "Invalid assign rvalue");
     }
@@ -211,7 +223,7 @@ Expr *Parser::orExpression() {
     while (match(OR)) {
         const auto op = previous();
         const auto rvalue = andExpression();
-        expr = new LogicalExpr(expr, rvalue, op);
+        expr = _arena->make<LogicalExpr>(expr, rvalue, op);
     }
     return expr;
 }
@@ -221,7 +233,7 @@ Expr *Parser::andExpression() {
     while (match(AND)) {
         const auto op = previous();
         const auto rvalue = ternaryExpression();
-        expr = new LogicalExpr(expr, rvalue, op);
+        expr = _arena->make<LogicalExpr>(expr, rvalue, op);
     }
     return expr;
 }
@@ -234,7 +246,7 @@ Expr *Parser::ternaryExpression() {
             error(peek(), "Missing token ':'");
         }
         const auto rvalue = equalityExpression();
-        expr = new TernaryExpr(lvalue, rvalue, expr);
+        expr = _arena->make<TernaryExpr>(lvalue, rvalue, expr);
     }
     return expr;
 }
@@ -244,7 +256,7 @@ Expr *Parser::equalityExpression() {
     while (match({EQUAL_EQUAL, BANG_EQUAL})) {
         const auto op = previous();
         const auto rvalue = comparisonExpression();
-        expr = new BinaryExpr(expr, op, rvalue);
+        expr = _arena->make<BinaryExpr>(expr, op, rvalue);
     }
     return expr;
 }
@@ -254,7 +266,7 @@ Expr *Parser::comparisonExpression() {
     while (match({GREATER, GREATER_EQUAL, LESS, LESS_EQUAL})) {
         const auto op = previous();
         const auto rvalue = termExpression();
-        expr = new BinaryExpr(expr, op, rvalue);
+        expr = _arena->make<BinaryExpr>(expr, op, rvalue);
     }
     return expr;
 }
@@ -264,7 +276,7 @@ Expr *Parser::termExpression() {
     while (match({PLUS, MINUS})) {
         const auto op = previous();
         const auto rvalue = factorExpression();
-        expr = new BinaryExpr(expr, op, rvalue);
+        expr = _arena->make<BinaryExpr>(expr, op, rvalue);
     }
     return expr;
 }
@@ -274,7 +286,7 @@ Expr *Parser::factorExpression() {
     while (match({SLASH, STAR})) {
         const auto op = previous();
         const auto rvalue = unaryExpression();
-        expr = new BinaryExpr(expr, op, rvalue);
+        expr = _arena->make<BinaryExpr>(expr, op, rvalue);
     }
     return expr;
 }
@@ -283,7 +295,7 @@ Expr *Parser::unaryExpression() {
     if (match({BANG, MINUS, PLUS})) {
         const auto op = previous();
         const auto rvalue = unaryExpression();
-        return new UnaryExpr(rvalue, op);
+        return _arena->make<UnaryExpr>(rvalue, op);
     }
     return prefixAutoExpression();
 }
@@ -292,7 +304,7 @@ Expr *Parser::prefixAutoExpression() {
     if (match({PLUS_PLUS, MINUS_MINUS})) {
         const auto op = previous();
         const auto rvalue = prefixAutoExpression();
-        return new PrefixAutoUnaryExpr(rvalue, op);
+        return _arena->make<PrefixAutoUnaryExpr>(rvalue, op);
     }
     return suffixAutoExpression();
 }
@@ -301,7 +313,7 @@ Expr *Parser::suffixAutoExpression() {
     auto expr = callExpression();
     while (match({PLUS_PLUS, MINUS_MINUS})) {
         const auto op = previous();
-        expr = new SuffixAutoUnaryExpr(expr, op);
+        expr = _arena->make<SuffixAutoUnaryExpr>(expr, op);
     }
     return expr;
 }
@@ -321,35 +333,35 @@ Expr *Parser::callExpression() {
 }
 
 Expr *Parser::finishCallExpr(Expr *callee) {
-    auto *args = new std::vector<Expr *>();
+    auto *args = _arena->make<std::vector<Expr *> >();
     if (!check(R_PAREN)) {
         do {
             args->push_back(expression());
         } while (match(COMMA));
     }
     const auto paren = consume(R_PAREN, "Expect '(' after parameters");
-    return new CallExpr(callee, paren, args);
+    return _arena->make<CallExpr>(callee, paren, args);
 }
 
 Expr *Parser::finishIndexedCallExpr(Expr *callee) {
     const auto index = expression();
     const auto bracket = consume(R_BRACKET, "Expect '[' after array index");
-    return new IndexedCallExpr(callee, bracket, index);
+    return _arena->make<IndexedCallExpr>(callee, bracket, index);
 }
 
 Expr *Parser::primaryExpression() {
     Expr *expr = nullptr;
     if (match(TRUE) || match(FALSE) || match(INT) || match(DOUBLE)) {
-        expr = new LiteralExpr(previous());
+        expr = _arena->make<LiteralExpr>(previous(), decodeLiteral(previous()));
     } else if (match(STRING)) {
         const auto token = previous();
         if (const auto strToken = dynamic_cast<StringToken *>(token)) {
-            std::vector<Expr *> values;
+            const auto values = _arena->make<std::vector<Expr *> >();
             const auto tokenSize = strToken->tokens.size();
             for (int i = 0; i < tokenSize;) {
                 auto tk = strToken->tokens[i];
                 if (tk->type() == STRING) {
-                    values.push_back(new LiteralExpr(tk));
+                    values->push_back(_arena->make<LiteralExpr>(tk, decodeLiteral(tk)));
                     ++i;
                     continue;
                 }
@@ -363,24 +375,24 @@ Expr *Parser::primaryExpression() {
                     tk = strToken->tokens[i];
                 }
                 if (!exprTokens.empty()) {
-                    ExprParser exprParser(&exprTokens);
-                    values.push_back(exprParser.expression());
+                    ExprParser exprParser(&exprTokens, _arena);
+                    values->push_back(exprParser.expression());
                 }
             }
-            expr = new StringLiteralExpr(values);
+            expr = _arena->make<StringLiteralExpr>(values);
         } else {
             error(token, "Wrong state, please check the lexer.");
         }
     } else if (match(L_PAREN)) {
         const auto grouping = expression();
         consume(R_PAREN, "Missing ')'");
-        expr = new GroupingExpr(grouping);
+        expr = _arena->make<GroupingExpr>(grouping);
     } else if (match(IDENTIFIER)) {
-        expr = new VariableExpr(previous());
+        expr = _arena->make<VariableExpr>(previous());
     } else if (match(L_BRACKET)) {
         Token *bracket = previous();
-        const auto elements = new std::vector<Expr *>();
-        const auto arr = new ArrayExpr(bracket, elements);
+        const auto elements = _arena->make<std::vector<Expr *> >();
+        const auto arr = _arena->make<ArrayExpr>(bracket, elements);
         if (match(R_BRACKET)) {
             // Empty array
         } else {
@@ -392,8 +404,8 @@ Expr *Parser::primaryExpression() {
         expr = arr;
     } else if (match(L_BRACE)) {
         Token *brace = previous();
-        const auto elements = new std::vector<std::pair<Expr *, Expr *> >();
-        const auto map = new MapExpr(brace, elements);
+        const auto elements = _arena->make<std::vector<std::pair<Expr *, Expr *> > >();
+        const auto map = _arena->make<MapExpr>(brace, elements);
         if (match(R_BRACE)) {
             // Empty map
         } else {
@@ -438,6 +450,42 @@ Token *Parser::consume(const TokenType type, const std::string &errorMessage) {
     return nullptr;
 }
 
+Value Parser::decodeLiteral(const Token *token) {
+    const auto text = token->lexeme();
+    const auto end = text.data() + text.size();
+    switch (token->type()) {
+        case TRUE: return Value::ofBool(true);
+        case FALSE: return Value::ofBool(false);
+        case STRING: return makeString(std::string(text));
+        case DOUBLE: {
+            double value = 0;
+            if (const auto [ptr, ec] = std::from_chars(text.data(), end, value); ec != std::errc() || ptr != end) {
+                error(token, "Invalid number literal");
+            }
+            return Value::ofDouble(value);
+        }
+        case INT: {
+            // Same prefixes as Lexer::processNumberLiteral, "0x" hexadecimal, "0b" binary and a leading 0 octal
+            int base = 10;
+            ulong prefix = 0;
+            if (text.size() > 1 && text[0] == '0') {
+                base = text[1] == 'x' ? 16 : text[1] == 'b' ? 2 : 8;
+                prefix = base == 8 ? 1 : 2;
+            }
+            int value = 0;
+            if (const auto [ptr, ec] = std::from_chars(text.data() + prefix, end, value, base);
+                ec != std::errc() || ptr != end) {
+                error(token, "Invalid number literal");
+            }
+            return Value::ofInt(value);
+        }
+        default: {
+            error(token, "Invalid literal");
+            return {};
+        }
+    }
+}
+
 void Parser::error(const Token *token, const std::string &message) {
     Logger::instance()->logError(token, message);
     throw ParserError();
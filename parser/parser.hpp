@@ -8,10 +8,13 @@
 
 #include "stmt.hpp"
 #include "../lexical/lexer.hpp"
+#include "../utils/arena.hpp"
 
 class Parser {
     ulong _currentIndex = 0;
     const std::vector<Token *> *_tokens;
+    // Owns the nodes
+    Arena *_arena;
 
     [[nodiscard]] Token *peek() const;
 
@@ -37,8 +40,10 @@ class Parser {
 
     Expr *finishIndexedCallExpr(Expr *callee);
 
+    static Value decodeLiteral(const Token *token);
+
 public:
-    explicit Parser(const std::vector<Token *> *tokens);
+    Parser(const std::vector<Token *> *tokens, Arena *arena);
 
     ~Parser();
 
@@ -48,6 +53,10 @@ public:
 
     [[nodiscard]] Stmt *returnStatement();
 
+    [[nodiscard]] Stmt *breakStatement();
+
+    [[nodiscard]] Stmt *continueStatement();
+
     [[nodiscard]] Stmt *forStatement();
 
     [[nodiscard]] Stmt *whileStatement();
@@ -9,28 +9,32 @@
 
 template<class R>
 class StmtVisitor;
+class NativeCode;
 
+// Set by every node on construction, so that visitors can dispatch without RTTI
+enum class StmtKind {
+    EXPR, VAR, BLOCK, IF, WHILE, FUNCTION, RETURN, BREAK, CONTINUE, COUNTED_LOOP
+};
+
+// Nodes are allocated in the Arena of their compilation and never deleted one by one
 class Stmt {
 public:
+    const StmtKind kind;
+
+    explicit Stmt(const StmtKind kind): kind(kind) {
+    }
+
     template<class R>
     R accept(StmtVisitor<R> *visitor) {
         return visitor->visitStmt(this);
     }
-
-    virtual ~Stmt() = 0;
 };
 
-inline Stmt::~Stmt() = default;
-
 class ExprStmt final : public Stmt {
 public:
     Expr *expr;
 
-    explicit ExprStmt(Expr *expr) : expr(expr) {
-    }
-
-    ~ExprStmt() override {
-        delete expr;
+    explicit ExprStmt(Expr *expr) : Stmt(StmtKind::EXPR), expr(expr) {
     }
 };
 
@@ -38,27 +42,21 @@ class VarStmt final : public Stmt {
 public:
     Token *name;
     Expr *initializer;
+    // Slot in the enclosing local scope assigned by the Resolver, -1 for globals
+    int slot = -1;
 
-    VarStmt(Token *name, Expr *initializer) : name(name), initializer(initializer) {
-    }
-
-    ~VarStmt() override {
-        delete initializer;
+    VarStmt(Token *name, Expr *initializer) : Stmt(StmtKind::VAR), name(name), initializer(initializer) {
     }
 };
 
 class BlockStmt final : public Stmt {
 public:
     std::vector<Stmt *> *stmts;
+    // Number of local slots declared directly in this block, computed by the Resolver. A block without any gets no
+    // scope of its own at runtime.
+    int slotCount = 0;
 
-    explicit BlockStmt(std::vector<Stmt *> *stmts) : stmts(stmts) {
-    }
-
-    ~BlockStmt() override {
-        for (const auto stmt: *stmts) {
-            delete stmt;
-        }
-        delete stmts;
+    explicit BlockStmt(std::vector<Stmt *> *stmts) : Stmt(StmtKind::BLOCK), stmts(stmts) {
     }
 };
 
@@ -68,29 +66,52 @@ public:
     Stmt *thenBlock;
     Stmt *elseBlock;
 
-    IfStmt(Expr *condition, Stmt *thenBlock, Stmt *elseBlock): condition(condition),
+    IfStmt(Expr *condition, Stmt *thenBlock, Stmt *elseBlock): Stmt(StmtKind::IF), condition(condition),
                                                                thenBlock(thenBlock),
                                                                elseBlock(elseBlock) {
     }
-
-    ~IfStmt() override {
-        delete condition;
-        delete thenBlock;
-        delete elseBlock;
-    }
 };
 
 class WhileStmt final : public Stmt {
 public:
+    // Loops forever if null
     Expr *condition;
     Stmt *body;
+    // Increment of a desugared for loop, evaluated after the body and on continue
+    Expr *increment;
+
+    // Number of InvariantExprs cached for every run of the loop
+    int invariantCount = 0;
+
+    WhileStmt(Expr *condition, Stmt *body, Expr *increment = nullptr): Stmt(StmtKind::WHILE), condition(condition),
+                                                                        body(body), increment(increment) {
+    }
+};
+
+// A for loop stepping a counter by one towards a limit, recognized by the Optimizer. The counter is only assigned by
+// the increment and the limit doesn't change while the loop runs, so the limit is evaluated once and an int counter
+// is compared and stepped natively.
+class CountedLoopStmt final : public Stmt {
+public:
+    // The counter variable on the left, compared with the limit on the right
+    BinaryExpr *condition;
+    Stmt *body;
+    // Steps the counter, evaluated as is when the counter isn't an int
+    Expr *increment;
+    // 1 when counting up, -1 when counting down
+    const int step;
+    int invariantCount = 0;
 
-    WhileStmt(Expr *condition, Stmt *body): condition(condition), body(body) {
+    CountedLoopStmt(BinaryExpr *condition, Stmt *body, Expr *increment, const int step):
+        Stmt(StmtKind::COUNTED_LOOP), condition(condition), body(body), increment(increment), step(step) {
     }
 
-    ~WhileStmt() override {
-        delete condition;
-        delete body;
+    [[nodiscard]] VariableExpr *counter() const {
+        return static_cast<VariableExpr *>(condition->left);
+    }
+
+    [[nodiscard]] Expr *limit() const {
+        return condition->right;
     }
 };
 
@@ -98,6 +119,7 @@ class FunctionParam final {
 public:
     Token *name;
     const bool isVararg = false;
+    int slot = -1;
 
     FunctionParam(Token *name, const bool isVararg) : name(name), isVararg(isVararg) {
     }
@@ -108,27 +130,51 @@ public:
     Token *name;
     std::vector<FunctionParam *> *params;
     BlockStmt *bodyBlock;
+    // Slot of the function itself in the enclosing local scope, -1 for globals
+    int slot = -1;
+    // Number of local slots of the parameters and the body, which share one scope
+    int slotCount = 0;
+    // Index of the varargs in the region of a call, assigned by the EscapeAnalyzer if they never escape the call
+    int localIndex = -1;
+    // Interpreted calls counted by the Jit until the function gets hot
+    ulong callCount = 0;
+    // Compiled by the Jit once the function got hot, null while it is interpreted
+    const NativeCode *nativeCode = nullptr;
+
+    FunctionStmt(Token *name, std::vector<FunctionParam *> *params, BlockStmt *block): Stmt(StmtKind::FUNCTION),
+        name(name), params(params), bodyBlock(block) {
+    }
+};
+
+class ReturnStmt final : public Stmt {
+public:
+    Expr *value;
+    Token *keyword;
 
-    FunctionStmt(Token *name, std::vector<FunctionParam *> *params, BlockStmt *block): name(name), params(params),
-        bodyBlock(block) {
+    ReturnStmt(Expr *value, Token *keyword) : Stmt(StmtKind::RETURN), value(value), keyword(keyword) {
     }
 
-    ~FunctionStmt() override {
-        delete params;
-        delete bodyBlock;
+    // Nothing is left to do with the value of a returned call, so it can run in place of the returning function.
+    // Intrinsics are computed right away instead.
+    [[nodiscard]] bool isTailCall() const {
+        return value != nullptr && value->kind == ExprKind::CALL &&
+               static_cast<const CallExpr *>(value)->intrinsic == Intrinsic::NONE;
     }
 };
 
-class ReturnStmt final : public Stmt {
+class BreakStmt final : public Stmt {
 public:
-    Expr *value;
     Token *keyword;
 
-    ReturnStmt(Expr *value, Token *keyword) : value(value), keyword(keyword) {
+    explicit BreakStmt(Token *keyword) : Stmt(StmtKind::BREAK), keyword(keyword) {
     }
+};
 
-    ~ReturnStmt() override {
-        delete value;
+class ContinueStmt final : public Stmt {
+public:
+    Token *keyword;
+
+    explicit ContinueStmt(Token *keyword) : Stmt(StmtKind::CONTINUE), keyword(keyword) {
     }
 };
 
@@ -136,26 +182,17 @@ template<class R>
 class StmtVisitor {
 public:
     R visitStmt(Stmt *stmt) {
-        if (const auto s = dynamic_cast<ExprStmt *>(stmt)) {
-            return visitExprStmt(s);
-        }
-        if (const auto v = dynamic_cast<VarStmt *>(stmt)) {
-            return visitVarStmt(v);
-        }
-        if (const auto b = dynamic_cast<BlockStmt *>(stmt)) {
-            return visitBlockStmt(b);
-        }
-        if (const auto i = dynamic_cast<IfStmt *>(stmt)) {
-            return visitIfStmt(i);
-        }
-        if (const auto w = dynamic_cast<WhileStmt *>(stmt)) {
-            return visitWhileStmt(w);
-        }
-        if (const auto f = dynamic_cast<FunctionStmt *>(stmt)) {
-            return visitFunctionStmt(f);
-        }
-        if (const auto r = dynamic_cast<ReturnStmt *>(stmt)) {
-            return visitReturnStmt(r);
+        switch (stmt->kind) {
+            case StmtKind::EXPR: return visitExprStmt(static_cast<ExprStmt *>(stmt));
+            case StmtKind::VAR: return visitVarStmt(static_cast<VarStmt *>(stmt));
+            case StmtKind::BLOCK: return visitBlockStmt(static_cast<BlockStmt *>(stmt));
+            case StmtKind::IF: return visitIfStmt(static_cast<IfStmt *>(stmt));
+            case StmtKind::WHILE: return visitWhileStmt(static_cast<WhileStmt *>(stmt));
+            case StmtKind::FUNCTION: return visitFunctionStmt(static_cast<FunctionStmt *>(stmt));
+            case StmtKind::RETURN: return visitReturnStmt(static_cast<ReturnStmt *>(stmt));
+            case StmtKind::BREAK: return visitBreakStmt(static_cast<BreakStmt *>(stmt));
+            case StmtKind::CONTINUE: return visitContinueStmt(static_cast<ContinueStmt *>(stmt));
+            case StmtKind::COUNTED_LOOP: return visitCountedLoopStmt(static_cast<CountedLoopStmt *>(stmt));
         }
         // This should not happen
         throw RuntimeError("This shouldn't happen");
@@ -177,6 +214,12 @@ protected:
     virtual R visitFunctionStmt(FunctionStmt *stmt) = 0;
 
     virtual R visitReturnStmt(ReturnStmt *stmt) = 0;
+
+    virtual R visitBreakStmt(BreakStmt *stmt) = 0;
+
+    virtual R visitContinueStmt(ContinueStmt *stmt) = 0;
+
+    virtual R visitCountedLoopStmt(CountedLoopStmt *stmt) = 0;
 };
 
 #endif //STMT_HPP
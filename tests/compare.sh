@@ -0,0 +1,25 @@
+#!/bin/sh
+# Runs every script of this directory and of static_errors/ with two sets of options and fails if their outputs
+# differ. The scripts of static_errors/ have errors the Resolver reports, which are part of the output.
+# Usage: compare.sh path/to/soxsh "options" "reference options"
+soxsh=${1:?usage: compare.sh path/to/soxsh options reference-options}
+options=$2
+reference=$3
+dir=$(dirname "$0")
+status=0
+for script in "$dir"/*.sox "$dir"/static_errors/*.sox; do
+    # Options are split into words on purpose
+    actual=$("$soxsh" $options "$script" 2>&1)
+    expected=$("$soxsh" $reference "$script" 2>&1)
+    if [ "$actual" != "$expected" ]; then
+        echo "FAIL $script ($options vs $reference)"
+        file=$(mktemp)
+        printf '%s\n' "$expected" > "$file"
+        printf '%s\n' "$actual" | diff "$file" - | sed 's/^/    /'
+        rm -f "$file"
+        status=1
+    else
+        echo "ok   $script ($options vs $reference)"
+    fi
+done
+exit $status
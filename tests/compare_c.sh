@@ -0,0 +1,31 @@
+#!/bin/sh
+# Translates every script of this directory with --emit-c, builds it against aot/runtime and fails if the program
+# prints something else than the interpreter. Scripts with static errors, which --emit-c refuses, are in
+# static_errors/ and left out.
+# Usage: compare_c.sh path/to/soxsh [cc]
+soxsh=${1:?usage: compare_c.sh path/to/soxsh [cc]}
+cc=${2:-cc}
+dir=$(dirname "$0")
+runtime="$dir/../aot/runtime"
+work=$(mktemp -d)
+status=0
+for script in "$dir"/*.sox; do
+    if ! "$soxsh" --emit-c "$work/program.c" "$script" ||
+            ! "$cc" -Wall -Werror -I"$runtime" -o "$work/program" "$work/program.c" "$runtime/sox_runtime.c" -lm; then
+        echo "FAIL $script (not translated)"
+        status=1
+        continue
+    fi
+    actual=$("$work/program" 2>&1)
+    expected=$("$soxsh" "$script" 2>&1)
+    if [ "$actual" != "$expected" ]; then
+        echo "FAIL $script (--emit-c)"
+        printf '%s\n' "$expected" > "$work/expected"
+        printf '%s\n' "$actual" | diff "$work/expected" - | sed 's/^/    /'
+        status=1
+    else
+        echo "ok   $script (--emit-c)"
+    fi
+done
+rm -rf "$work"
+exit $status
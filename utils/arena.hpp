@@ -0,0 +1,68 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+#include <cstdlib>
+#include <new>
+#include <sys/types.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator owning the tokens and syntax tree of one compilation. Nothing is freed individually, all blocks are
+// released together when the arena goes away. Only objects with non-trivial destructors, like the vectors of child
+// nodes, are remembered and destroyed in reverse order of construction.
+class Arena {
+    static constexpr ulong BLOCK_SIZE = 64 * 1024;
+
+    struct Finalizer {
+        void (*destroy)(void *);
+        void *object;
+    };
+
+    std::vector<void *> _blocks;
+    std::vector<Finalizer> _finalizers;
+    char *_cursor = nullptr;
+    char *_end = nullptr;
+
+    void *allocate(const ulong size, const ulong align) {
+        auto aligned = reinterpret_cast<char *>((reinterpret_cast<ulong>(_cursor) + align - 1) & ~(align - 1));
+        if (_cursor == nullptr || aligned + size > _end) {
+            const auto blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+            const auto block = static_cast<char *>(std::malloc(blockSize));
+            if (block == nullptr) {
+                throw std::bad_alloc();
+            }
+            _blocks.push_back(block);
+            _end = block + blockSize;
+            aligned = reinterpret_cast<char *>((reinterpret_cast<ulong>(block) + align - 1) & ~(align - 1));
+        }
+        _cursor = aligned + size;
+        return aligned;
+    }
+
+public:
+    Arena() = default;
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() {
+        for (auto it = _finalizers.rbegin(); it != _finalizers.rend(); ++it) {
+            it->destroy(it->object);
+        }
+        for (const auto block: _blocks) {
+            std::free(block);
+        }
+    }
+
+    template<class T, class... Args>
+    T *make(Args &&... args) {
+        const auto object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            _finalizers.push_back({[](void *p) { static_cast<T *>(p)->~T(); }, object});
+        }
+        return object;
+    }
+};
+
+#endif //ARENA_HPP
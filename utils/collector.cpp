@@ -0,0 +1,87 @@
+#include "collector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Never destroyed, objects may still be released during static destruction
+Collector *Collector::sInstance = new Collector();
+
+void Collector::collect() {
+    const auto start = std::chrono::steady_clock::now();
+    if (_promoted >= std::max(YOUNG_THRESHOLD, OLD_GROWTH * _oldBase)) {
+        // Everything is old for a full collection
+        while (const auto object = _firsts[YOUNG]) {
+            unlink(object);
+            link(object, OLD);
+        }
+        collect(OLD);
+        _oldBase = _counts[OLD];
+        _promoted = 0;
+        ++_fullCollections;
+    } else {
+        collect(YOUNG);
+    }
+    ++_collections;
+    _collectingSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Collector::collect(const uint8_t generation) {
+    _collecting = generation;
+    std::vector<Traceable *> objects;
+    objects.reserve(_counts[generation]);
+    for (auto object = _firsts[generation]; object != nullptr; object = object->_next) {
+        object->_gcRefs = object->refCount();
+        object->_isReachable = false;
+        objects.push_back(object);
+    }
+    // Whatever is left are references from outside
+    for (const auto object: objects) {
+        object->traverse([](Traceable *referenced) {
+            if (sInstance->isCollected(referenced)) {
+                --referenced->_gcRefs;
+            }
+        });
+    }
+    for (const auto object: objects) {
+        if (object->_gcRefs > 0) {
+            object->_isReachable = true;
+            _pending.push_back(object);
+        }
+    }
+    while (!_pending.empty()) {
+        const auto object = _pending.back();
+        _pending.pop_back();
+        object->traverse([](Traceable *referenced) {
+            if (sInstance->isCollected(referenced) && !referenced->_isReachable) {
+                referenced->_isReachable = true;
+                sInstance->_pending.push_back(referenced);
+            }
+        });
+    }
+    std::vector<Traceable *> garbage;
+    std::vector<std::shared_ptr<void> > pins;
+    for (const auto object: objects) {
+        if (!object->_isReachable) {
+            garbage.push_back(object);
+            pins.push_back(object->pin());
+        } else if (generation == YOUNG) {
+            unlink(object);
+            link(object, OLD);
+            ++_promoted;
+        }
+    }
+    // Pinned, so that nothing is freed while the references are dropped. Only the garbage references the garbage,
+    // releasing the pins then frees all of it.
+    for (const auto object: garbage) {
+        object->clearReferences();
+    }
+    pins.clear();
+    _freedCount += garbage.size();
+}
+
+void Collector::printStats() const {
+    std::cerr << "[gc] collections: " << _collections << " (full: " << _fullCollections << "), tracked: "
+            << _trackedCount << ", freed: " << _freedCount << ", live: " << _counts[YOUNG] + _counts[OLD] << ", peak: "
+            << _peakCount << ", time: " << _collectingSeconds * 1000 << "ms" << std::endl;
+}
@@ -0,0 +1,163 @@
+#ifndef COLLECTOR_HPP
+#define COLLECTOR_HPP
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
+class Traceable;
+
+typedef void (*Tracer)(Traceable *);
+
+// Runtime object that can be part of a reference cycle. Tracked objects are registered with the Collector, which
+// finds the groups of them that are only referenced by each other and breaks them up.
+class Traceable {
+    friend class Collector;
+
+    Traceable *_prev = nullptr;
+    Traceable *_next = nullptr;
+    // References from outside the objects being collected
+    long _gcRefs = 0;
+    bool _isTracked = false;
+    bool _isReachable = false;
+    uint8_t _generation = 0;
+
+protected:
+    // Registers the object, called by the constructors of the types which may reference other tracked objects
+    void track();
+
+public:
+    Traceable() = default;
+
+    Traceable(const Traceable &) = delete;
+
+    Traceable &operator=(const Traceable &) = delete;
+
+    virtual ~Traceable();
+
+    // Number of counted references to the object
+    [[nodiscard]] virtual long refCount() const = 0;
+
+    // Reports every tracked object this one holds a counted reference to, once per reference. Leaving some out only
+    // keeps them alive, reporting a reference that isn't counted would free objects still in use.
+    virtual void traverse([[maybe_unused]] Tracer visit) {
+    }
+
+    // Drops the references to other objects, so that the cycles the object is part of fall apart
+    virtual void clearReferences() {
+    }
+
+    // Counted reference keeping the object alive while its cycle is broken up
+    virtual std::shared_ptr<void> pin() = 0;
+};
+
+// Reclaims the cycles reference counting can't free. Everything referenced from outside the objects being collected,
+// like by the interpreter, its value stack or the globals, is a root. Starting from the reference counts, the
+// references the collected objects hold to each other are subtracted, and whatever can't be reached from an object
+// with references left is garbage.
+//
+// Objects start in the young generation, which is collected once enough of them are alive. The survivors are moved
+// to the old generation, which is only collected along with the young one once it has grown fivefold. Until then the
+// references old objects hold keep young ones alive, and big long-lived containers aren't traversed over and over.
+//
+// Collections only happen at safe points.
+class Collector final {
+    friend class Traceable;
+
+    static constexpr uint8_t YOUNG = 0;
+    static constexpr uint8_t OLD = 1;
+    static constexpr ulong YOUNG_THRESHOLD = 10000;
+    // Promotions since the last full collection that trigger the next one, relative to the old objects it left
+    static constexpr ulong OLD_GROWTH = 4;
+
+    static Collector *sInstance;
+
+    Traceable *_firsts[2] = {};
+    ulong _counts[2] = {};
+    // Old objects after the last full collection, and the ones promoted since
+    ulong _oldBase = 0;
+    ulong _promoted = 0;
+    // Generation being collected, and its objects left to traverse while marking
+    uint8_t _collecting = YOUNG;
+    std::vector<Traceable *> _pending;
+
+    ulong _peakCount = 0;
+    ulong _collections = 0;
+    ulong _fullCollections = 0;
+    ulong _trackedCount = 0;
+    ulong _freedCount = 0;
+    double _collectingSeconds = 0;
+
+    Collector() = default;
+
+    // Collects the generation, the young objects surviving are moved to the old generation
+    void collect(uint8_t generation);
+
+    [[nodiscard]] bool isCollected(const Traceable *object) const {
+        return object->_isTracked && object->_generation == _collecting;
+    }
+
+    void link(Traceable *object, uint8_t generation);
+
+    void unlink(const Traceable *object);
+
+public:
+    static Collector *instance() {
+        return sInstance;
+    }
+
+    // Safe point, any object may be freed here unless something outside the tracked objects references it
+    void maybeCollect() {
+        if (_counts[YOUNG] >= YOUNG_THRESHOLD) {
+            collect();
+        }
+    }
+
+    // Collects the young generation, and the old one too if it has grown enough
+    void collect();
+
+    // Prints what has been collected so far
+    void printStats() const;
+};
+
+inline void Collector::link(Traceable *object, const uint8_t generation) {
+    object->_generation = generation;
+    object->_prev = nullptr;
+    object->_next = _firsts[generation];
+    if (object->_next != nullptr) {
+        object->_next->_prev = object;
+    }
+    _firsts[generation] = object;
+    ++_counts[generation];
+}
+
+inline void Collector::unlink(const Traceable *object) {
+    if (object->_prev != nullptr) {
+        object->_prev->_next = object->_next;
+    } else {
+        _firsts[object->_generation] = object->_next;
+    }
+    if (object->_next != nullptr) {
+        object->_next->_prev = object->_prev;
+    }
+    --_counts[object->_generation];
+}
+
+inline void Traceable::track() {
+    const auto collector = Collector::instance();
+    collector->link(this, Collector::YOUNG);
+    _isTracked = true;
+    ++collector->_trackedCount;
+    if (const auto live = collector->_counts[Collector::YOUNG] + collector->_counts[Collector::OLD];
+        live > collector->_peakCount) {
+        collector->_peakCount = live;
+    }
+}
+
+inline Traceable::~Traceable() {
+    if (_isTracked) {
+        Collector::instance()->unlink(this);
+    }
+}
+
+#endif //COLLECTOR_HPP
@@ -24,12 +24,4 @@ public:
     }
 };
 
-class ReturnValue final : public std::exception {
-public:
-    std::shared_ptr<ValueHolder> value;
-
-    explicit ReturnValue(std::shared_ptr<ValueHolder> value) : value(std::move(value)) {
-    }
-};
-
 #endif //ERROR_HPP
@@ -0,0 +1,23 @@
+#include "pool.hpp"
+
+#include <iostream>
+
+// Never destroyed, objects may still be released during static destruction
+Pool *Pool::sInstance = new Pool();
+
+void *Pool::carve(const ulong size) {
+    if (_chunkEnd - _chunkNext < static_cast<long>(size)) {
+        // The rest of the last chunk is too small for this class and left unused
+        _chunkNext = static_cast<char *>(::operator new(CHUNK_SIZE));
+        _chunkEnd = _chunkNext + CHUNK_SIZE;
+    }
+    const auto block = _chunkNext;
+    _chunkNext += size;
+    return block;
+}
+
+void Pool::printStats() const {
+    const auto total = _hits + _misses;
+    std::cerr << "[pool] allocations: " << total << ", hits: " << _hits << ", misses: " << _misses << ", hit rate: "
+            << (total == 0 ? 0 : _hits * 100 / total) << "%" << std::endl;
+}
@@ -0,0 +1,95 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+#include <new>
+#include <sys/types.h>
+
+// Freelists of small blocks by size class, for the runtime objects that are allocated and released all the time.
+// Freed blocks are kept for the next allocation of their class, new ones are carved out of large chunks. Blocks
+// larger than the biggest class go to the global operator new.
+//
+// Values are released without knowing which interpreter created them, so there is one pool for the process. The
+// interpreter is single threaded, the pool isn't synchronized.
+class Pool final {
+    struct Block {
+        Block *next;
+    };
+
+    static constexpr ulong GRANULE = 16;
+    static constexpr ulong CLASS_COUNT = 16;
+    static constexpr ulong MAX_SIZE = GRANULE * CLASS_COUNT;
+    static constexpr ulong CHUNK_SIZE = 64 * 1024;
+
+    static Pool *sInstance;
+
+    Block *_freeLists[CLASS_COUNT] = {};
+    char *_chunkNext = nullptr;
+    char *_chunkEnd = nullptr;
+    // Allocations served by a freed block, and the ones that needed new memory
+    ulong _hits = 0;
+    ulong _misses = 0;
+
+    Pool() = default;
+
+    void *carve(ulong size);
+
+public:
+    static Pool *instance() {
+        return sInstance;
+    }
+
+    void *allocate(const ulong size) {
+        if (size > MAX_SIZE) {
+            ++_misses;
+            return ::operator new(size);
+        }
+        auto &freeList = _freeLists[(size - 1) / GRANULE];
+        if (const auto block = freeList) {
+            freeList = block->next;
+            ++_hits;
+            return block;
+        }
+        ++_misses;
+        return carve((size + GRANULE - 1) / GRANULE * GRANULE);
+    }
+
+    // size has to be the one the block was allocated with
+    void deallocate(void *pointer, const ulong size) {
+        if (size > MAX_SIZE) {
+            ::operator delete(pointer);
+            return;
+        }
+        auto &freeList = _freeLists[(size - 1) / GRANULE];
+        const auto block = static_cast<Block *>(pointer);
+        block->next = freeList;
+        freeList = block;
+    }
+
+    void printStats() const;
+};
+
+// Allocator for std::allocate_shared, so that the object and its control block come from the Pool
+template<class T>
+struct PoolAllocator {
+    typedef T value_type;
+
+    PoolAllocator() = default;
+
+    template<class U>
+    explicit PoolAllocator(const PoolAllocator<U> &) {
+    }
+
+    T *allocate(const ulong n) {
+        return static_cast<T *>(Pool::instance()->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, const ulong n) {
+        Pool::instance()->deallocate(pointer, n * sizeof(T));
+    }
+
+    template<class U>
+    bool operator==(const PoolAllocator<U> &) const {
+        return true;
+    }
+};
+
+#endif //POOL_HPP
@@ -11,10 +11,12 @@
 #include "../lexical/token_type.hpp"
 
 class SoxKeywords {
-    std::map<std::string, TokenType> _keywords;
+    std::map<std::string, TokenType, std::less<> > _keywords;
     static SoxKeywords *_sInstance;
 
     SoxKeywords() {
+        _keywords.insert(std::make_pair("break", BREAK));
+        _keywords.insert(std::make_pair("continue", CONTINUE));
         _keywords.insert(std::make_pair("else", ELSE));
         _keywords.insert(std::make_pair("false", FALSE));
         _keywords.insert(std::make_pair("for", FOR));
@@ -33,11 +35,12 @@ public:
         delete _sInstance;
     }
 
-    [[nodiscard]] TokenType getKeyword(const std::string &kw) const {
-        if (!_keywords.contains(kw)) {
+    [[nodiscard]] TokenType getKeyword(const std::string_view kw) const {
+        const auto it = _keywords.find(kw);
+        if (it == _keywords.end()) {
             return IDENTIFIER;
         }
-        return _keywords.at(kw);
+        return it->second;
     }
 
     static SoxKeywords *instance() {
@@ -0,0 +1,62 @@
+#ifndef CHUNK_HPP
+#define CHUNK_HPP
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "opcode.hpp"
+#include "../lexical/value.hpp"
+
+class FunctionProto;
+
+class Chunk {
+public:
+    std::vector<uint8_t> code;
+
+    std::vector<Value> constants;
+
+    // Global slot for every name constant, -1 until the VM first resolves it
+    std::vector<int> globalSlots;
+
+    std::vector<std::shared_ptr<FunctionProto> > functions;
+
+    // Run-length encoded line table, every entry is (first code offset, line)
+    std::vector<std::pair<uint, uint> > lines;
+
+    // Offsets where a top level statement begins, used to resume after a runtime error
+    std::vector<uint> statementOffsets;
+
+    void write(const uint8_t byte, const uint line) {
+        if (lines.empty() || lines.back().second != line) {
+            lines.emplace_back(code.size(), line);
+        }
+        code.push_back(byte);
+    }
+
+    [[nodiscard]] uint lineAt(const ulong offset) const {
+        uint line = 0;
+        for (const auto &[start, l]: lines) {
+            if (start > offset) {
+                break;
+            }
+            line = l;
+        }
+        return line;
+    }
+};
+
+class FunctionProto final {
+public:
+    std::string name;
+    int arity = 0;
+    bool isVarargs = false;
+    int upvalueCount = 0;
+    Chunk chunk;
+
+    explicit FunctionProto(std::string name): name(std::move(name)) {
+    }
+};
+
+#endif //CHUNK_HPP
@@ -0,0 +1,649 @@
+#include "compiler.hpp"
+
+#include <iterator>
+
+#include "../utils/logger.hpp"
+
+std::shared_ptr<FunctionProto> Compiler::compile(std::vector<Stmt *> *stmts) {
+    FunctionState script{nullptr, std::make_shared<FunctionProto>("script")};
+    // Slot 0 holds the callee, just like every other frame
+    script.locals.push_back({"", 0, false});
+    _state = &script;
+    _hasError = false;
+    for (const auto stmt: *stmts) {
+        chunk().statementOffsets.push_back(chunk().code.size());
+        compile(stmt);
+        for (const auto exit: _statementExits) {
+            patchJump(exit);
+        }
+        _statementExits.clear();
+    }
+    emit(OP_NULL);
+    emit(OP_RETURN);
+    chunk().globalSlots.assign(chunk().constants.size(), -1);
+    _state = nullptr;
+    if (_hasError) {
+        return nullptr;
+    }
+    return script.proto;
+}
+
+Chunk &Compiler::chunk() const {
+    return _state->proto->chunk;
+}
+
+void Compiler::emit(const uint8_t byte) const {
+    chunk().write(byte, _line);
+}
+
+void Compiler::emit(const OpCode op, const uint8_t operand) const {
+    emit(op);
+    emit(operand);
+}
+
+void Compiler::emitShort(const OpCode op, const uint16_t operand) const {
+    emit(op);
+    emit(operand >> 8 & 0xff);
+    emit(operand & 0xff);
+}
+
+ulong Compiler::emitJump(const OpCode op) const {
+    emitShort(op, 0xffff);
+    return chunk().code.size() - 2;
+}
+
+void Compiler::patchJump(const ulong offset) {
+    const auto jump = chunk().code.size() - offset - 2;
+    if (jump > UINT16_MAX) {
+        error("Too much code to jump over");
+        return;
+    }
+    chunk().code[offset] = jump >> 8 & 0xff;
+    chunk().code[offset + 1] = jump & 0xff;
+}
+
+void Compiler::emitLoop(const ulong loopStart) {
+    const auto offset = chunk().code.size() - loopStart + 3;
+    if (offset > UINT16_MAX) {
+        error("Loop body too large");
+        return;
+    }
+    emitShort(OP_LOOP, offset);
+}
+
+uint16_t Compiler::makeConstant(const Value &value) {
+    auto &constants = chunk().constants;
+    if (constants.size() > UINT16_MAX) {
+        error("Too many constants in one function");
+        return 0;
+    }
+    constants.push_back(value);
+    return constants.size() - 1;
+}
+
+uint16_t Compiler::nameConstant(const std::string_view name) {
+    if (const auto it = _state->names.find(name); it != _state->names.end()) {
+        return it->second;
+    }
+    const auto index = makeConstant(makeString(std::string(name)));
+    _state->names.emplace(name, index);
+    return index;
+}
+
+void Compiler::compile(Expr *expr) {
+    expr->accept((ExprVisitor *) this);
+}
+
+void Compiler::compile(Stmt *stmt) {
+    stmt->accept((StmtVisitor *) this);
+}
+
+void Compiler::compileFunction(const FunctionStmt *stmt) {
+    FunctionState function{_state, std::make_shared<FunctionProto>(std::string(stmt->name->lexeme()))};
+    function.scopeDepth = 1;
+    function.locals.push_back({"", 1, false});
+    function.proto->arity = static_cast<int>(stmt->params->size());
+    function.proto->isVarargs = !stmt->params->empty() && stmt->params->back()->isVararg;
+    _state = &function;
+    for (const auto param: *stmt->params) {
+        addLocal(param->name->lexeme());
+    }
+    // Same as the Resolver, parameters and top level body statements share one scope
+    for (const auto bodyStmt: *stmt->bodyBlock->stmts) {
+        compile(bodyStmt);
+    }
+    emit(OP_NULL);
+    emit(OP_RETURN);
+    chunk().globalSlots.assign(chunk().constants.size(), -1);
+    _state = function.enclosing;
+
+    function.proto->upvalueCount = static_cast<int>(function.upvalues.size());
+    auto &functions = chunk().functions;
+    functions.push_back(function.proto);
+    if (functions.size() > UINT16_MAX + 1) {
+        error(stmt->name, "Too many functions in one scope");
+    }
+    _line = stmt->name->line();
+    emitShort(OP_CLOSURE, functions.size() - 1);
+    for (const auto &[index, isLocal]: function.upvalues) {
+        emit(isLocal ? 1 : 0);
+        emit(index);
+    }
+}
+
+void Compiler::discardLocals(const int depth) const {
+    const auto &locals = _state->locals;
+    for (auto it = locals.rbegin(); it != locals.rend() && it->depth > depth; ++it) {
+        emit(it->isCaptured ? OP_CLOSE_UPVALUE : OP_POP);
+    }
+}
+
+void Compiler::emitStrayJump() {
+    if (_state->enclosing != nullptr) {
+        // Same as running off the end of the function
+        emit(OP_NULL);
+        emit(OP_RETURN);
+    } else {
+        discardLocals(0);
+        _statementExits.push_back(emitJump(OP_JUMP));
+    }
+}
+
+void Compiler::beginScope() const {
+    ++_state->scopeDepth;
+}
+
+void Compiler::endScope() const {
+    --_state->scopeDepth;
+    auto &locals = _state->locals;
+    while (!locals.empty() && locals.back().depth > _state->scopeDepth) {
+        emit(locals.back().isCaptured ? OP_CLOSE_UPVALUE : OP_POP);
+        locals.pop_back();
+    }
+}
+
+int Compiler::addLocal(const std::string_view name) {
+    if (_state->locals.size() > UINT8_MAX) {
+        error("Too many local variables in function");
+        return 0;
+    }
+    _state->locals.push_back({std::string(name), _state->scopeDepth, false});
+    return static_cast<int>(_state->locals.size()) - 1;
+}
+
+int Compiler::declaredInScope(const std::string_view name) const {
+    const auto &locals = _state->locals;
+    for (int i = static_cast<int>(locals.size()) - 1; i >= 0 && locals[i].depth == _state->scopeDepth; --i) {
+        if (locals[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int Compiler::resolveLocal(const FunctionState *state, const std::string_view name) {
+    for (int i = static_cast<int>(state->locals.size()) - 1; i > 0; --i) {
+        if (state->locals[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int Compiler::resolveUpvalue(FunctionState *state, const std::string_view name) {
+    if (state->enclosing == nullptr) {
+        return -1;
+    }
+    if (const int local = resolveLocal(state->enclosing, name); local != -1) {
+        state->enclosing->locals[local].isCaptured = true;
+        return addUpvalue(state, local, true);
+    }
+    if (const int upvalue = resolveUpvalue(state->enclosing, name); upvalue != -1) {
+        return addUpvalue(state, upvalue, false);
+    }
+    return -1;
+}
+
+int Compiler::addUpvalue(FunctionState *state, const uint8_t index, const bool isLocal) {
+    auto &upvalues = state->upvalues;
+    for (int i = 0; i < std::ssize(upvalues); ++i) {
+        if (upvalues[i].index == index && upvalues[i].isLocal == isLocal) {
+            return i;
+        }
+    }
+    if (upvalues.size() > UINT8_MAX) {
+        error("Too many closure variables in function");
+        return 0;
+    }
+    upvalues.push_back({index, isLocal});
+    return static_cast<int>(upvalues.size()) - 1;
+}
+
+void Compiler::emitGet(const std::string_view name) {
+    if (const int local = resolveLocal(_state, name); local != -1) {
+        emit(OP_GET_LOCAL, local);
+    } else if (const int upvalue = resolveUpvalue(_state, name); upvalue != -1) {
+        emit(OP_GET_UPVALUE, upvalue);
+    } else {
+        emitShort(OP_GET_GLOBAL, nameConstant(name));
+    }
+}
+
+void Compiler::emitSet(const std::string_view name) {
+    if (const int local = resolveLocal(_state, name); local != -1) {
+        emit(OP_SET_LOCAL, local);
+    } else if (const int upvalue = resolveUpvalue(_state, name); upvalue != -1) {
+        emit(OP_SET_UPVALUE, upvalue);
+    } else {
+        emitShort(OP_SET_GLOBAL, nameConstant(name));
+    }
+}
+
+void Compiler::emitDefine(const std::string_view name) {
+    if (_state->scopeDepth == 0) {
+        emitShort(OP_DEFINE_GLOBAL, nameConstant(name));
+    } else if (const int existing = declaredInScope(name); existing != -1) {
+        // Redeclaring in the same scope replaces the variable, or merges overloads
+        emit(OP_DEFINE_LOCAL, existing);
+    } else {
+        // The value already sits in the new slot
+        addLocal(name);
+    }
+}
+
+void Compiler::error(const Token *token, const std::string &message) {
+    _hasError = true;
+    Logger::instance()->logError(token, message);
+}
+
+void Compiler::error(const std::string &message) {
+    _hasError = true;
+    Logger::instance()->logError(_line, message);
+}
+
+void Compiler::visitBinaryExpr(BinaryExpr *expr) {
+    compile(expr->left);
+    compile(expr->right);
+    _line = expr->op->line();
+    switch (expr->op->type()) {
+        case PLUS: emit(OP_ADD);
+            break;
+        case MINUS: emit(OP_SUBTRACT);
+            break;
+        case STAR: emit(OP_MULTIPLY);
+            break;
+        case SLASH: emit(OP_DIVIDE);
+            break;
+        case GREATER: emit(OP_GREATER);
+            break;
+        case GREATER_EQUAL: emit(OP_GREATER_EQUAL);
+            break;
+        case LESS: emit(OP_LESS);
+            break;
+        case LESS_EQUAL: emit(OP_LESS_EQUAL);
+            break;
+        case EQUAL_EQUAL: emit(OP_EQUAL);
+            break;
+        case BANG_EQUAL: emit(OP_NOT_EQUAL);
+            break;
+        default: error(expr->op, "Invalid binary operator");
+    }
+}
+
+void Compiler::visitGroupingExpr(GroupingExpr *expr) {
+    compile(expr->expr);
+}
+
+void Compiler::visitLiteralExpr(LiteralExpr *expr) {
+    _line = expr->value->line();
+    // The token may be an operator or a variable for literals the Optimizer folded, so look at the value instead
+    const auto &constant = expr->constant;
+    if (constant.isNull()) {
+        emit(OP_NULL);
+    } else if (constant.isBool()) {
+        emit(constant.asBool() ? OP_TRUE : OP_FALSE);
+    } else {
+        emitShort(OP_CONSTANT, makeConstant(constant));
+    }
+}
+
+void Compiler::visitUnaryExpr(UnaryExpr *expr) {
+    compile(expr->right);
+    _line = expr->op->line();
+    switch (expr->op->type()) {
+        case PLUS: emit(OP_POSITIVE);
+            break;
+        case MINUS: emit(OP_NEGATE);
+            break;
+        case BANG: emit(OP_NOT);
+            break;
+        default: error(expr->op, "Invalid unary operator");
+    }
+}
+
+void Compiler::visitTernaryExpr(TernaryExpr *expr) {
+    // Every operand is evaluated, like in the Interpreter
+    compile(expr->condition);
+    compile(expr->left);
+    compile(expr->right);
+    emit(OP_SELECT);
+}
+
+void Compiler::visitVariableExpr(VariableExpr *expr) {
+    _line = expr->name->line();
+    emitGet(expr->name->lexeme());
+}
+
+void Compiler::visitAssignExpr(AssignExpr *expr) {
+    compile(expr->value);
+    _line = expr->name->line();
+    emitSet(expr->name->lexeme());
+}
+
+void Compiler::visitLogicalExpr(LogicalExpr *expr) {
+    compile(expr->left);
+    _line = expr->op->line();
+    if (expr->op->type() == OR) {
+        const auto elseJump = emitJump(OP_JUMP_IF_FALSE);
+        const auto endJump = emitJump(OP_JUMP);
+        patchJump(elseJump);
+        emit(OP_POP);
+        compile(expr->right);
+        patchJump(endJump);
+    } else {
+        const auto endJump = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+        compile(expr->right);
+        patchJump(endJump);
+    }
+}
+
+void Compiler::visitCallExpr(CallExpr *expr) {
+    compileCall(expr, OP_CALL);
+}
+
+void Compiler::compileCall(const CallExpr *expr, const OpCode op) {
+    compile(expr->callee);
+    for (const auto arg: *expr->arguments) {
+        compile(arg);
+    }
+    _line = expr->paren->line();
+    if (expr->arguments->size() > UINT8_MAX) {
+        error(expr->paren, "Too many arguments");
+        return;
+    }
+    emit(op, expr->arguments->size());
+}
+
+void Compiler::visitArrayExpr(ArrayExpr *expr) {
+    for (const auto element: *expr->elements) {
+        compile(element);
+    }
+    _line = expr->bracket->line();
+    if (expr->elements->size() > UINT16_MAX) {
+        error(expr->bracket, "Too many array elements");
+        return;
+    }
+    emitShort(OP_ARRAY, expr->elements->size());
+}
+
+void Compiler::visitIndexedCallExpr(IndexedCallExpr *expr) {
+    compile(expr->callee);
+    compile(expr->index);
+    _line = expr->bracket->line();
+    emit(OP_INDEX_GET);
+}
+
+void Compiler::visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) {
+    compile(expr->callee);
+    compile(expr->index);
+    compile(expr->value);
+    _line = expr->bracket->line();
+    emit(OP_INDEX_SET);
+}
+
+void Compiler::visitMapExpr(MapExpr *expr) {
+    for (const auto &[key, value]: *expr->elements) {
+        compile(key);
+        compile(value);
+    }
+    _line = expr->brace->line();
+    if (expr->elements->size() > UINT16_MAX) {
+        error(expr->brace, "Too many map entries");
+        return;
+    }
+    emitShort(OP_MAP, expr->elements->size());
+}
+
+void Compiler::compileStep(Expr *target, const Token *op, const bool isPrefix) {
+    const auto stepOp = op->type() == PLUS_PLUS ? OP_INCREMENT : OP_DECREMENT;
+    if (target->kind == ExprKind::VARIABLE) {
+        const auto variable = static_cast<VariableExpr *>(target);
+        _line = variable->name->line();
+        emitGet(variable->name->lexeme());
+        _line = op->line();
+        if (!isPrefix) {
+            emit(OP_DUP);
+        }
+        emit(stepOp);
+        emitSet(variable->name->lexeme());
+        if (!isPrefix) {
+            emit(OP_POP);
+        }
+        return;
+    }
+    if (target->kind == ExprKind::INDEXED_CALL) {
+        const auto indexed = static_cast<IndexedCallExpr *>(target);
+        compile(indexed->callee);
+        compile(indexed->index);
+        _line = op->line();
+        emit(OP_INDEX_STEP);
+        emit(stepOp == OP_INCREMENT ? 1 : 0);
+        emit(isPrefix ? 1 : 0);
+        return;
+    }
+    // Not assignable, only the resulting value matters
+    compile(target);
+    _line = op->line();
+    emit(isPrefix ? stepOp : OP_POSITIVE);
+}
+
+void Compiler::visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) {
+    compileStep(expr->expr, expr->op, true);
+}
+
+void Compiler::visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) {
+    compileStep(expr->expr, expr->op, false);
+}
+
+void Compiler::visitInvariantExpr(InvariantExpr *expr) {
+    // Recomputing is as cheap as checking a cached value would be here
+    compile(expr->expr);
+}
+
+void Compiler::visitStringLiteralExpr(StringLiteralExpr *expr) {
+    for (const auto value: *expr->values) {
+        compile(value);
+    }
+    emitShort(OP_CONCAT, expr->values->size());
+}
+
+void Compiler::visitExprStmt(ExprStmt *stmt) {
+    compile(stmt->expr);
+    emit(OP_POP);
+}
+
+void Compiler::visitVarStmt(VarStmt *stmt) {
+    if (stmt->initializer) {
+        compile(stmt->initializer);
+    } else {
+        emit(OP_NULL);
+    }
+    _line = stmt->name->line();
+    emitDefine(stmt->name->lexeme());
+}
+
+void Compiler::visitBlockStmt(BlockStmt *stmt) {
+    beginScope();
+    for (const auto s: *stmt->stmts) {
+        compile(s);
+    }
+    endScope();
+}
+
+void Compiler::visitIfStmt(IfStmt *stmt) {
+    compile(stmt->condition);
+    const auto elseJump = emitJump(OP_JUMP_IF_FALSE);
+    emit(OP_POP);
+    compile(stmt->thenBlock);
+    const auto endJump = emitJump(OP_JUMP);
+    patchJump(elseJump);
+    emit(OP_POP);
+    if (stmt->elseBlock) {
+        compile(stmt->elseBlock);
+    }
+    patchJump(endJump);
+}
+
+void Compiler::visitWhileStmt(WhileStmt *stmt) {
+    const auto loopStart = chunk().code.size();
+    ulong exitJump = 0;
+    if (stmt->condition) {
+        compile(stmt->condition);
+        exitJump = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+    }
+    _state->loops.push_back({_state->scopeDepth});
+    compile(stmt->body);
+    for (const auto jump: _state->loops.back().continueJumps) {
+        patchJump(jump);
+    }
+    if (stmt->increment) {
+        compile(stmt->increment);
+        emit(OP_POP);
+    }
+    emitLoop(loopStart);
+    if (stmt->condition) {
+        patchJump(exitJump);
+        emit(OP_POP);
+    }
+    // Breaks land after the condition has been popped
+    for (const auto jump: _state->loops.back().breakJumps) {
+        patchJump(jump);
+    }
+    _state->loops.pop_back();
+}
+
+void Compiler::visitCountedLoopStmt(CountedLoopStmt *stmt) {
+    const auto counterSlot = resolveLocal(_state, stmt->counter()->name->lexeme());
+    OpCode comparison;
+    switch (stmt->condition->op->type()) {
+        case LESS: comparison = OP_LESS;
+            break;
+        case LESS_EQUAL: comparison = OP_LESS_EQUAL;
+            break;
+        case GREATER: comparison = OP_GREATER;
+            break;
+        default: comparison = OP_GREATER_EQUAL;
+            break;
+    }
+    // The limit is evaluated once into a local no identifier can name
+    beginScope();
+    compile(stmt->limit());
+    const auto limitSlot = addLocal("");
+    const auto loopStart = chunk().code.size();
+    _line = stmt->condition->op->line();
+    ulong exitJump;
+    if (counterSlot != -1) {
+        emit(OP_COUNTED_TEST, counterSlot);
+        emit(limitSlot);
+        emit(comparison);
+        emit(0xff);
+        emit(0xff);
+        exitJump = chunk().code.size() - 2;
+    } else {
+        compile(stmt->counter());
+        emit(OP_GET_LOCAL, limitSlot);
+        emit(comparison);
+        exitJump = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+    }
+    _state->loops.push_back({_state->scopeDepth});
+    compile(stmt->body);
+    for (const auto jump: _state->loops.back().continueJumps) {
+        patchJump(jump);
+    }
+    if (counterSlot != -1) {
+        emit(OP_STEP_LOCAL, counterSlot);
+        emit(stmt->step > 0 ? 1 : 0);
+    } else {
+        compile(stmt->increment);
+        emit(OP_POP);
+    }
+    emitLoop(loopStart);
+    patchJump(exitJump);
+    if (counterSlot == -1) {
+        emit(OP_POP);
+    }
+    for (const auto jump: _state->loops.back().breakJumps) {
+        patchJump(jump);
+    }
+    _state->loops.pop_back();
+    endScope();
+}
+
+void Compiler::visitFunctionStmt(FunctionStmt *stmt) {
+    const auto name = stmt->name->lexeme();
+    _line = stmt->name->line();
+    if (_state->scopeDepth > 0 && declaredInScope(name) == -1) {
+        // Declare before compiling the body so that the function can call itself
+        addLocal(name);
+        compileFunction(stmt);
+        return;
+    }
+    compileFunction(stmt);
+    emitDefine(name);
+}
+
+void Compiler::visitBreakStmt(BreakStmt *stmt) {
+    _line = stmt->keyword->line();
+    if (_state->loops.empty()) {
+        emitStrayJump();
+        return;
+    }
+    discardLocals(_state->loops.back().scopeDepth);
+    _state->loops.back().breakJumps.push_back(emitJump(OP_JUMP));
+}
+
+void Compiler::visitContinueStmt(ContinueStmt *stmt) {
+    _line = stmt->keyword->line();
+    if (_state->loops.empty()) {
+        emitStrayJump();
+        return;
+    }
+    discardLocals(_state->loops.back().scopeDepth);
+    _state->loops.back().continueJumps.push_back(emitJump(OP_JUMP));
+}
+
+void Compiler::visitReturnStmt(ReturnStmt *stmt) {
+    if (_state->enclosing == nullptr) {
+        // The value, or the returned call, is still computed
+        if (stmt->value) {
+            compile(stmt->value);
+            emit(OP_POP);
+        }
+        _line = stmt->keyword->line();
+        emitStrayJump();
+        return;
+    }
+    if (stmt->isTailCall()) {
+        compileCall(static_cast<CallExpr *>(stmt->value), OP_TAIL_CALL);
+    } else if (stmt->value) {
+        compile(stmt->value);
+    } else {
+        emit(OP_NULL);
+    }
+    _line = stmt->keyword->line();
+    // Still reached after a tail call to a native callable
+    emit(OP_RETURN);
+}
@@ -0,0 +1,169 @@
+#ifndef COMPILER_HPP
+#define COMPILER_HPP
+
+#include <map>
+
+#include "chunk.hpp"
+#include "../lexical/value_holder.hpp"
+#include "../parser/stmt.hpp"
+
+// Lowers the AST into bytecode for the VirtualMachine
+class Compiler final : public ExprVisitor<void>, public StmtVisitor<void> {
+    struct Local {
+        std::string name;
+        int depth;
+        bool isCaptured;
+    };
+
+    struct UpvalueRef {
+        uint8_t index;
+        bool isLocal;
+    };
+
+    struct Loop {
+        // Scope depth the loop is declared in, deeper locals are discarded when jumping out of the body
+        int scopeDepth;
+        std::vector<ulong> breakJumps = {};
+        std::vector<ulong> continueJumps = {};
+    };
+
+    struct FunctionState {
+        FunctionState *enclosing;
+        std::shared_ptr<FunctionProto> proto;
+        std::vector<Local> locals = {};
+        std::vector<UpvalueRef> upvalues = {};
+        std::map<std::string, uint16_t, std::less<> > names = {};
+        std::vector<Loop> loops = {};
+        int scopeDepth = 0;
+    };
+
+    FunctionState *_state = nullptr;
+    // Jumps to the end of the top level statement being compiled
+    std::vector<ulong> _statementExits;
+    uint _line = 0;
+    bool _hasError = false;
+
+    Chunk &chunk() const;
+
+    void emit(uint8_t byte) const;
+
+    void emit(OpCode op, uint8_t operand) const;
+
+    void emitShort(OpCode op, uint16_t operand) const;
+
+    ulong emitJump(OpCode op) const;
+
+    void patchJump(ulong offset);
+
+    void emitLoop(ulong loopStart);
+
+    uint16_t makeConstant(const Value &value);
+
+    uint16_t nameConstant(std::string_view name);
+
+    void compile(Expr *expr);
+
+    void compile(Stmt *stmt);
+
+    void compileFunction(const FunctionStmt *stmt);
+
+    // op is OP_CALL or OP_TAIL_CALL
+    void compileCall(const CallExpr *expr, OpCode op);
+
+    void beginScope() const;
+
+    void endScope() const;
+
+    // Emits the pops for the locals deeper than depth without forgetting them
+    void discardLocals(int depth) const;
+
+    // Leaves the function, or the top level statement, for a jump the Resolver found outside of its loop or function
+    void emitStrayJump();
+
+    int addLocal(std::string_view name);
+
+    int declaredInScope(std::string_view name) const;
+
+    static int resolveLocal(const FunctionState *state, std::string_view name);
+
+    int resolveUpvalue(FunctionState *state, std::string_view name);
+
+    int addUpvalue(FunctionState *state, uint8_t index, bool isLocal);
+
+    void emitGet(std::string_view name);
+
+    void emitSet(std::string_view name);
+
+    void emitDefine(std::string_view name);
+
+    void error(const Token *token, const std::string &message);
+
+    void error(const std::string &message);
+
+protected:
+    void visitBinaryExpr(BinaryExpr *expr) override;
+
+    void visitGroupingExpr(GroupingExpr *expr) override;
+
+    void visitLiteralExpr(LiteralExpr *expr) override;
+
+    void visitUnaryExpr(UnaryExpr *expr) override;
+
+    void visitTernaryExpr(TernaryExpr *expr) override;
+
+    void visitVariableExpr(VariableExpr *expr) override;
+
+    void visitAssignExpr(AssignExpr *expr) override;
+
+    void visitLogicalExpr(LogicalExpr *expr) override;
+
+    void visitCallExpr(CallExpr *expr) override;
+
+    void visitArrayExpr(ArrayExpr *expr) override;
+
+    void visitIndexedCallExpr(IndexedCallExpr *expr) override;
+
+    void visitIndexedEleAssignExpr(ArrayElementAssignExpr *expr) override;
+
+    void visitMapExpr(MapExpr *expr) override;
+
+    void visitPrefixAutoUnaryExpr(PrefixAutoUnaryExpr *expr) override;
+
+    void visitSuffixAutoUnaryExpr(SuffixAutoUnaryExpr *expr) override;
+
+    void visitStringLiteralExpr(StringLiteralExpr *expr) override;
+
+    void visitInvariantExpr(InvariantExpr *expr) override;
+
+    void visitExprStmt(ExprStmt *stmt) override;
+
+    void visitVarStmt(VarStmt *stmt) override;
+
+    void visitBlockStmt(BlockStmt *stmt) override;
+
+    void visitIfStmt(IfStmt *stmt) override;
+
+    void visitWhileStmt(WhileStmt *stmt) override;
+
+    void visitFunctionStmt(FunctionStmt *stmt) override;
+
+    void visitReturnStmt(ReturnStmt *stmt) override;
+
+    void visitBreakStmt(BreakStmt *stmt) override;
+
+    void visitContinueStmt(ContinueStmt *stmt) override;
+
+    void visitCountedLoopStmt(CountedLoopStmt *stmt) override;
+
+    void compileStep(Expr *target, const Token *op, bool isPrefix);
+
+public:
+    Compiler() = default;
+
+    ~Compiler() override = default;
+
+    // Returns the top level script function, or nullptr if compiling failed
+    std::shared_ptr<FunctionProto> compile(std::vector<Stmt *> *stmts);
+};
+
+#endif //COMPILER_HPP
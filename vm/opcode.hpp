@@ -0,0 +1,80 @@
+#ifndef OPCODE_HPP
+#define OPCODE_HPP
+
+#include <cstdint>
+
+// Operands follow the opcode inline. Unless noted otherwise, "u8" operands are a single byte and "u16" operands are
+// two bytes in big-endian order.
+enum OpCode : uint8_t {
+    // u16 constant index
+    OP_CONSTANT,
+    OP_NULL,
+    OP_TRUE,
+    OP_FALSE,
+    OP_POP,
+    OP_DUP,
+
+    // u8 slot, relative to the current frame
+    OP_GET_LOCAL,
+    OP_SET_LOCAL,
+    OP_DEFINE_LOCAL,
+    // u16 constant index of the variable name
+    OP_GET_GLOBAL,
+    OP_SET_GLOBAL,
+    OP_DEFINE_GLOBAL,
+    // u8 upvalue index of the current closure
+    OP_GET_UPVALUE,
+    OP_SET_UPVALUE,
+    OP_CLOSE_UPVALUE,
+
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_NOT,
+    OP_NEGATE,
+    OP_POSITIVE,
+    OP_INCREMENT,
+    OP_DECREMENT,
+    // Pops the operands of ?: and pushes the left one if the condition is truthy, else the right one
+    OP_SELECT,
+
+    // u16 forward offset
+    OP_JUMP,
+    // u16 forward offset, the condition is left on the stack
+    OP_JUMP_IF_FALSE,
+    // u16 backward offset
+    OP_LOOP,
+    // u8 counter slot, u8 limit slot, u8 comparison opcode, u16 forward offset. Jumps if the counter doesn't compare
+    // to the limit, without touching the stack.
+    OP_COUNTED_TEST,
+    // u8 slot, u8 increment (1) or decrement (0). Steps a local in place.
+    OP_STEP_LOCAL,
+
+    // u8 argument count
+    OP_CALL,
+    // u8 argument count, a call whose result is returned. A closure callee reuses the frame of the caller.
+    OP_TAIL_CALL,
+    // u16 function index, followed by (u8 isLocal, u8 index) for every upvalue
+    OP_CLOSURE,
+    OP_RETURN,
+
+    // u16 element count
+    OP_ARRAY,
+    // u16 entry count
+    OP_MAP,
+    OP_INDEX_GET,
+    OP_INDEX_SET,
+    // u8 increment (1) or decrement (0), u8 prefix (1) or suffix (0)
+    OP_INDEX_STEP,
+    // u16 part count
+    OP_CONCAT,
+};
+
+#endif //OPCODE_HPP
@@ -0,0 +1,604 @@
+#include "virtual_machine.hpp"
+
+#include <iterator>
+
+#include "../interpret/builtin.hpp"
+#include "../utils/collector.hpp"
+#include "../utils/exception.hpp"
+#include "../utils/logger.hpp"
+
+static std::string asString(const Value &value) {
+    if (value.isString() || value.isNumber()) {
+        return value.toString();
+    }
+    throw RuntimeError("Invalid operand");
+}
+
+Value ClosureCallable::call([[maybe_unused]] Interpreter *interpreter, const std::span<Value> args) {
+    return _vm->call(this, args);
+}
+
+VirtualMachine::VirtualMachine() {
+    _stack.resize(STACK_MAX);
+    _frames.reserve(FRAMES_MAX);
+    _globals = std::allocate_shared<RuntimeScope>(PoolAllocator<RuntimeScope>(), nullptr);
+    initGlobalScope(_globals.get());
+}
+
+VirtualMachine::~VirtualMachine() = default;
+
+void VirtualMachine::push(Value value) {
+    if (_stackTop == STACK_MAX) {
+        throw RuntimeError("Stack overflow");
+    }
+    _stack[_stackTop++] = std::move(value);
+}
+
+Value VirtualMachine::pop() {
+    return std::move(_stack[--_stackTop]);
+}
+
+Value &VirtualMachine::peek(const ulong distance) {
+    return _stack[_stackTop - 1 - distance];
+}
+
+void VirtualMachine::dropTo(const ulong top) {
+    while (_stackTop > top) {
+        _stack[--_stackTop] = Value();
+    }
+}
+
+void VirtualMachine::interpret(const std::shared_ptr<FunctionProto> &script) {
+    const auto closure = std::make_shared<ClosureCallable>(this, script);
+    push(Value::ofObject(new CallableHolder(closure)));
+    _frames.push_back({closure.get(), script->chunk.code.data(), 0});
+    while (true) {
+        try {
+            run(0);
+            break;
+        } catch (const RuntimeError &e) {
+            const uint line = e._token ? e._token->line() : currentLine();
+            Logger::instance()->logRuntimeError(line, e._message);
+            if (!recover()) {
+                break;
+            }
+        }
+    }
+    _frames.clear();
+    closeUpvalues(_stack.data());
+    dropTo(0);
+}
+
+Value VirtualMachine::call(ClosureCallable *closure, const std::span<const Value> args) {
+    // The callee slot is never read back, a placeholder keeps the frame layout intact
+    push(Value());
+    for (const auto &arg: args) {
+        push(arg);
+    }
+    callClosure(closure, static_cast<int>(args.size()));
+    run(_frames.size() - 1);
+    return pop();
+}
+
+void VirtualMachine::callValue(const int argCount) {
+    const auto callable = resolveCallable(argCount);
+    if (const auto closure = dynamic_cast<ClosureCallable *>(callable)) {
+        callClosure(closure, argCount);
+        return;
+    }
+    callNative(callable, argCount);
+}
+
+void VirtualMachine::tailCallValue(const int argCount) {
+    const auto callable = resolveCallable(argCount);
+    const auto closure = dynamic_cast<ClosureCallable *>(callable);
+    if (closure == nullptr) {
+        callNative(callable, argCount);
+        return;
+    }
+    // Move the callee and the arguments over the returning frame, the callee value keeps the closure alive
+    const auto base = _frames.back().base;
+    closeUpvalues(&_stack[base]);
+    const auto first = _stackTop - argCount - 1;
+    for (int i = 0; i <= argCount; ++i) {
+        _stack[base + i] = std::move(_stack[first + i]);
+    }
+    dropTo(base + argCount + 1);
+    _frames.pop_back();
+    callClosure(closure, argCount);
+}
+
+Callable *VirtualMachine::resolveCallable(const int argCount) {
+    const auto &callee = peek(argCount);
+    if (!callee.isObject(ObjectType::CALLABLE)) {
+        throw RuntimeError("No callable found");
+    }
+    const auto holder = callee.as<CallableHolder>();
+    Callable *callable = nullptr;
+    for (const auto &c: holder->callables) {
+        if (c->parameterSize() == argCount) {
+            callable = c.get();
+            break;
+        }
+    }
+    if (callable == nullptr) {
+        // No matching function with exact parameter size, so let's find a varargs function
+        for (const auto &c: holder->callables) {
+            if (const auto closure = dynamic_cast<ClosureCallable *>(c.get());
+                closure != nullptr && closure->proto->isVarargs && argCount >= closure->proto->arity - 1) {
+                callable = c.get();
+                break;
+            }
+        }
+    }
+    if (callable == nullptr) {
+        throw RuntimeError("No callable found");
+    }
+    return callable;
+}
+
+void VirtualMachine::callNative(Callable *callable, const int argCount) {
+    // Native callables never touch the tree-walking interpreter, nor this stack
+    auto result = callable->call(nullptr, std::span(&_stack[_stackTop - argCount], argCount));
+    dropTo(_stackTop - argCount - 1);
+    push(std::move(result));
+}
+
+void VirtualMachine::callClosure(ClosureCallable *closure, const int argCount) {
+    const auto &proto = closure->proto;
+    if (proto->isVarargs) {
+        const auto fixedCount = proto->arity - 1;
+        const auto varargs = new ArrayValueHolder();
+        for (auto i = fixedCount; i < argCount; ++i) {
+            varargs->values.push_back(std::move(_stack[_stackTop - argCount + i]));
+        }
+        dropTo(_stackTop - (argCount - fixedCount));
+        push(Value::ofObject(varargs));
+    }
+    if (_frames.size() == FRAMES_MAX) {
+        throw RuntimeError("Stack overflow");
+    }
+    _frames.push_back({closure, proto->chunk.code.data(), _stackTop - proto->arity - 1});
+}
+
+std::shared_ptr<Upvalue> VirtualMachine::captureUpvalue(Value *local) {
+    std::shared_ptr<Upvalue> prev;
+    auto upvalue = _openUpvalues;
+    while (upvalue != nullptr && upvalue->location > local) {
+        prev = upvalue;
+        upvalue = upvalue->next;
+    }
+    if (upvalue != nullptr && upvalue->location == local) {
+        return upvalue;
+    }
+    auto created = std::make_shared<Upvalue>(local);
+    created->next = upvalue;
+    if (prev == nullptr) {
+        _openUpvalues = created;
+    } else {
+        prev->next = created;
+    }
+    return created;
+}
+
+void VirtualMachine::closeUpvalues(const Value *last) {
+    while (_openUpvalues != nullptr && _openUpvalues->location >= last) {
+        const auto upvalue = _openUpvalues;
+        upvalue->closed = std::move(*upvalue->location);
+        upvalue->location = &upvalue->closed;
+        _openUpvalues = upvalue->next;
+        upvalue->next = nullptr;
+    }
+}
+
+uint VirtualMachine::currentLine() const {
+    if (_frames.empty()) {
+        return 0;
+    }
+    const auto &frame = _frames.back();
+    const auto &chunk = frame.closure->proto->chunk;
+    return chunk.lineAt(frame.ip - chunk.code.data() - 1);
+}
+
+bool VirtualMachine::recover() {
+    // Unwind to the script frame and continue with the next top level statement
+    _frames.resize(1);
+    closeUpvalues(&_stack[1]);
+    dropTo(1);
+    auto &script = _frames.front();
+    const auto &chunk = script.closure->proto->chunk;
+    const auto offset = static_cast<uint>(script.ip - chunk.code.data());
+    for (const auto start: chunk.statementOffsets) {
+        if (start >= offset) {
+            script.ip = chunk.code.data() + start;
+            return true;
+        }
+    }
+    return false;
+}
+
+Value VirtualMachine::binaryOp(const OpCode op, const Value &left, const Value &right) {
+    if (op == OP_ADD && (left.isString() || right.isString())) {
+        return makeString(asString(left) + asString(right));
+    }
+    if (!left.isNumber() || !right.isNumber()) {
+        throw RuntimeError("Invalid operand type");
+    }
+    if (left.isDouble() || right.isDouble()) {
+        const auto l = left.asNumber();
+        const auto r = right.asNumber();
+        switch (op) {
+            case OP_ADD: return Value::ofDouble(l + r);
+            case OP_SUBTRACT: return Value::ofDouble(l - r);
+            case OP_MULTIPLY: return Value::ofDouble(l * r);
+            case OP_DIVIDE: return Value::ofDouble(l / r);
+            default: break;
+        }
+    } else {
+        const auto l = left.asInt();
+        const auto r = right.asInt();
+        switch (op) {
+            case OP_ADD: return Value::ofInt(l + r);
+            case OP_SUBTRACT: return Value::ofInt(l - r);
+            case OP_MULTIPLY: return Value::ofInt(l * r);
+            case OP_DIVIDE: {
+                if (r == 0) {
+                    throw RuntimeError("Division by zero");
+                }
+                return Value::ofInt(l / r);
+            }
+            default: break;
+        }
+    }
+    const auto l = left.asNumber();
+    const auto r = right.asNumber();
+    switch (op) {
+        case OP_GREATER: return Value::ofBool(l > r);
+        case OP_GREATER_EQUAL: return Value::ofBool(l >= r);
+        case OP_LESS: return Value::ofBool(l < r);
+        case OP_LESS_EQUAL: return Value::ofBool(l <= r);
+        case OP_EQUAL: return Value::ofBool(l == r);
+        case OP_NOT_EQUAL: return Value::ofBool(l != r);
+        default: throw RuntimeError("Invalid operator");
+    }
+}
+
+Value VirtualMachine::step(const Value &value, const bool increment) {
+    const int delta = increment ? 1 : -1;
+    if (value.isDouble()) {
+        return Value::ofDouble(value.asDouble() + delta);
+    }
+    if (value.isInt()) {
+        return Value::ofInt(value.asInt() + delta);
+    }
+    throw RuntimeError("Invalid operand type");
+}
+
+void VirtualMachine::run(const ulong exitDepth) {
+    CallFrame *frame = &_frames.back();
+    const uint8_t *ip = frame->ip;
+    auto readByte = [&ip] {
+        return *ip++;
+    };
+    auto readShort = [&ip] {
+        ip += 2;
+        return static_cast<uint16_t>(ip[-2] << 8 | ip[-1]);
+    };
+    auto constants = [&frame]() -> std::vector<Value> & {
+        return frame->closure->proto->chunk.constants;
+    };
+    // Global slot of a name constant operand, resolved once per chunk
+    auto readGlobal = [&]() -> int {
+        const auto index = readShort();
+        auto &chunk = frame->closure->proto->chunk;
+        auto &slot = chunk.globalSlots[index];
+        if (slot < 0) {
+            slot = _globals->globalSlot(chunk.constants[index].as<StringValueHolder>()->value);
+        }
+        return slot;
+    };
+    auto checkDefined = [this](const int slot) {
+        if (!_globals->isDefined(slot)) {
+            throw RuntimeError("No such variable '" + _globals->globalName(slot) + "'");
+        }
+    };
+    try {
+        while (true) {
+            switch (static_cast<OpCode>(readByte())) {
+                case OP_CONSTANT: {
+                    push(constants()[readShort()]);
+                    break;
+                }
+                case OP_NULL: push(Value());
+                    break;
+                case OP_TRUE: push(Value::ofBool(true));
+                    break;
+                case OP_FALSE: push(Value::ofBool(false));
+                    break;
+                case OP_POP: _stack[--_stackTop] = Value();
+                    break;
+                case OP_DUP: push(peek(0));
+                    break;
+                case OP_GET_LOCAL: {
+                    push(_stack[frame->base + readByte()]);
+                    break;
+                }
+                case OP_SET_LOCAL: {
+                    _stack[frame->base + readByte()] = peek(0);
+                    break;
+                }
+                case OP_DEFINE_LOCAL: {
+                    auto &slot = _stack[frame->base + readByte()];
+                    auto value = pop();
+                    if (slot.isObject(ObjectType::CALLABLE) && value.isObject(ObjectType::CALLABLE)) {
+                        RuntimeScope::mergeCallables(slot.as<CallableHolder>(), value.as<CallableHolder>());
+                    } else {
+                        slot = std::move(value);
+                    }
+                    break;
+                }
+                case OP_GET_GLOBAL: {
+                    const auto slot = readGlobal();
+                    checkDefined(slot);
+                    push(_globals->global(slot));
+                    break;
+                }
+                case OP_SET_GLOBAL: {
+                    const auto slot = readGlobal();
+                    checkDefined(slot);
+                    _globals->global(slot) = peek(0);
+                    break;
+                }
+                case OP_DEFINE_GLOBAL: {
+                    const auto slot = readGlobal();
+                    _globals->defineGlobal(slot, pop());
+                    break;
+                }
+                case OP_GET_UPVALUE: {
+                    push(*frame->closure->upvalues[readByte()]->location);
+                    break;
+                }
+                case OP_SET_UPVALUE: {
+                    *frame->closure->upvalues[readByte()]->location = peek(0);
+                    break;
+                }
+                case OP_CLOSE_UPVALUE: {
+                    closeUpvalues(&_stack[_stackTop - 1]);
+                    _stack[--_stackTop] = Value();
+                    break;
+                }
+                case OP_ADD:
+                case OP_SUBTRACT:
+                case OP_MULTIPLY:
+                case OP_DIVIDE:
+                case OP_GREATER:
+                case OP_GREATER_EQUAL:
+                case OP_LESS:
+                case OP_LESS_EQUAL:
+                case OP_EQUAL:
+                case OP_NOT_EQUAL: {
+                    const auto op = static_cast<OpCode>(ip[-1]);
+                    const auto right = pop();
+                    auto &left = peek(0);
+                    left = binaryOp(op, left, right);
+                    break;
+                }
+                case OP_NOT: {
+                    auto &value = peek(0);
+                    value = Value::ofBool(!value.isTruthy());
+                    break;
+                }
+                case OP_NEGATE: {
+                    auto &value = peek(0);
+                    if (value.isDouble()) {
+                        value = Value::ofDouble(-value.asDouble());
+                    } else if (value.isInt()) {
+                        value = Value::ofInt(-value.asInt());
+                    } else {
+                        throw RuntimeError("Invalid operand type");
+                    }
+                    break;
+                }
+                case OP_POSITIVE: {
+                    if (!peek(0).isNumber()) {
+                        throw RuntimeError("Invalid operand type");
+                    }
+                    break;
+                }
+                case OP_INCREMENT:
+                case OP_DECREMENT: {
+                    auto &value = peek(0);
+                    value = step(value, ip[-1] == OP_INCREMENT);
+                    break;
+                }
+                case OP_SELECT: {
+                    auto right = pop();
+                    auto left = pop();
+                    peek(0) = peek(0).isTruthy() ? std::move(left) : std::move(right);
+                    break;
+                }
+                case OP_JUMP: {
+                    const auto offset = readShort();
+                    ip += offset;
+                    break;
+                }
+                case OP_JUMP_IF_FALSE: {
+                    const auto offset = readShort();
+                    if (!peek(0).isTruthy()) {
+                        ip += offset;
+                    }
+                    break;
+                }
+                case OP_LOOP: {
+                    const auto offset = readShort();
+                    ip -= offset;
+                    Collector::instance()->maybeCollect();
+                    break;
+                }
+                case OP_COUNTED_TEST: {
+                    const auto &counter = _stack[frame->base + readByte()];
+                    const auto &limit = _stack[frame->base + readByte()];
+                    const auto op = static_cast<OpCode>(readByte());
+                    const auto offset = readShort();
+                    bool inRange;
+                    if (counter.isInt() && limit.isInt()) {
+                        const auto c = counter.asInt();
+                        const auto l = limit.asInt();
+                        switch (op) {
+                            case OP_LESS: inRange = c < l;
+                                break;
+                            case OP_LESS_EQUAL: inRange = c <= l;
+                                break;
+                            case OP_GREATER: inRange = c > l;
+                                break;
+                            default: inRange = c >= l;
+                                break;
+                        }
+                    } else {
+                        inRange = binaryOp(op, counter, limit).isTruthy();
+                    }
+                    if (!inRange) {
+                        ip += offset;
+                    }
+                    break;
+                }
+                case OP_STEP_LOCAL: {
+                    auto &value = _stack[frame->base + readByte()];
+                    value = step(value, readByte() == 1);
+                    break;
+                }
+                case OP_CALL: {
+                    const int argCount = readByte();
+                    frame->ip = ip;
+                    Collector::instance()->maybeCollect();
+                    callValue(argCount);
+                    frame = &_frames.back();
+                    ip = frame->ip;
+                    break;
+                }
+                case OP_TAIL_CALL: {
+                    const int argCount = readByte();
+                    frame->ip = ip;
+                    tailCallValue(argCount);
+                    frame = &_frames.back();
+                    ip = frame->ip;
+                    break;
+                }
+                case OP_CLOSURE: {
+                    const auto &proto = frame->closure->proto->chunk.functions[readShort()];
+                    const auto closure = std::make_shared<ClosureCallable>(this, proto);
+                    for (int i = 0; i < proto->upvalueCount; ++i) {
+                        const auto isLocal = readByte();
+                        const auto index = readByte();
+                        if (isLocal) {
+                            closure->upvalues.push_back(captureUpvalue(&_stack[frame->base + index]));
+                        } else {
+                            closure->upvalues.push_back(frame->closure->upvalues[index]);
+                        }
+                    }
+                    push(Value::ofObject(new CallableHolder(closure)));
+                    break;
+                }
+                case OP_RETURN: {
+                    auto result = pop();
+                    closeUpvalues(&_stack[frame->base]);
+                    dropTo(frame->base);
+                    _frames.pop_back();
+                    push(std::move(result));
+                    if (_frames.size() == exitDepth) {
+                        return;
+                    }
+                    frame = &_frames.back();
+                    ip = frame->ip;
+                    break;
+                }
+                case OP_ARRAY: {
+                    const auto count = readShort();
+                    const auto array = new ArrayValueHolder();
+                    array->values.reserve(count);
+                    for (auto i = _stackTop - count; i < _stackTop; ++i) {
+                        array->values.push_back(std::move(_stack[i]));
+                    }
+                    dropTo(_stackTop - count);
+                    push(Value::ofObject(array));
+                    break;
+                }
+                case OP_MAP: {
+                    const auto count = readShort();
+                    const auto map = new MapValueHolder();
+                    for (auto i = _stackTop - count * 2; i < _stackTop; i += 2) {
+                        map->values[_stack[i]] = _stack[i + 1];
+                    }
+                    dropTo(_stackTop - count * 2);
+                    push(Value::ofObject(map));
+                    break;
+                }
+                case OP_INDEX_GET: {
+                    const auto index = pop();
+                    auto &callee = peek(0);
+                    callee = indexRef(callee, index, false);
+                    break;
+                }
+                case OP_INDEX_SET: {
+                    auto value = pop();
+                    const auto index = pop();
+                    auto &callee = peek(0);
+                    indexRef(callee, index, true) = value;
+                    callee = std::move(value);
+                    break;
+                }
+                case OP_INDEX_STEP: {
+                    const bool increment = readByte();
+                    const bool isPrefix = readByte();
+                    const auto index = pop();
+                    auto &callee = peek(0);
+                    auto &element = indexRef(callee, index, false);
+                    auto old = element;
+                    element = step(old, increment);
+                    callee = isPrefix ? element : std::move(old);
+                    break;
+                }
+                case OP_CONCAT: {
+                    const auto count = readShort();
+                    std::string result;
+                    for (auto i = _stackTop - count; i < _stackTop; ++i) {
+                        result.append(_stack[i].toString());
+                    }
+                    dropTo(_stackTop - count);
+                    push(makeString(std::move(result)));
+                    break;
+                }
+                default:
+                    throw RuntimeError("Unknown opcode");
+            }
+        }
+    } catch (...) {
+        frame->ip = ip;
+        throw;
+    }
+}
+
+Value &VirtualMachine::indexRef(const Value &callee, const Value &index, const bool insert) {
+    if (callee.isObject(ObjectType::ARRAY)) {
+        auto &values = callee.as<ArrayValueHolder>()->values;
+        if (!index.isInt()) {
+            throw RuntimeError("Array index not an integer");
+        }
+        if (index.asInt() < 0 || index.asInt() >= std::ssize(values)) {
+            throw RuntimeError("Array index out of range");
+        }
+        return values[index.asInt()];
+    }
+    if (callee.isObject(ObjectType::MAP)) {
+        auto &values = callee.as<MapValueHolder>()->values;
+        if (insert) {
+            return values[index];
+        }
+        const auto it = values.find(index);
+        if (it == values.end()) {
+            throw RuntimeError("Key not found");
+        }
+        return it->second;
+    }
+    throw RuntimeError("Not an array or a map");
+}
@@ -0,0 +1,130 @@
+#ifndef VIRTUAL_MACHINE_HPP
+#define VIRTUAL_MACHINE_HPP
+
+#include "chunk.hpp"
+#include "../interpret/callable.hpp"
+
+class VirtualMachine;
+
+// A variable captured by a closure. While the declaring frame is alive it points into the value stack, once the
+// variable goes out of scope the value is moved into the upvalue itself.
+class Upvalue final : public Traceable, public std::enable_shared_from_this<Upvalue> {
+public:
+    Value *location;
+    Value closed;
+    std::shared_ptr<Upvalue> next;
+
+    explicit Upvalue(Value *location): location(location) {
+        track();
+    }
+
+    [[nodiscard]] long refCount() const override {
+        return weak_from_this().use_count();
+    }
+
+    void traverse(const Tracer visit) override {
+        closed.trace(visit);
+        if (next) {
+            visit(next.get());
+        }
+    }
+
+    void clearReferences() override {
+        closed = {};
+        next = nullptr;
+    }
+
+    std::shared_ptr<void> pin() override {
+        return shared_from_this();
+    }
+};
+
+class ClosureCallable final : public Callable {
+    VirtualMachine *_vm;
+
+public:
+    const std::shared_ptr<FunctionProto> proto;
+    std::vector<std::shared_ptr<Upvalue> > upvalues;
+
+    ClosureCallable(VirtualMachine *vm, std::shared_ptr<FunctionProto> proto): _vm(vm), proto(std::move(proto)) {
+    }
+
+    Value call(Interpreter *interpreter, std::span<Value> args) override;
+
+    int parameterSize() override {
+        return proto->arity;
+    }
+
+    void traverse(const Tracer visit) override {
+        for (const auto &upvalue: upvalues) {
+            visit(upvalue.get());
+        }
+    }
+
+    void clearReferences() override {
+        upvalues.clear();
+    }
+};
+
+class VirtualMachine final {
+    struct CallFrame {
+        ClosureCallable *closure;
+        const uint8_t *ip;
+        ulong base;
+    };
+
+    static constexpr ulong FRAMES_MAX = 1024;
+    static constexpr ulong STACK_MAX = FRAMES_MAX * 256;
+
+    std::vector<Value> _stack;
+    ulong _stackTop = 0;
+    std::vector<CallFrame> _frames;
+    std::shared_ptr<Upvalue> _openUpvalues;
+    std::shared_ptr<RuntimeScope> _globals;
+
+    void push(Value value);
+
+    Value pop();
+
+    [[nodiscard]] Value &peek(ulong distance);
+
+    void dropTo(ulong top);
+
+    void callValue(int argCount);
+
+    void tailCallValue(int argCount);
+
+    // Overload of the callee below the arguments to call
+    Callable *resolveCallable(int argCount);
+
+    void callNative(Callable *callable, int argCount);
+
+    void callClosure(ClosureCallable *closure, int argCount);
+
+    std::shared_ptr<Upvalue> captureUpvalue(Value *local);
+
+    void closeUpvalues(const Value *last);
+
+    void run(ulong exitDepth);
+
+    [[nodiscard]] uint currentLine() const;
+
+    bool recover();
+
+    static Value binaryOp(OpCode op, const Value &left, const Value &right);
+
+    static Value step(const Value &value, bool increment);
+
+    static Value &indexRef(const Value &callee, const Value &index, bool insert);
+
+public:
+    VirtualMachine();
+
+    ~VirtualMachine();
+
+    void interpret(const std::shared_ptr<FunctionProto> &script);
+
+    Value call(ClosureCallable *closure, std::span<const Value> args);
+};
+
+#endif //VIRTUAL_MACHINE_HPP